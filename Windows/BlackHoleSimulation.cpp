@@ -3,6 +3,7 @@
 #include <sstream>
 #include <cmath>
 #include <algorithm>
+#include <cstring>
 
 // Constants
 const float PI = 3.14159265359f;
@@ -306,6 +307,8 @@ bool Shader::loadFromSource(const std::string& vertexSource, const std::string&
 
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
+    
+    cacheUniformLocations();
     return true;
 }
 
@@ -333,28 +336,67 @@ void Shader::use() const {
     glUseProgram(programID);
 }
 
-void Shader::setFloat(const std::string& name, float value) const {
-    glUniform1f(glGetUniformLocation(programID, name.c_str()), value);
+void Shader::cacheUniformLocations() {
+    GLint count = 0;
+    glGetProgramiv(programID, GL_ACTIVE_UNIFORMS, &count);
+    uniformLocations.clear();
+    uniformLocations.reserve(count);
+
+    for (GLint i = 0; i < count; i++) {
+        char name[256];
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(programID, i, sizeof(name), &length, &size, &type, name);
+
+        // Arrays are reported as "name[0]"; register them under the plain name
+        size_t keyLength = static_cast<size_t>(length);
+        if (keyLength > 3 && std::strcmp(name + keyLength - 3, "[0]") == 0) {
+            keyLength -= 3;
+        }
+
+        GLint location = glGetUniformLocation(programID, name);
+        if (location >= 0) {
+            uniformLocations.emplace_back(UniformName::hashOf(name, keyLength), location);
+        }
+    }
+
+    std::sort(uniformLocations.begin(), uniformLocations.end());
+    for (size_t i = 1; i < uniformLocations.size(); i++) {
+        if (uniformLocations[i].first == uniformLocations[i - 1].first) {
+            std::cerr << "Uniform name hash collision at location " << uniformLocations[i].second << std::endl;
+        }
+    }
+}
+
+GLint Shader::getUniformLocation(UniformName name) const {
+    auto it = std::lower_bound(uniformLocations.begin(), uniformLocations.end(), name.hash,
+        [](const std::pair<uint32_t, GLint>& entry, uint32_t hash) { return entry.first < hash; });
+    return (it != uniformLocations.end() && it->first == name.hash) ? it->second : -1;
+}
+
+void Shader::setFloat(UniformName name, float value) const {
+    glUniform1f(getUniformLocation(name), value);
 }
 
-void Shader::setInt(const std::string& name, int value) const {
-    glUniform1i(glGetUniformLocation(programID, name.c_str()), value);
+void Shader::setInt(UniformName name, int value) const {
+    glUniform1i(getUniformLocation(name), value);
 }
 
-void Shader::setVec2(const std::string& name, float x, float y) const {
-    glUniform2f(glGetUniformLocation(programID, name.c_str()), x, y);
+void Shader::setVec2(UniformName name, float x, float y) const {
+    glUniform2f(getUniformLocation(name), x, y);
 }
 
-void Shader::setVec3(const std::string& name, float x, float y, float z) const {
-    glUniform3f(glGetUniformLocation(programID, name.c_str()), x, y, z);
+void Shader::setVec3(UniformName name, float x, float y, float z) const {
+    glUniform3f(getUniformLocation(name), x, y, z);
 }
 
-void Shader::setVec3(const std::string& name, const Vec3& vec) const {
-    glUniform3f(glGetUniformLocation(programID, name.c_str()), vec.x, vec.y, vec.z);
+void Shader::setVec3(UniformName name, const Vec3& vec) const {
+    glUniform3f(getUniformLocation(name), vec.x, vec.y, vec.z);
 }
 
-void Shader::setMat4(const std::string& name, const Mat4& mat) const {
-    glUniformMatrix4fv(glGetUniformLocation(programID, name.c_str()), 1, GL_FALSE, mat.data());
+void Shader::setMat4(UniformName name, const Mat4& mat) const {
+    glUniformMatrix4fv(getUniformLocation(name), 1, GL_FALSE, mat.data());
 }
 
 // BlackHoleSimulation implementation
@@ -6,6 +6,8 @@
 #include <memory>
 #include <vector>
 #include <array>
+#include <cstdint>
+#include <utility>
 
 // Simple 3D vector and matrix math structures
 struct Vec3 {
@@ -64,6 +66,23 @@ private:
     Mat4 invViewMatrix;
 };
 
+// Uniform name hashed (FNV-1a) from a string literal at compile time, so the
+// setters below do no string construction and no glGetUniformLocation
+struct UniformName {
+    uint32_t hash;
+    
+    template <size_t N>
+    constexpr UniformName(const char (&name)[N]) : hash(hashOf(name, N - 1)) {}
+    
+    static constexpr uint32_t hashOf(const char* name, size_t length) {
+        uint32_t h = 2166136261u;
+        for (size_t i = 0; i < length; i++) {
+            h = (h ^ static_cast<unsigned char>(name[i])) * 16777619u;
+        }
+        return h;
+    }
+};
+
 class Shader {
 public:
     Shader() : programID(0) {}
@@ -72,19 +91,25 @@ public:
     bool loadFromSource(const std::string& vertexSource, const std::string& fragmentSource);
     void use() const;
     
-    void setFloat(const std::string& name, float value) const;
-    void setInt(const std::string& name, int value) const;
-    void setVec2(const std::string& name, float x, float y) const;
-    void setVec3(const std::string& name, float x, float y, float z) const;
-    void setVec3(const std::string& name, const Vec3& vec) const;
-    void setMat4(const std::string& name, const Mat4& mat) const;
+    // Location of an active uniform, -1 (ignored by glUniform*) if there is none
+    GLint getUniformLocation(UniformName name) const;
+    
+    void setFloat(UniformName name, float value) const;
+    void setInt(UniformName name, int value) const;
+    void setVec2(UniformName name, float x, float y) const;
+    void setVec3(UniformName name, float x, float y, float z) const;
+    void setVec3(UniformName name, const Vec3& vec) const;
+    void setMat4(UniformName name, const Mat4& mat) const;
     
     GLuint getID() const { return programID; }
 
 private:
     GLuint programID;
+    // (name hash, location) of every active uniform, sorted by hash
+    std::vector<std::pair<uint32_t, GLint>> uniformLocations;
     
     GLuint compileShader(const std::string& source, GLenum type) const;
+    void cacheUniformLocations();
     void checkCompileErrors(GLuint shader, const std::string& type) const;
 };
 
@@ -0,0 +1,232 @@
+// Fixed-scenario GPU benchmark. Renders every scenario at every resolution on
+// a headless context and reports frame time percentiles and throughput as JSON,
+// so builds can be compared on the same machine:
+//   blackhole_bench [--frames N] [--warmup N] [--sizes 720p,1080p,4k]
+//                   [--scenarios default,edge_on,...] [--march-stride 1|2|4]
+//                   [--compute] [--output report.json]
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "FrameProfiler.hpp"
+#include "GpuRenderer.hpp"
+#include "HeadlessContext.hpp"
+#include "OfflineRender.hpp"
+#include "RenderTarget.hpp"
+
+struct Scenario {
+    const char* name;
+    const char* description;
+    void (*setup)(OfflineOptions& options);
+};
+
+static const Scenario SCENARIOS[] = {
+    {"default", "startup view, all features on", [](OfflineOptions&) {}},
+    {"edge_on", "camera in the disk plane", [](OfflineOptions& o) { o.camera.elevation = 0.5f * 3.14159265f; }},
+    {"near_horizon", "camera at the minimum orbit radius",
+     [](OfflineOptions& o) { o.camera.radius = o.camera.minRadius; }},
+    {"no_lensing", "straight rays", [](OfflineOptions& o) { o.params.lensingOn = false; }},
+    {"kerr", "Kerr geodesics at spin 0.9", [](OfflineOptions& o) {
+         o.params.lensingModel = LensingModel::Kerr;
+         o.params.spin = 0.9f;
+     }},
+    {"belt", "4000-body asteroid belt", [](OfflineOptions& o) { o.params.bodies = asteroidBelt(4000); }},
+};
+
+struct Resolution {
+    const char* name;
+    int width;
+    int height;
+};
+
+static const Resolution RESOLUTIONS[] = {
+    {"720p", 1280, 720},
+    {"1080p", 1920, 1080},
+    {"4k", 3840, 2160},
+};
+
+struct Result {
+    const Scenario* scenario;
+    const Resolution* resolution;
+    FrameProfiler::Stats frame;
+    FrameProfiler::Stats gpu;
+    double seconds;
+};
+
+// Comma-separated list; empty keeps everything
+static bool selected(const std::string& list, const char* name) {
+    if (list.empty()) return true;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (item == name) return true;
+    }
+    return false;
+}
+
+static void writeStats(std::ostream& out, const FrameProfiler::Stats& s) {
+    out << "{\"min\": " << s.min << ", \"avg\": " << s.avg << ", \"p50\": " << s.p50 << ", \"p95\": " << s.p95
+        << ", \"p99\": " << s.p99 << ", \"max\": " << s.max << "}";
+}
+
+static void writeReport(std::ostream& out, const std::vector<Result>& results, const int frames,
+                        const int marchStride, const bool compute) {
+    out << std::fixed << std::setprecision(3);
+    out << "{\n  \"renderer\": \"" << glGetString(GL_RENDERER) << "\",\n"
+        << "  \"gl_version\": \"" << glGetString(GL_VERSION) << "\",\n"
+        << "  \"frames_per_scenario\": " << frames << ",\n  \"march_stride\": " << marchStride
+        << ",\n  \"compute\": " << (compute ? "true" : "false") << ",\n  \"results\": [";
+    for (std::size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        const double fps = r.seconds > 0.0 ? r.frame.count / r.seconds : 0.0;
+        const double pixels = static_cast<double>(r.resolution->width) * r.resolution->height;
+        out << (i ? "," : "") << "\n    {\"scenario\": \"" << r.scenario->name << "\", \"resolution\": \""
+            << r.resolution->name << "\", \"width\": " << r.resolution->width << ", \"height\": "
+            << r.resolution->height << ",\n     \"frames\": " << r.frame.count << ", \"fps\": " << fps
+            << ", \"rays_per_sec\": " << std::setprecision(0) << fps * pixels << std::setprecision(3)
+            << ",\n     \"ms_per_frame\": ";
+        writeStats(out, r.frame);
+        out << ",\n     \"gpu_ms\": ";
+        writeStats(out, r.gpu);
+        out << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+int main(const int argc, char* argv[]) {
+    int frames = 60;
+    int warmup = 5;
+    std::string sizes;
+    std::string scenarios;
+    std::string outputPath;
+    int marchStride = 1;
+    bool compute = false;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--compute") {
+            compute = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Unknown option or missing value: '" << arg << "'" << std::endl;
+            return -1;
+        }
+        const char* value = argv[++i];
+        if (arg == "--frames") frames = std::max(1, std::atoi(value));
+        else if (arg == "--warmup") warmup = std::max(0, std::atoi(value));
+        else if (arg == "--sizes") sizes = value;
+        else if (arg == "--scenarios") scenarios = value;
+        else if (arg == "--output") outputPath = value;
+        else if (arg == "--march-stride") {
+            // Exactly the strides renderReconstructed takes, so a typo can't
+            // silently benchmark another one
+            const std::string stride = value;
+            if (stride != "1" && stride != "2" && stride != "4") {
+                std::cerr << "March stride must be 1, 2 or 4" << std::endl;
+                return -1;
+            }
+            marchStride = stride[0] - '0';
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--frames N] [--warmup N] [--sizes 720p,1080p,4k] [--scenarios "
+                         "default,edge_on,near_horizon,no_lensing,kerr,belt] [--march-stride 1|2|4] [--compute] "
+                         "[--output report.json]"
+                      << std::endl;
+            return -1;
+        }
+    }
+
+    HeadlessContext context;
+    if (!context.create()) {
+        return -1;
+    }
+    if (!loadOpenGLFunctions(HeadlessContext::procLoader())) {
+        std::cerr << "Failed to load OpenGL functions" << std::endl;
+        return -1;
+    }
+
+    GpuRenderer renderer;
+    if (compute && !renderer.computeAvailable()) {
+        std::cerr << "Compute shaders need OpenGL 4.3, " << glGetString(GL_VERSION) << " found" << std::endl;
+        return -1;
+    }
+    const auto render = [&](const FrameUniforms& uniforms) {
+        if (compute) {
+            renderer.renderCompute(uniforms);
+        } else {
+            renderer.renderReconstructed(uniforms, marchStride);
+        }
+    };
+    std::vector<Result> results;
+    BodyGrid bodies;
+
+    for (const Resolution& resolution : RESOLUTIONS) {
+        if (!selected(sizes, resolution.name)) continue;
+
+        const RenderTarget target(resolution.width, resolution.height);
+        if (!target.complete()) {
+            std::cerr << "Skipping " << resolution.name << ": render target not supported" << std::endl;
+            continue;
+        }
+        target.bind();
+
+        for (const Scenario& scenario : SCENARIOS) {
+            if (!selected(scenarios, scenario.name)) continue;
+
+            OfflineOptions options;
+            options.width = resolution.width;
+            options.height = resolution.height;
+            options.fps = 60.0;
+            scenario.setup(options);
+
+            // Shader permutation builds and first-use costs stay out of the numbers
+            for (int frame = 0; frame < warmup; frame++) {
+                render(offlineFrameUniforms(options, frame, bodies));
+            }
+            glFinish();
+
+            // Each frame waits for the GPU, so frame times are true latencies
+            FrameProfiler profiler;
+            const auto start = std::chrono::steady_clock::now();
+            for (int frame = 0; frame < frames; frame++) {
+                profiler.beginFrame();
+                profiler.beginGpu();
+                render(offlineFrameUniforms(options, warmup + frame, bodies));
+                profiler.endGpu();
+                glFinish();
+                profiler.endFrame();
+            }
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            profiler.beginFrame(); // collects the last timer queries
+
+            const Result result{&scenario, &resolution, profiler.stats(FrameProfiler::Cpu),
+                                profiler.stats(FrameProfiler::Gpu), seconds};
+            results.push_back(result);
+            std::cerr << std::left << std::setw(14) << scenario.name << std::setw(6) << resolution.name << std::right
+                      << std::fixed << std::setprecision(2) << " avg " << std::setw(8) << result.frame.avg
+                      << " ms  p99 " << std::setw(8) << result.frame.p99 << " ms  " << std::setprecision(1)
+                      << frames / seconds << " fps" << std::endl;
+        }
+    }
+
+    if (outputPath.empty()) {
+        writeReport(std::cout, results, frames, marchStride, compute);
+        return 0;
+    }
+    std::ofstream file(outputPath);
+    writeReport(file, results, frames, marchStride, compute);
+    if (!file) {
+        std::cerr << "Failed to write " << outputPath << std::endl;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,221 @@
+#include "BodyGrid.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <random>
+#include "CpuShaders.hpp"
+
+// Bodies per build task
+static constexpr std::size_t BUILD_CHUNK = 1024;
+
+BodyGrid::BodyGrid(const unsigned threadCount) : threadCount(threadCount) {
+}
+
+void BodyGrid::footprint(const PlanetInstance &body, int range[4]) const {
+    const auto cellOf = [&](const float v, const float start) {
+        return std::clamp(static_cast<int>(std::floor((v - start) / cell)), 0, cellsPerSide - 1);
+    };
+    range[0] = cellOf(body.position.x - body.radius, origin[0]);
+    range[1] = cellOf(body.position.x + body.radius, origin[0]);
+    range[2] = cellOf(body.position.z - body.radius, origin[1]);
+    range[3] = cellOf(body.position.z + body.radius, origin[1]);
+}
+
+void BodyGrid::build(const std::vector<Body> &bodies, const float time) {
+    const std::size_t count = bodies.size();
+    instances.resize(count);
+    if (count == 0) {
+        cellsPerSide = 0;
+        slabHalfHeight = 0.0f;
+        outerReach = 0.0f;
+        innerReach = 0.0f;
+        cells.clear();
+        items.clear();
+        return;
+    }
+    if (!pool) {
+        pool = std::make_unique<ThreadPool>(threadCount);
+    }
+    const std::size_t chunks = (count + BUILD_CHUNK - 1) / BUILD_CHUNK;
+    const auto chunkEnd = [&](const std::size_t chunk) { return std::min(count, (chunk + 1) * BUILD_CHUNK); };
+
+    // Orbit positions, and how far out and off the plane each chunk reaches
+    struct Extent {
+        float inner = 1e30f;
+        float reach = 0.0f;
+        float slab = 0.0f;
+        float radius = 0.0f;
+    };
+    std::vector<Extent> extents(chunks);
+    pool->parallelFor(chunks, [&](const std::size_t chunk) {
+        Extent &extent = extents[chunk];
+        for (std::size_t i = chunk * BUILD_CHUNK; i < chunkEnd(chunk); i++) {
+            const Body &body = bodies[i];
+            const float angle = time * body.speed + body.phase;
+            instances[i] = {Vec3(std::cos(angle) * body.orbitRadius, body.height, std::sin(angle) * body.orbitRadius),
+                            body.radius, body.color, 0.0f};
+            extent.inner = std::min(extent.inner, body.orbitRadius - body.radius);
+            extent.reach = std::max(extent.reach, body.orbitRadius + body.radius);
+            extent.slab = std::max(extent.slab, std::abs(body.height) + body.radius);
+            extent.radius = std::max(extent.radius, body.radius);
+        }
+    });
+    float maxRadius = 0.0f;
+    innerReach = 1e30f;
+    outerReach = 0.0f;
+    slabHalfHeight = 0.0f;
+    for (const Extent &extent : extents) {
+        innerReach = std::min(innerReach, extent.inner);
+        outerReach = std::max(outerReach, extent.reach);
+        slabHalfHeight = std::max(slabHalfHeight, extent.slab);
+        maxRadius = std::max(maxRadius, extent.radius);
+    }
+
+    // About four cells per body, but none smaller than the largest body, so
+    // a body spans at most four cells
+    const int byCount = static_cast<int>(std::ceil(2.0f * std::sqrt(static_cast<float>(count))));
+    const int bySize = maxRadius > 0.0f ? static_cast<int>(outerReach / maxRadius) : MAX_RESOLUTION;
+    cellsPerSide = std::clamp(std::min(byCount, bySize), 1, MAX_RESOLUTION);
+    cell = std::max(2.0f * outerReach / static_cast<float>(cellsPerSide), 1e-6f);
+    origin[0] = -outerReach;
+    origin[1] = -outerReach;
+
+    // Bin: count the bodies of every cell, hand each cell its range of the
+    // item array, then fill the ranges
+    const int cellCount = cellsPerSide * cellsPerSide;
+    std::vector<std::atomic<int>> fill(cellCount);
+    const auto forEachCell = [&](const std::size_t chunk, const auto &visit) {
+        int range[4];
+        for (std::size_t i = chunk * BUILD_CHUNK; i < chunkEnd(chunk); i++) {
+            footprint(instances[i], range);
+            for (int z = range[2]; z <= range[3]; z++) {
+                for (int x = range[0]; x <= range[1]; x++) {
+                    visit(z * cellsPerSide + x, static_cast<int>(i));
+                }
+            }
+        }
+    };
+    pool->parallelFor(chunks, [&](const std::size_t chunk) {
+        forEachCell(chunk, [&](const int c, int) { fill[c].fetch_add(1, std::memory_order_relaxed); });
+    });
+    cells.resize(2 * static_cast<std::size_t>(cellCount));
+    int total = 0;
+    for (int c = 0; c < cellCount; c++) {
+        cells[2 * c] = total;
+        cells[2 * c + 1] = fill[c].load(std::memory_order_relaxed);
+        total += cells[2 * c + 1];
+        fill[c].store(0, std::memory_order_relaxed);
+    }
+    order.resize(total);
+    pool->parallelFor(chunks, [&](const std::size_t chunk) {
+        forEachCell(chunk, [&](const int c, const int body) {
+            order[cells[2 * c] + fill[c].fetch_add(1, std::memory_order_relaxed)] = body;
+        });
+    });
+
+    // The fill order depends on the threads; sorting each cell by body index
+    // makes the items, and so which of two equally near bodies is hit, the
+    // same on every run
+    items.resize(total);
+    pool->parallelFor(cellsPerSide, [&](const std::size_t row) {
+        for (int c = static_cast<int>(row) * cellsPerSide; c < static_cast<int>(row + 1) * cellsPerSide; c++) {
+            const int first = cells[2 * c];
+            const int last = first + cells[2 * c + 1];
+            std::sort(order.begin() + first, order.begin() + last);
+            for (int k = first; k < last; k++) {
+                items[k] = instances[order[k]];
+            }
+        }
+    });
+}
+
+void BodyGrid::attach(FrameUniforms &u) const {
+    if (items.empty()) {
+        return;
+    }
+    u.bodies = this;
+    u.planetReach = std::max(u.planetReach, outerReach);
+}
+
+bool BodyGrid::segment(const Vec3 &a, const Vec3 &b, float &t, int &item) const {
+    if (items.empty() || std::min(a.y, b.y) > slabHalfHeight || std::max(a.y, b.y) < -slabHalfHeight) {
+        return false;
+    }
+    // Both ends inside the belt's inner edge: so is the whole segment
+    const float innerSq = innerReach * innerReach;
+    if (a.x * a.x + a.z * a.z < innerSq && b.x * b.x + b.z * b.z < innerSq) {
+        return false;
+    }
+
+    // In grid coordinates, clipped to the grid square and the current hit
+    const float n = static_cast<float>(cellsPerSide);
+    const float p[2] = {(a.x - origin[0]) / cell, (a.z - origin[1]) / cell};
+    const float d[2] = {(b.x - a.x) / cell, (b.z - a.z) / cell};
+    float t0 = 0.0f;
+    float t1 = std::min(t, 1.0f);
+    for (int k = 0; k < 2; k++) {
+        if (d[k] == 0.0f) {
+            if (p[k] < 0.0f || p[k] > n) return false;
+            continue;
+        }
+        const float ta = -p[k] / d[k];
+        const float tb = (n - p[k]) / d[k];
+        t0 = std::max(t0, std::min(ta, tb));
+        t1 = std::min(t1, std::max(ta, tb));
+    }
+    if (t0 > t1) {
+        return false;
+    }
+
+    // Walk the cells nearest first (2D DDA) until the next one starts past the hit
+    int c[2];
+    int step[2];
+    float tNext[2];
+    float tDelta[2];
+    for (int k = 0; k < 2; k++) {
+        c[k] = std::clamp(static_cast<int>(std::floor(p[k] + d[k] * t0)), 0, cellsPerSide - 1);
+        step[k] = d[k] > 0.0f ? 1 : -1;
+        tDelta[k] = d[k] != 0.0f ? 1.0f / std::abs(d[k]) : 1e30f;
+        tNext[k] = d[k] != 0.0f ? (static_cast<float>(c[k] + (d[k] > 0.0f ? 1 : 0)) - p[k]) / d[k] : 1e30f;
+    }
+    bool hit = false;
+    for (float tCell = t0; tCell <= std::min(t1, t);) {
+        const int index = 2 * (c[1] * cellsPerSide + c[0]);
+        for (int k = cells[index]; k < cells[index] + cells[index + 1]; k++) {
+            if (const float tk = cpu::segmentSphere(a, b, items[k].position, items[k].radius); tk < t) {
+                t = tk;
+                item = k;
+                hit = true;
+            }
+        }
+        const int axis = tNext[0] < tNext[1] ? 0 : 1;
+        tCell = tNext[axis];
+        tNext[axis] += tDelta[axis];
+        c[axis] += step[axis];
+        if (c[axis] < 0 || c[axis] >= cellsPerSide) break;
+    }
+    return hit;
+}
+
+std::vector<Body> asteroidBelt(const int count, const float innerRadius, const float outerRadius) {
+    // mt19937 output is the same on every platform, unlike the std distributions
+    std::mt19937 random(1);
+    const auto uniform = [&](const float lo, const float hi) {
+        return lo + (hi - lo) * static_cast<float>(random() >> 8) * (1.0f / 16777216.0f);
+    };
+    std::vector<Body> belt(std::max(count, 0));
+    for (Body &body : belt) {
+        body.orbitRadius = uniform(innerRadius, outerRadius);
+        // Kepler's third law, through the inner planet's orbit (18 at 0.1 rad/s)
+        body.speed = 0.1f * std::pow(18.0f / body.orbitRadius, 1.5f);
+        body.phase = uniform(0.0f, 6.2831853f);
+        body.height = uniform(-0.4f, 0.4f) * uniform(0.0f, 1.0f);
+        // Mostly pebbles, a few boulders
+        const float size = uniform(0.0f, 1.0f);
+        body.radius = 0.04f + 0.16f * size * size * size;
+        const float shade = uniform(0.3f, 0.6f);
+        body.color = Vec3(shade, shade * 0.9f, shade * 0.8f);
+    }
+    return belt;
+}
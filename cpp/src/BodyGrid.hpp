@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Math.hpp"
+#include "Simulation.hpp"
+#include "ThreadPool.hpp"
+
+// Uniform grid over the small bodies (SimParams::bodies) in the disk plane,
+// rebuilt every frame as they orbit. Every body lies in a thin slab around
+// the plane, so the grid is 2D: each body goes into all the cells its
+// bounding square overlaps, and a segment only tests the bodies of the cells
+// its xz projection crosses, nearest cell first. The cost per step follows
+// the bodies near the ray, not how many there are.
+//
+// Cells hold ranges into one item array (bodies repeated per cell); the GPU
+// gets both as textures (u_bodyCells and u_bodyItems in BLACKHOLE_FRAG_SRC).
+class BodyGrid {
+public:
+    // Limits the cell table to 256 x 256 (512 KB)
+    static constexpr int MAX_RESOLUTION = 256;
+
+    // threadCount == 0 uses one thread per hardware core; the pool is only
+    // started by the first build with bodies in it
+    explicit BodyGrid(unsigned threadCount = 0);
+
+    // Moves the bodies to their place at 'time' and bins them again
+    void build(const std::vector<Body> &bodies, float time);
+    // Points u at this grid and widens u.planetReach to the bodies; leaves u
+    // alone while the grid is empty
+    void attach(FrameUniforms &u) const;
+
+    // First body hit on segment a->b with entry parameter below t: lowers t,
+    // writes the body's item index and returns true
+    bool segment(const Vec3 &a, const Vec3 &b, float &t, int &item) const;
+
+    [[nodiscard]] bool empty() const { return items.empty(); }
+    // Cells per side; the grid starts at (originX, originZ) in the disk plane
+    [[nodiscard]] int resolution() const { return cellsPerSide; }
+    [[nodiscard]] float originX() const { return origin[0]; }
+    [[nodiscard]] float originZ() const { return origin[1]; }
+    [[nodiscard]] float cellSize() const { return cell; }
+    // Every body lies within this of the disk plane
+    [[nodiscard]] float slab() const { return slabHalfHeight; }
+    // Outermost orbit plus its body's radius
+    [[nodiscard]] float reach() const { return outerReach; }
+    // No body comes closer than this to the hole's axis
+    [[nodiscard]] float innerRadius() const { return innerReach; }
+
+    // First item and item count of every cell, x fastest
+    [[nodiscard]] const std::vector<std::int32_t> &cellRanges() const { return cells; }
+    [[nodiscard]] const std::vector<PlanetInstance> &cellItems() const { return items; }
+    [[nodiscard]] const PlanetInstance &item(const int index) const { return items[index]; }
+
+private:
+    // Cell range [x0, x1] x [z0, z1] overlapped by a sphere's bounding square
+    void footprint(const PlanetInstance &body, int range[4]) const;
+
+    unsigned threadCount;
+    std::unique_ptr<ThreadPool> pool;
+    int cellsPerSide = 0;
+    float origin[2] = {0.0f, 0.0f};
+    float cell = 1.0f;
+    float slabHalfHeight = 0.0f;
+    float outerReach = 0.0f;
+    float innerReach = 0.0f;
+    std::vector<PlanetInstance> instances; // one per body
+    std::vector<int> order;                // body index of every item
+    std::vector<std::int32_t> cells;
+    std::vector<PlanetInstance> items;
+};
+
+// Rocky bodies with Kepler speeds between two orbit radii, scattered a
+// little above and below the disk plane. The same count gives the same belt.
+std::vector<Body> asteroidBelt(int count, float innerRadius = 22.0f, float outerRadius = 26.0f);
@@ -0,0 +1,73 @@
+#include "CpuRenderer.hpp"
+
+#include "CpuShaders.hpp"
+#include "SkyCubemap.hpp"
+
+CpuRenderer::CpuRenderer(const unsigned threadCount, const PacketKernel *kernel)
+    : pool(threadCount), kernel(kernel) {
+}
+
+void CpuRenderer::render(const FrameUniforms &u, Image &target) {
+    const int width = static_cast<int>(u.resolution[0]);
+    const int height = static_cast<int>(u.resolution[1]);
+    if (target.width != width || target.height != height) {
+        target.resize(width, height);
+    }
+
+    // Bake the sky up front on this pool rather than inside one of its tasks
+    if (u.enableStarfield) {
+        SkyCubemap::get(pool);
+    }
+
+    const int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    const int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    pool.parallelFor(static_cast<std::size_t>(tilesX) * tilesY, [&](const std::size_t tile) {
+        renderTile(u, target, static_cast<int>(tile % tilesX), static_cast<int>(tile / tilesX));
+    });
+}
+
+static std::uint8_t toUnorm8(const float c) {
+    return static_cast<std::uint8_t>(glsl::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+void CpuRenderer::renderTile(const FrameUniforms &u, Image &target, const int tileX, const int tileY) const {
+    const int x0 = tileX * TILE_SIZE;
+    const int y0 = tileY * TILE_SIZE;
+    const int x1 = std::min(x0 + TILE_SIZE, target.width);
+    const int y1 = std::min(y0 + TILE_SIZE, target.height);
+    const int tileWidth = x1 - x0;
+    const int count = tileWidth * (y1 - y0);
+
+    const bool packets = kernel && cpu::needsMarching(u) && !cpu::useDeflectionLut(u) && !cpu::useGeodesic(u) &&
+                         !cpu::useKerr(u) && !cpu::useBinet(u);
+
+    // Pixel centers, matching gl_FragCoord
+    Vec3 colors[TILE_SIZE * TILE_SIZE];
+    if (packets) {
+        Vec3 rayDirs[TILE_SIZE * TILE_SIZE];
+        for (int i = 0; i < count; i++) {
+            rayDirs[i] = cpu::primaryRayDir(u, static_cast<float>(x0 + i % tileWidth) + 0.5f,
+                                            static_cast<float>(y0 + i / tileWidth) + 0.5f);
+        }
+        rayMarchWavefront(u, *kernel, rayDirs, count, colors);
+        for (int i = 0; i < count; i++) {
+            colors[i] = cpu::finishColor(colors[i]);
+        }
+    } else {
+        for (int i = 0; i < count; i++) {
+            colors[i] = cpu::shadePixel(u, static_cast<float>(x0 + i % tileWidth) + 0.5f,
+                                        static_cast<float>(y0 + i / tileWidth) + 0.5f);
+        }
+    }
+
+    for (int y = y0; y < y1; y++) {
+        std::uint8_t *row = target.row(y);
+        const Vec3 *rowColors = colors + (y - y0) * tileWidth;
+        for (int x = x0; x < x1; x++) {
+            row[x * 4 + 0] = toUnorm8(rowColors[x - x0].x);
+            row[x * 4 + 1] = toUnorm8(rowColors[x - x0].y);
+            row[x * 4 + 2] = toUnorm8(rowColors[x - x0].z);
+            row[x * 4 + 3] = 255;
+        }
+    }
+}
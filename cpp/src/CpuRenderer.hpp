@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Image.hpp"
+#include "RayPacket.hpp"
+#include "Simulation.hpp"
+#include "ThreadPool.hpp"
+
+// Multithreaded reference implementation of the fragment shader pass. The
+// frame is split into square tiles that worker threads pull dynamically, so
+// expensive regions (disk, photon ring) don't leave cores idle.
+class CpuRenderer {
+public:
+    static constexpr int TILE_SIZE = 16;
+
+    // threadCount == 0 uses one thread per hardware core. Each tile is
+    // marched as one wavefront of ray packets with 'kernel'; nullptr marches
+    // one ray per pixel with cpu::shadePixel.
+    explicit CpuRenderer(unsigned threadCount = 0, const PacketKernel *kernel = &bestPacketKernel());
+
+    // Renders a frame of u.resolution size into 'target' (resized as needed)
+    void render(const FrameUniforms &u, Image &target);
+
+    [[nodiscard]] unsigned threadCount() const { return pool.size(); }
+    [[nodiscard]] const PacketKernel *packetKernel() const { return kernel; }
+
+private:
+    void renderTile(const FrameUniforms &u, Image &target, int tileX, int tileY) const;
+
+    ThreadPool pool;
+    const PacketKernel *kernel;
+};
@@ -0,0 +1,923 @@
+#include "CpuShaders.hpp"
+
+#include "BodyGrid.hpp"
+#include "DeflectionTable.hpp"
+#include "SkyCubemap.hpp"
+
+namespace cpu {
+
+using glsl::clamp;
+using glsl::fract;
+using glsl::mix;
+using glsl::smoothstep;
+
+constexpr float PI = 3.14159265359f;
+
+// Physics
+constexpr float G = 1.0f;
+
+// Utility Functions
+float random(const Vec2 &st) {
+    return fract(std::sin(st.dot(Vec2(12.9898f, 78.233f))) * 43758.5453123f);
+}
+
+float noise(const Vec2 &st) {
+    const Vec2 i = glsl::floor(st);
+    const Vec2 f = glsl::fract(st);
+    const float a = random(i);
+    const float b = random(i + Vec2(1.0f, 0.0f));
+    const float c = random(i + Vec2(0.0f, 1.0f));
+    const float d = random(i + Vec2(1.0f, 1.0f));
+    const Vec2 u = f * f * (Vec2(3.0f, 3.0f) - f * 2.0f);
+    return mix(a, b, u.x) + (c - a) * u.y * (1.0f - u.x) + (d - b) * u.x * u.y;
+}
+
+// Procedural Starfield (background)
+float fbm(Vec2 p) {
+    float a = 0.5f;
+    float f = 0.0f;
+    float sum = 0.0f;
+    for (int k = 0; k < 4; k++) {
+        f += a * noise(p);
+        sum += a;
+        p = p * 2.03f + Vec2(17.7f, 11.3f);
+        a *= 0.5f;
+    }
+    return (sum > 0.0f) ? (f / sum) : 0.0f;
+}
+
+Vec2 skyCoord(const Vec3 &rd) {
+    const float lon = std::atan2(rd.z, rd.x);
+    const float lat = std::asin(clamp(rd.y, -1.0f, 1.0f));
+    return Vec2(lon / (2.0f * PI) + 0.5f, lat / PI + 0.5f);
+}
+
+float starTwinkle(const float seed, const float t) {
+    return 0.88f + 0.22f * std::sin(t * (5.0f + 11.0f * seed) + seed * 6.28318f);
+}
+
+Vec3 starLayer(const Vec3 &rd, float &seed) {
+    const Vec2 uv = skyCoord(rd);
+
+    const Vec2 GRID(520.0f, 260.0f);
+    const Vec2 gUV = uv * GRID;
+    const Vec2 baseCell = glsl::floor(gUV);
+    const Vec2 f = glsl::fract(gUV);
+
+    Vec3 color;
+    float brightest = 0.0f;
+    seed = 0.0f;
+
+    for (int j = -1; j <= 1; j++) {
+        for (int i = -1; i <= 1; i++) {
+            const Vec2 cid = baseCell + Vec2(static_cast<float>(i), static_cast<float>(j));
+            const Vec2 off(
+                random(cid + Vec2(13.1f, 17.7f)),
+                random(cid + Vec2(27.3f, 39.5f))
+            );
+            const Vec2 d = (Vec2(static_cast<float>(i), static_cast<float>(j)) + off) - f;
+            const float dist = d.length();
+
+            const float sizeRnd = random(cid + Vec2(3.7f, 5.1f));
+            const float size = 0.018f + 0.12f * sizeRnd * sizeRnd;
+
+            const float bRnd = random(cid + Vec2(1.3f, 2.1f));
+            float baseB = std::pow(bRnd, 10.0f);
+            const float rare = glsl::step(0.985f, random(cid + Vec2(4.2f, 7.9f)));
+            baseB += rare * 0.6f;
+
+            const float twR = random(cid + Vec2(9.2f, 6.4f));
+
+            float core = smoothstep(size, 0.0f, dist);
+            core = core * core;
+            const float halo = smoothstep(2.5f * size, 0.0f, dist) * 0.35f;
+            const float starM = core + halo;
+            const float intensity = baseB * starM;
+            if (intensity > brightest) {
+                brightest = intensity;
+                seed = twR;
+            }
+
+            const float temp = random(cid + Vec2(2.7f, 8.9f));
+            const Vec3 starCol = mix(Vec3(1.0f, 0.92f, 0.86f), Vec3(0.75f, 0.86f, 1.0f), temp);
+            color += starCol * intensity;
+        }
+    }
+    return color;
+}
+
+Vec3 nebulaLayer(const Vec3 &rd) {
+    const Vec2 uv = skyCoord(rd);
+    const Vec3 galN = Vec3(0.0f, 0.2f, 1.0f).normalize();
+    const float band = std::pow(1.0f - std::abs(rd.dot(galN)), 2.0f);
+
+    const float nebBase = fbm(uv * Vec2(8.0f, 4.0f));
+    const float nebDetail = fbm((uv + Vec2(0.17f, 0.03f)) * Vec2(16.0f, 8.0f));
+    const float nebMask = smoothstep(0.55f, 0.9f, band) * smoothstep(0.35f, 0.85f, nebBase);
+    const float neb = clamp(0.0f + 0.9f * nebBase + 0.4f * nebDetail, 0.0f, 1.6f) * nebMask;
+
+    const Vec3 nebColA(0.12f, 0.16f, 0.22f);
+    const Vec3 nebColB(0.18f, 0.12f, 0.20f);
+    return mix(nebColA, nebColB, nebDetail) * (0.06f * neb);
+}
+
+Vec3 starField(const FrameUniforms &u, const Vec3 &rd, const float t) {
+    const SkyCubemap &sky = SkyCubemap::get();
+    const float texelAngle = 0.5f * PI / static_cast<float>(SkyCubemap::STARS_SIZE);
+    const float lod = std::max(std::log2(1.0f / (u.resolution[1] * texelAngle)) - 1.0f, 0.0f);
+    float seed;
+    const Vec3 stars = sky.stars(rd, lod, seed);
+    const Vec3 color = stars * starTwinkle(seed, t) + sky.nebula(rd);
+    return Vec3(color.x / (1.0f + color.x), color.y / (1.0f + color.y), color.z / (1.0f + color.z));
+}
+
+Vec3 shadePlanet(const FrameUniforms &u, const Vec3 &p, const int planet) {
+    const PlanetInstance &look = planet < MAX_PLANETS ? u.planets[planet] : u.bodies->item(planet - MAX_PLANETS);
+    const Vec3 normal = (p - look.position).normalize();
+    const Vec3 lightDir = (-look.position).normalize();
+    const float diffuse = std::max(0.0f, normal.dot(lightDir)) * (0.7f - 0.1f * look.bands) + 0.3f + 0.1f * look.bands;
+
+    Vec3 color = look.color;
+    if (look.bands > 0.0f) {
+        const float n = noise(Vec2(p.x, p.y) * 3.0f) * 0.5f + noise(Vec2(p.y, p.z) * 6.0f) * 0.5f;
+        color = mix(color, Vec3(0.9f, 0.9f, 0.9f), n * look.bands);
+    }
+    return color * diffuse;
+}
+
+Vec3 getDiskSample(const FrameUniforms &u, const Vec3 &p, float &alpha) {
+    const Vec2 xz(p.x, p.z);
+    const float r = xz.length();
+
+    const float theta = std::atan2(xz.y, xz.x);
+    const float omega = 1.6f * std::pow(std::max(r, 0.25f), -1.5f);
+    const float thetaFlow = theta - u.time * omega;
+
+    const float logr = std::log(std::max(r, 0.0007f));
+    float n = 0.0f;
+    n += 1.00f * noise(Vec2(logr * 2.7f, std::sin(thetaFlow)));
+    n += 0.50f * noise(Vec2(logr * 5.11f + 17.0f, std::cos(thetaFlow)));
+    n += 0.25f * noise(Vec2(logr * 9.30f - 11.0f, std::sin(thetaFlow * 2.0f)));
+    n = clamp(n / 1.75f, 0.0f, 1.0f);
+
+    constexpr float arms = 3.0f;
+    constexpr float pitch = 4.0f;
+    const float spiralPhase = arms * (thetaFlow + std::log(std::max(r, 0.0005f)) * pitch);
+    const float armMask = std::pow(0.5f + 0.5f * std::cos(spiralPhase), 2.0f);
+
+    const float radial = smoothstep(u.diskInnerRadius, u.diskOuterRadius, r);
+    const float armGain = mix(1.35f, 1.1f, radial);
+    const float intensity = std::pow(n, 1.5f) * armGain * mix(0.7f, 1.2f, armMask) * (1.15f - 0.65f * radial);
+
+    const Vec3 colInner(0.98f, 0.98f, 1.0f);
+    const Vec3 colMid(1.0f, 0.85f, 0.55f);
+    const Vec3 colOuter(1.0f, 0.55f, 0.22f);
+    Vec3 color = mix(colInner, colMid, smoothstep(0.0f, 0.6f, radial));
+    color = mix(color, colOuter, smoothstep(0.4f, 1.0f, radial));
+
+    const float v = 0.8f * std::pow(std::max(r, 0.25f), -0.5f);
+    const Vec3 velDir3 = Vec3(-p.z, 0.0f, p.x).normalize();
+    const Vec3 viewDir = (u.cameraPosition - p).normalize();
+    const float dop = clamp(velDir3.dot(viewDir) * v, -1.0f, 1.0f);
+    color.x *= (1.0f - 0.35f * std::max(dop, 0.0f));
+    color.z *= (1.0f + 0.55f * std::max(-dop, 0.0f));
+
+    const float falloff = 1.0f - smoothstep(u.diskInnerRadius, u.diskOuterRadius, r);
+    const Vec3 emissive = color * (intensity * (2.2f + 1.3f * (1.0f - radial)) * falloff);
+    constexpr float baseAlpha = 0.33f;
+    alpha = baseAlpha * falloff * clamp(intensity * (1.1f + 0.4f * (1.0f - radial)), 0.1f, 1.0f);
+    return emissive;
+}
+
+float sceneRadius(const FrameUniforms &u) {
+    float reach = 0.0f;
+    if (u.enableLensing) reach = std::max(u.lensMaxRadius, u.schwarzschildRadius + EPSILON);
+    if (u.enableDisk) reach = std::max(reach, u.diskOuterRadius);
+    if (u.enablePlanets) {
+        reach = std::max(reach, u.planetReach);
+    }
+    return reach;
+}
+
+Vec3 traceStraight(const FrameUniforms &u, const Vec3 &rayOrigin, const Vec3 &rayDir, const float farDist) {
+    Vec3 accColor;
+    float transmittance = 1.0f;
+    const float tca = -rayOrigin.dot(rayDir);
+    const float tFar =
+        std::max(tca + std::sqrt(std::max(farDist * farDist - rayOrigin.dot(rayOrigin) + tca * tca, 0.0f)), 0.0f);
+
+    int planet;
+    const float tPlanet = segmentPlanets(u, rayOrigin, rayOrigin + rayDir * tFar, planet);
+    const float tEnd = (tPlanet <= 1.0f) ? tPlanet * tFar : tFar;
+
+    const float tDisk = (std::abs(rayDir.y) > 1e-6f) ? -rayOrigin.y / rayDir.y : -1.0f;
+    if (u.enableDisk && tDisk > 0.0f && tDisk < tEnd) {
+        const Vec3 hit = rayOrigin + rayDir * tDisk;
+        const float r_hit = Vec2(hit.x, hit.z).length();
+        if (r_hit > u.diskInnerRadius && r_hit < u.diskOuterRadius) {
+            float diskAlpha;
+            const Vec3 disk = getDiskSample(u, hit, diskAlpha);
+            accColor += disk * transmittance;
+            transmittance *= (1.0f - diskAlpha);
+            if (transmittance < 0.02f) {
+                return accColor;
+            }
+        }
+    }
+
+    if (tPlanet <= 1.0f) {
+        accColor += shadePlanet(u, rayOrigin + rayDir * tEnd, planet) * transmittance;
+        return accColor;
+    }
+    if (u.enableStarfield) {
+        accColor += starField(u, rayDir, u.time) * transmittance;
+    }
+    return accColor;
+}
+
+Vec3 rayMarch(const FrameUniforms &u, const Vec3 &rayOrigin, Vec3 rayDir) {
+    Vec3 accColor;
+    float transmittance = 1.0f;
+    Vec3 p = rayOrigin;
+    const float farDist = (u.farDist > 0.0f) ? u.farDist : MAX_DIST;
+    if (!u.enableLensing) {
+        return traceStraight(u, rayOrigin, rayDir, farDist);
+    }
+
+    // Nothing happens outside sceneRadius: rays that miss the sphere go
+    // straight to the sky, the rest start marching where they enter it
+    const float reach = sceneRadius(u);
+    const float tca = -p.dot(rayDir);
+    const float missDistSq = p.dot(p) - tca * tca;
+    if (p.dot(p) > reach * reach) {
+        if (tca <= 0.0f || missDistSq >= reach * reach) {
+            if (u.enableStarfield) {
+                accColor += starField(u, rayDir, u.time);
+            }
+            return accColor;
+        }
+        p += rayDir * (tca - std::sqrt(reach * reach - missDistSq));
+    }
+
+    for (int i = 0; i < MAX_STEPS; i++) {
+        if (i >= u.maxSteps) break;
+        const Vec3 p_prev = p;
+
+        // Event horizon check
+        if (u.enableLensing) {
+            if (p.length() < u.schwarzschildRadius + EPSILON) {
+                return accColor;
+            }
+        }
+
+        // Apply gravitational lensing
+        const float r = p.length();
+        const float distToCenterSq = std::max(r * r, 1e-4f);
+        float stepSize = u.stepSize;
+        stepSize += stepSize * smoothstep(u.diskOuterRadius + 2.0f, farDist, r) * 2.5f;
+        stepSize *= 1.0f + 1.2f * smoothstep(0.5f, 3.0f, std::abs(p.y));
+
+        if (u.enableLensing && r < u.lensMaxRadius) {
+            const Vec3 gravityDir = (r > 1e-6f) ? -p * (1.0f / r) : Vec3(0.0f, 0.0f, 0.0f);
+            const Vec3 acceleration = gravityDir * ((G * u.mass) / distToCenterSq);
+            rayDir = (rayDir + acceleration * stepSize).normalize();
+        }
+        p += rayDir * stepSize;
+
+        // Planets hit anywhere on the step, not just at its ends
+        int planet;
+        const float tPlanet = segmentPlanets(u, p_prev, p, planet);
+
+        // Disk intersection before the planet
+        if (u.enableDisk && p_prev.y * p.y < 0.0f) {
+            const float t = -p_prev.y / (p.y - p_prev.y);
+            const Vec3 hit = p_prev + (p - p_prev) * t;
+            const float r_hit = Vec2(hit.x, hit.z).length();
+            if (t < tPlanet && r_hit > u.diskInnerRadius && r_hit < u.diskOuterRadius) {
+                float diskAlpha;
+                const Vec3 disk = getDiskSample(u, hit, diskAlpha);
+                accColor += disk * transmittance;
+                transmittance *= (1.0f - diskAlpha);
+                if (transmittance < 0.02f) {
+                    return accColor;
+                }
+            }
+        }
+
+        if (tPlanet <= 1.0f) {
+            accColor += shadePlanet(u, mix(p_prev, p, tPlanet), planet) * transmittance;
+            return accColor;
+        }
+
+        // Heading out past sceneRadius the ray stays straight and never comes back
+        if (const float rNext = p.length(); rNext > farDist || (rNext > reach && p.dot(rayDir) > 0.0f)) {
+            if (u.enableStarfield) {
+                accColor += starField(u, rayDir, u.time) * transmittance;
+            }
+            return accColor;
+        }
+    }
+
+    if (u.enableStarfield) {
+        accColor += starField(u, rayDir, u.time) * transmittance;
+    }
+    return accColor;
+}
+
+bool useDeflectionLut(const FrameUniforms &u) {
+    // Inside the photon sphere outgoing rays follow orbits the table doesn't hold
+    return u.lensingModel == LensingModel::DeflectionTable && u.enableLensing &&
+           u.cameraPosition.length() > 1.6f * u.schwarzschildRadius;
+}
+
+namespace {
+
+// Orbit of one camera ray in its plane: position at swept angle s is
+// r(s) * (cos(s) * e1 + sin(s) * e2) with e1 pointing at the camera
+struct LutOrbit {
+    Vec3 e1;
+    Vec3 e2;
+    float row;
+    float phi0;
+    float phiMax;
+    float uMax;
+    bool inbound;
+    bool captured;
+    float sweep;
+};
+
+LutOrbit lutOrbit(const FrameUniforms &u, const Vec3 &ro, const Vec3 &rd) {
+    const DeflectionTable &table = DeflectionTable::get();
+    LutOrbit o;
+    const float rs = u.schwarzschildRadius;
+    const float r0 = ro.length();
+    o.e1 = ro * (1.0f / r0);
+    const float cosPsi = rd.dot(o.e1);
+    const Vec3 tangent = rd - o.e1 * cosPsi;
+    const float sinPsi = tangent.length();
+    o.e2 = (sinPsi > 1e-6f) ? tangent * (1.0f / sinPsi) : o.e1.cross(Vec3(0.3f, 1.0f, 0.2f)).normalize();
+
+    // Impact parameter in units of rs, from the angle a static observer sees
+    const float impact = r0 * sinPsi / std::sqrt(std::max(1.0f - rs / r0, 1e-6f)) / rs;
+    o.row = DeflectionTable::rowCoord(impact);
+    const DeflectionTable::Sample rowInfo = table.sample(0.5f / DeflectionTable::COLUMNS, o.row);
+    o.phiMax = rowInfo.phiMax;
+    o.uMax = rowInfo.uMax;
+    o.phi0 = table.sample(DeflectionTable::phiColumn((rs / r0) / o.uMax), o.row).phi;
+
+    o.inbound = cosPsi < 0.0f;
+    o.captured = o.inbound && impact < DeflectionTable::CRITICAL_IMPACT;
+    if (!o.inbound) {
+        o.sweep = o.phi0;
+    } else if (o.captured) {
+        o.sweep = o.phiMax - o.phi0;
+    } else {
+        o.sweep = 2.0f * o.phiMax - o.phi0;
+    }
+    return o;
+}
+
+// Distance from the hole after sweeping s, capped at farDist
+float lutRadius(const FrameUniforms &u, const LutOrbit &o, const float s, const float farDist) {
+    float phi = o.inbound ? o.phi0 + s : o.phi0 - s;
+    if (phi > o.phiMax) phi = 2.0f * o.phiMax - phi;
+    const float x = DeflectionTable::get().sample(DeflectionTable::uColumn(phi / o.phiMax), o.row).x;
+    const float uu = x * o.uMax / u.schwarzschildRadius;
+    return std::min(1.0f / std::max(uu, 1e-6f), farDist);
+}
+
+Vec3 orbitPoint(const LutOrbit &o, const float s, const float r) {
+    return (o.e1 * std::cos(s) + o.e2 * std::sin(s)) * r;
+}
+
+} // namespace
+
+float segmentSphere(const Vec3 &a, const Vec3 &b, const Vec3 &center, const float radius) {
+    const Vec3 d = b - a;
+    const Vec3 m = a - center;
+    const float c = m.dot(m) - radius * radius;
+    if (c < 0.0f) return 0.0f;
+    const float A = d.dot(d);
+    const float B = m.dot(d);
+    const float disc = B * B - A * c;
+    if (disc < 0.0f || B > 0.0f) return 2.0f;
+    const float t = (-B - std::sqrt(disc)) / A;
+    return (t <= 1.0f) ? t : 2.0f;
+}
+
+float segmentPlanets(const FrameUniforms &u, const Vec3 &a, const Vec3 &b, int &planet) {
+    planet = -1;
+    if (!u.enablePlanets) {
+        return 2.0f;
+    }
+    float t = 2.0f;
+    if (std::min(a.y, b.y) <= u.planetMaxRadius && std::max(a.y, b.y) >= -u.planetMaxRadius) {
+        for (int i = 0; i < u.planetCount; i++) {
+            if (const float ti = segmentSphere(a, b, u.planets[i].position, u.planets[i].radius); ti < t) {
+                t = ti;
+                planet = i;
+            }
+        }
+    }
+    // Small bodies through their grid, numbered after the planets
+    if (int item; u.bodies && u.bodies->segment(a, b, t, item)) {
+        planet = MAX_PLANETS + item;
+    }
+    return t;
+}
+
+Vec3 rayMarchLut(const FrameUniforms &u, const Vec3 &rayOrigin, const Vec3 &rayDir) {
+    Vec3 accColor;
+    float transmittance = 1.0f;
+    const float farDist = (u.farDist > 0.0f) ? u.farDist : MAX_DIST;
+    const LutOrbit o = lutOrbit(u, rayOrigin, rayDir);
+
+    // Swept angles where the orbit plane meets the disk plane, every PI
+    float nextCrossing = 1e9f;
+    if (u.enableDisk && (std::abs(o.e1.y) > 1e-6f || std::abs(o.e2.y) > 1e-6f)) {
+        nextCrossing = std::atan2(-o.e1.y, o.e2.y);
+        if (nextCrossing <= 0.0f) nextCrossing += PI;
+    }
+
+    Vec3 a = rayOrigin;
+    float sa = 0.0f;
+    for (int i = 1; i <= LUT_SEGMENTS; i++) {
+        const float sb = o.sweep * static_cast<float>(i) / static_cast<float>(LUT_SEGMENTS);
+        const Vec3 b = orbitPoint(o, sb, lutRadius(u, o, sb, farDist));
+
+        // Planet hit on this chord
+        int planet;
+        const float tPlanet = segmentPlanets(u, a, b, planet);
+        const float sEnd = (tPlanet <= 1.0f) ? mix(sa, sb, tPlanet) : sb;
+
+        // Disk crossings before the planet
+        for (int k = 0; k < 4 && nextCrossing < sEnd; k++) {
+            const float r_hit = lutRadius(u, o, nextCrossing, farDist);
+            if (r_hit > u.diskInnerRadius && r_hit < u.diskOuterRadius) {
+                float diskAlpha;
+                const Vec3 disk = getDiskSample(u, orbitPoint(o, nextCrossing, r_hit), diskAlpha);
+                accColor += disk * transmittance;
+                transmittance *= (1.0f - diskAlpha);
+                if (transmittance < 0.02f) {
+                    return accColor;
+                }
+            }
+            nextCrossing += PI;
+        }
+
+        if (tPlanet <= 1.0f) {
+            accColor += shadePlanet(u, mix(a, b, tPlanet), planet) * transmittance;
+            return accColor;
+        }
+
+        a = b;
+        sa = sb;
+    }
+
+    if (!o.captured && u.enableStarfield) {
+        const Vec3 escapeDir = o.e1 * std::cos(o.sweep) + o.e2 * std::sin(o.sweep);
+        accColor += starField(u, escapeDir, u.time) * transmittance;
+    }
+    return accColor;
+}
+
+bool useGeodesic(const FrameUniforms &u) {
+    return u.lensingModel == LensingModel::Geodesic && u.enableLensing;
+}
+
+namespace {
+
+Vec3 geodesicAccel(const Vec3 &x, const float k) {
+    const float r2 = x.dot(x);
+    return x * (-k / (r2 * r2 * std::sqrt(r2)));
+}
+
+// Dormand-Prince tableau; the last row is the 5th-order solution, E the
+// difference to the embedded 4th-order one
+constexpr float A21 = 1.0f / 5.0f;
+constexpr float A31 = 3.0f / 40.0f, A32 = 9.0f / 40.0f;
+constexpr float A41 = 44.0f / 45.0f, A42 = -56.0f / 15.0f, A43 = 32.0f / 9.0f;
+constexpr float A51 = 19372.0f / 6561.0f, A52 = -25360.0f / 2187.0f, A53 = 64448.0f / 6561.0f,
+                A54 = -212.0f / 729.0f;
+constexpr float A61 = 9017.0f / 3168.0f, A62 = -355.0f / 33.0f, A63 = 46732.0f / 5247.0f, A64 = 49.0f / 176.0f,
+                A65 = -5103.0f / 18656.0f;
+constexpr float B1 = 35.0f / 384.0f, B3 = 500.0f / 1113.0f, B4 = 125.0f / 192.0f, B5 = -2187.0f / 6784.0f,
+                B6 = 11.0f / 84.0f;
+constexpr float E1 = 71.0f / 57600.0f, E3 = -71.0f / 16695.0f, E4 = 71.0f / 1920.0f, E5 = -17253.0f / 339200.0f,
+                E6 = 22.0f / 525.0f, E7 = -1.0f / 40.0f;
+
+} // namespace
+
+float dormandPrinceStep(const Vec3 &x, const Vec3 &v, const Vec3 &a, const float h, const float k, Vec3 &xNext,
+                        Vec3 &vNext, Vec3 &aNext) {
+    const Vec3 x2 = x + v * (h * A21);
+    const Vec3 v2 = v + a * (h * A21);
+    const Vec3 a2 = geodesicAccel(x2, k);
+
+    const Vec3 x3 = x + (v * A31 + v2 * A32) * h;
+    const Vec3 v3 = v + (a * A31 + a2 * A32) * h;
+    const Vec3 a3 = geodesicAccel(x3, k);
+
+    const Vec3 x4 = x + (v * A41 + v2 * A42 + v3 * A43) * h;
+    const Vec3 v4 = v + (a * A41 + a2 * A42 + a3 * A43) * h;
+    const Vec3 a4 = geodesicAccel(x4, k);
+
+    const Vec3 x5 = x + (v * A51 + v2 * A52 + v3 * A53 + v4 * A54) * h;
+    const Vec3 v5 = v + (a * A51 + a2 * A52 + a3 * A53 + a4 * A54) * h;
+    const Vec3 a5 = geodesicAccel(x5, k);
+
+    const Vec3 x6 = x + (v * A61 + v2 * A62 + v3 * A63 + v4 * A64 + v5 * A65) * h;
+    const Vec3 v6 = v + (a * A61 + a2 * A62 + a3 * A63 + a4 * A64 + a5 * A65) * h;
+    const Vec3 a6 = geodesicAccel(x6, k);
+
+    xNext = x + (v * B1 + v3 * B3 + v4 * B4 + v5 * B5 + v6 * B6) * h;
+    vNext = v + (a * B1 + a3 * B3 + a4 * B4 + a5 * B5 + a6 * B6) * h;
+    aNext = geodesicAccel(xNext, k);
+
+    // Difference to the embedded 4th-order solution
+    const Vec3 xErr = (v * E1 + v3 * E3 + v4 * E4 + v5 * E5 + v6 * E6 + vNext * E7) * h;
+    const Vec3 vErr = (a * E1 + a3 * E3 + a4 * E4 + a5 * E5 + a6 * E6 + aNext * E7) * h;
+    return std::max(xErr.length() / x.length(), vErr.length() / v.length()) / GEODESIC_TOLERANCE;
+}
+
+Vec3 rayMarchGeodesic(const FrameUniforms &u, const Vec3 &rayOrigin, const Vec3 &rayDir) {
+    Vec3 accColor;
+    float transmittance = 1.0f;
+    const float farDist = (u.farDist > 0.0f) ? u.farDist : MAX_DIST;
+
+    Vec3 x = rayOrigin;
+    Vec3 v = rayDir;
+    const Vec3 angularMomentum = x.cross(v);
+    const float k = 1.5f * u.schwarzschildRadius * angularMomentum.dot(angularMomentum);
+    Vec3 a = geodesicAccel(x, k);
+    float h = u.stepSize;
+
+    // Rejected steps count towards maxSteps too
+    const int maxSteps = std::min(u.maxSteps, MAX_STEPS);
+    for (int i = 0; i < maxSteps; i++) {
+        // Never step further than half the distance to the hole
+        h = std::min(h, 0.5f * x.length());
+        Vec3 xNext, vNext, aNext;
+        const float err = dormandPrinceStep(x, v, a, h, k, xNext, vNext, aNext);
+        h *= clamp(0.9f * std::pow(std::max(err, 1e-10f), -0.2f), 0.2f, 5.0f);
+        if (err > 1.0f) {
+            continue;
+        }
+
+        // Disk crossing and planet hit on the chord, nearest first
+        int planet;
+        const float tPlanet = segmentPlanets(u, x, xNext, planet);
+        if (u.enableDisk && x.y * xNext.y < 0.0f) {
+            const float t = x.y / (x.y - xNext.y);
+            const Vec3 hit = mix(x, xNext, t);
+            const float r_hit = std::sqrt(hit.x * hit.x + hit.z * hit.z);
+            if (t < tPlanet && r_hit > u.diskInnerRadius && r_hit < u.diskOuterRadius) {
+                float diskAlpha;
+                const Vec3 disk = getDiskSample(u, hit, diskAlpha);
+                accColor += disk * transmittance;
+                transmittance *= (1.0f - diskAlpha);
+                if (transmittance < 0.02f) {
+                    return accColor;
+                }
+            }
+        }
+        if (tPlanet <= 1.0f) {
+            accColor += shadePlanet(u, mix(x, xNext, tPlanet), planet) * transmittance;
+            return accColor;
+        }
+
+        x = xNext;
+        v = vNext;
+        a = aNext;
+
+        // Event horizon check
+        if (x.length() < u.schwarzschildRadius + EPSILON) {
+            return accColor;
+        }
+        if (x.length() > farDist) {
+            break;
+        }
+    }
+
+    if (u.enableStarfield) {
+        accColor += starField(u, v.normalize(), u.time) * transmittance;
+    }
+    return accColor;
+}
+
+bool useKerr(const FrameUniforms &u) {
+    return u.lensingModel == LensingModel::Kerr && u.enableLensing;
+}
+
+namespace {
+
+// (r, theta, r', theta') in Mino time
+struct KerrState {
+    float r, theta, dr, dTheta;
+
+    KerrState operator+(const KerrState &o) const { return {r + o.r, theta + o.theta, dr + o.dr, dTheta + o.dTheta}; }
+    KerrState operator*(const float h) const { return {r * h, theta * h, dr * h, dTheta * h}; }
+};
+
+KerrState kerrDerivatives(const KerrOrbit &o, const KerrState &y, float &dPhi) {
+    float s = std::sin(y.theta);
+    const float c = std::cos(y.theta);
+    s = s < 0.0f ? std::min(s, -1e-3f) : std::max(s, 1e-3f); // the axis is a coordinate singularity
+    const float p = y.r * y.r + o.a * o.a - o.a * o.L;
+    const float delta = std::max(y.r * y.r - 2.0f * o.m * y.r + o.a * o.a, 1e-4f);
+    dPhi = o.a * p / delta - o.a + o.L / (s * s);
+    return {y.dr, y.dTheta, 2.0f * y.r * p - (y.r - o.m) * o.K, c * (o.L * o.L / (s * s * s) - o.a * o.a * s)};
+}
+
+// Puts r' and theta' back on sqrt(R(r)) and sqrt(Theta(theta)), keeping their
+// signs; the second-order equations alone drift off the conserved values
+KerrState kerrConstrain(const KerrOrbit &o, KerrState y) {
+    const float p = y.r * y.r + o.a * o.a - o.a * o.L;
+    const float radial = p * p - (y.r * y.r - 2.0f * o.m * y.r + o.a * o.a) * o.K;
+    const float c2 = std::cos(y.theta) * std::cos(y.theta);
+    const float polar =
+        o.K - (o.L - o.a) * (o.L - o.a) + c2 * (o.a * o.a - o.L * o.L / std::max(1.0f - c2, 1e-6f));
+    if (radial > 0.0f) y.dr = (y.dr < 0.0f ? -1.0f : 1.0f) * std::sqrt(radial);
+    if (polar > 0.0f) y.dTheta = (y.dTheta < 0.0f ? -1.0f : 1.0f) * std::sqrt(polar);
+    return y;
+}
+
+Vec3 kerrToCartesian(const KerrOrbit &o, const float r, const float theta, const float phi) {
+    const float rho = std::sqrt(r * r + o.a * o.a) * std::sin(theta);
+    return {rho * std::cos(phi), r * std::cos(theta), rho * std::sin(phi)};
+}
+
+} // namespace
+
+Vec3 rayMarchKerr(const FrameUniforms &u, const Vec3 &rayOrigin, const Vec3 &rayDir) {
+    Vec3 accColor;
+    float transmittance = 1.0f;
+    const float farDist = (u.farDist > 0.0f) ? u.farDist : MAX_DIST;
+
+    KerrOrbit o{};
+    o.m = 0.5f * u.schwarzschildRadius;
+    o.a = u.spin * o.m;
+    const float a2 = o.a * o.a;
+    const float horizon = o.m + std::sqrt(std::max(o.m * o.m - a2, 0.0f));
+
+    // Boyer-Lindquist position of the camera
+    Vec3 x = rayOrigin;
+    const float w = x.dot(x) - a2;
+    const float r = std::sqrt(0.5f * (w + std::sqrt(w * w + 4.0f * a2 * x.y * x.y)));
+    if (r < horizon * 1.01f) {
+        return accColor;
+    }
+    const float theta = std::acos(clamp(x.y / r, -1.0f, 1.0f));
+    float phi = std::atan2(x.z, x.x);
+
+    // Coordinate velocity of the ray (the inverse Jacobian of kerrToCartesian)
+    const float s = std::max(std::sin(theta), 1e-3f);
+    const float c = std::cos(theta);
+    const float rho = std::sqrt(r * r + a2);
+    const float sigma = r * r + a2 * c * c;
+    const float horizontal = std::cos(phi) * rayDir.x + std::sin(phi) * rayDir.z;
+    const float tangential = std::cos(phi) * rayDir.z - std::sin(phi) * rayDir.x;
+    const float dr = rho * (r * s * horizontal + rho * c * rayDir.y) / sigma;
+    const float dTheta = (rho * c * horizontal - r * s * rayDir.y) / sigma;
+    const float dPhi = tangential / (rho * s);
+
+    // dt from the null condition, then E, L and Q from the metric
+    const float delta = r * r - 2.0f * o.m * r + a2;
+    const float gtt = std::min(-(1.0f - 2.0f * o.m * r / sigma), -1e-4f);
+    const float gtphi = -2.0f * o.m * o.a * r * s * s / sigma;
+    const float gphiphi = (r * r + a2 + 2.0f * o.m * a2 * r * s * s / sigma) * s * s;
+    const float spatial = gphiphi * dPhi * dPhi + sigma / delta * dr * dr + sigma * dTheta * dTheta;
+    const float dt = (-gtphi * dPhi - std::sqrt(std::max(gtphi * gtphi * dPhi * dPhi - gtt * spatial, 0.0f))) / gtt;
+    const float energy = -(gtt * dt + gtphi * dPhi);
+    o.L = (gtphi * dt + gphiphi * dPhi) / energy;
+    KerrState y{r, theta, sigma * dr / energy, sigma * dTheta / energy};
+    o.K = y.dTheta * y.dTheta + c * c * (o.L * o.L / (s * s) - a2) + (o.L - o.a) * (o.L - o.a);
+
+    Vec3 direction = rayDir;
+    const int maxSteps = std::min(u.maxSteps, MAX_STEPS);
+    for (int i = 0; i < maxSteps; i++) {
+        // Spatial step grows with r and never crosses the horizon in one go;
+        // |dx / dlambda| ~ r^2 + a^2 away from the hole
+        const float ds = std::min(std::max(u.stepSize, 0.1f * y.r), std::max(y.r - horizon, 0.02f * o.m));
+        // Near the axis theta turns and phi sweeps by ~pi within a few
+        // hundredths of a radian; keep both changes a fraction of sin(theta)
+        const float axis = std::max(std::abs(std::sin(y.theta)), 0.02f);
+        const float h = std::min(ds / (y.r * y.r + a2), 0.2f * axis / (std::abs(y.dTheta) + std::abs(o.L) / axis));
+
+        float f1, f2, f3, f4;
+        const KerrState k1 = kerrDerivatives(o, y, f1);
+        const KerrState k2 = kerrDerivatives(o, y + k1 * (0.5f * h), f2);
+        const KerrState k3 = kerrDerivatives(o, y + k2 * (0.5f * h), f3);
+        const KerrState k4 = kerrDerivatives(o, y + k3 * h, f4);
+        const KerrState yNext = kerrConstrain(o, y + (k1 + k2 * 2.0f + k3 * 2.0f + k4) * (h / 6.0f));
+        const float phiNext = phi + h / 6.0f * (f1 + 2.0f * f2 + 2.0f * f3 + f4);
+        const Vec3 xNext = kerrToCartesian(o, yNext.r, yNext.theta, phiNext);
+
+        // Disk crossing and planet hit on the chord, nearest first. The disk
+        // is the equatorial plane, where the Boyer-Lindquist r is sqrt(x^2 + z^2 - a^2)
+        int planet;
+        const float tPlanet = segmentPlanets(u, x, xNext, planet);
+        if (u.enableDisk && x.y * xNext.y < 0.0f) {
+            const float t = x.y / (x.y - xNext.y);
+            const Vec3 hit = mix(x, xNext, t);
+            const float r_hit = std::sqrt(std::max(hit.x * hit.x + hit.z * hit.z - a2, 0.0f));
+            if (t < tPlanet && r_hit > u.diskInnerRadius && r_hit < u.diskOuterRadius) {
+                float diskAlpha;
+                const Vec3 disk = getDiskSample(u, hit, diskAlpha);
+                accColor += disk * transmittance;
+                transmittance *= (1.0f - diskAlpha);
+                if (transmittance < 0.02f) {
+                    return accColor;
+                }
+            }
+        }
+        if (tPlanet <= 1.0f) {
+            accColor += shadePlanet(u, mix(x, xNext, tPlanet), planet) * transmittance;
+            return accColor;
+        }
+
+        direction = xNext - x;
+        x = xNext;
+        y = yNext;
+        phi = phiNext;
+
+        // Event horizon check
+        if (y.r < horizon * 1.01f) {
+            return accColor;
+        }
+        if (y.r > farDist) {
+            break;
+        }
+    }
+
+    if (u.enableStarfield) {
+        accColor += starField(u, direction.normalize(), u.time) * transmittance;
+    }
+    return accColor;
+}
+
+bool useBinet(const FrameUniforms &u) {
+    return u.lensingModel == LensingModel::Binet && u.enableLensing;
+}
+
+namespace {
+
+// (u, du/ds)
+struct BinetState {
+    float u, du;
+
+    BinetState operator+(const BinetState &o) const { return {u + o.u, du + o.du}; }
+    BinetState operator*(const float h) const { return {u * h, du * h}; }
+};
+
+BinetState binetDerivative(const BinetState &y, const float rs) {
+    return {y.du, 1.5f * rs * y.u * y.u - y.u};
+}
+
+} // namespace
+
+Vec3 rayMarchBinet(const FrameUniforms &u, const Vec3 &rayOrigin, const Vec3 &rayDir) {
+    Vec3 accColor;
+    float transmittance = 1.0f;
+    const float farDist = (u.farDist > 0.0f) ? u.farDist : MAX_DIST;
+    const float rs = u.schwarzschildRadius;
+
+    // Orbit plane: position at swept angle s is (cos(s) * e1 + sin(s) * e2) / u(s)
+    const float r0 = rayOrigin.length();
+    const Vec3 e1 = rayOrigin * (1.0f / r0);
+    const float cosPsi = rayDir.dot(e1);
+    const Vec3 tangent = rayDir - e1 * cosPsi;
+    const float sinPsi = tangent.length();
+    const Vec3 e2 = (sinPsi > 1e-6f) ? tangent * (1.0f / sinPsi) : e1.cross(Vec3(0.3f, 1.0f, 0.2f)).normalize();
+    BinetState y{1.0f / r0, -cosPsi / (r0 * std::max(sinPsi, 1e-6f))};
+
+    // Swept angles where the orbit plane meets the disk plane, every PI
+    float nextCrossing = 1e9f;
+    if (u.enableDisk && (std::abs(e1.y) > 1e-6f || std::abs(e2.y) > 1e-6f)) {
+        nextCrossing = std::atan2(-e1.y, e2.y);
+        if (nextCrossing <= 0.0f) nextCrossing += PI;
+    }
+
+    Vec3 a = rayOrigin;
+    float s = 0.0f;
+    const int maxSteps = std::min(u.maxSteps, MAX_STEPS);
+    for (int i = 0; i < maxSteps; i++) {
+        // Chord of about max(stepSize, r / 4), at most 2 * stepSize radians
+        const float r = 1.0f / y.u;
+        const float h =
+            std::min(2.0f * u.stepSize, std::max(u.stepSize, 0.25f * r) * y.u * y.u / std::sqrt(y.u * y.u + y.du * y.du));
+        const BinetState k1 = binetDerivative(y, rs);
+        const BinetState k2 = binetDerivative(y + k1 * (0.5f * h), rs);
+        const BinetState k3 = binetDerivative(y + k2 * (0.5f * h), rs);
+        const BinetState k4 = binetDerivative(y + k3 * h, rs);
+        const BinetState yNext = y + (k1 + k2 * 2.0f + k3 * 2.0f + k4) * (h / 6.0f);
+        const float sNext = s + h;
+        const Vec3 b = (e1 * std::cos(sNext) + e2 * std::sin(sNext)) * (1.0f / std::max(yNext.u, 1.0f / farDist));
+
+        // Planet hit on this chord
+        int planet;
+        const float tPlanet = segmentPlanets(u, a, b, planet);
+        const float sEnd = (tPlanet <= 1.0f) ? mix(s, sNext, tPlanet) : sNext;
+
+        // Disk crossing before the planet; u there from the cubic Hermite
+        // through both ends of the step
+        if (nextCrossing < sEnd) {
+            const float t = (nextCrossing - s) / h;
+            const float t2 = t * t;
+            const float t3 = t2 * t;
+            const float uHit = (2.0f * t3 - 3.0f * t2 + 1.0f) * y.u + (t3 - 2.0f * t2 + t) * h * y.du +
+                               (3.0f * t2 - 2.0f * t3) * yNext.u + (t3 - t2) * h * yNext.du;
+            const float r_hit = 1.0f / std::max(uHit, 1e-6f);
+            if (r_hit > u.diskInnerRadius && r_hit < u.diskOuterRadius) {
+                const Vec3 hit = (e1 * std::cos(nextCrossing) + e2 * std::sin(nextCrossing)) * r_hit;
+                float diskAlpha;
+                const Vec3 disk = getDiskSample(u, hit, diskAlpha);
+                accColor += disk * transmittance;
+                transmittance *= (1.0f - diskAlpha);
+                if (transmittance < 0.02f) {
+                    return accColor;
+                }
+            }
+            nextCrossing += PI;
+        }
+
+        if (tPlanet <= 1.0f) {
+            accColor += shadePlanet(u, mix(a, b, tPlanet), planet) * transmittance;
+            return accColor;
+        }
+
+        a = b;
+        s = sNext;
+        y = yNext;
+
+        // Event horizon check
+        if (y.u * (rs + EPSILON) > 1.0f) {
+            return accColor;
+        }
+        if (y.u * farDist < 1.0f) {
+            break;
+        }
+    }
+
+    if (u.enableStarfield) {
+        // Direction of travel, d/ds of the position
+        const Vec3 radial = e1 * std::cos(s) + e2 * std::sin(s);
+        const Vec3 along = e2 * std::cos(s) - e1 * std::sin(s);
+        accColor += starField(u, (along * y.u - radial * y.du).normalize(), u.time) * transmittance;
+    }
+    return accColor;
+}
+
+Vec3 traceRay(const FrameUniforms &u, const Vec3 &rayOrigin, const Vec3 &rayDir) {
+    if (useBinet(u)) {
+        return rayMarchBinet(u, rayOrigin, rayDir);
+    }
+    if (useKerr(u)) {
+        return rayMarchKerr(u, rayOrigin, rayDir);
+    }
+    if (useGeodesic(u)) {
+        return rayMarchGeodesic(u, rayOrigin, rayDir);
+    }
+    if (useDeflectionLut(u)) {
+        return rayMarchLut(u, rayOrigin, rayDir);
+    }
+    return rayMarch(u, rayOrigin, rayDir);
+}
+
+static Vec3 gammaCorrect(const Vec3 &c) {
+    return {std::pow(c.x, 0.4545f), std::pow(c.y, 0.4545f), std::pow(c.z, 0.4545f)};
+}
+
+Vec3 primaryRayDir(const FrameUniforms &u, const float fragX, const float fragY) {
+    const Vec2 uv((fragX - 0.5f * u.resolution[0]) / u.resolution[1],
+                  (fragY - 0.5f * u.resolution[1]) / u.resolution[1]);
+    const Vec3 rayDir = Vec3(uv.x, uv.y, -1.0f).normalize();
+    return u.invViewMatrix.transformDirection(rayDir);
+}
+
+bool needsMarching(const FrameUniforms &u) {
+    return u.enablePlanets || u.enableDisk || u.enableLensing;
+}
+
+Vec3 finishColor(Vec3 color) {
+    const float l = color.dot(Vec3(0.21f, 0.72f, 0.07f));
+    color += color * (l * 0.3f);
+    return gammaCorrect(color);
+}
+
+Vec3 shadePixel(const FrameUniforms &u, const float fragX, const float fragY) {
+    const Vec3 rayDir = primaryRayDir(u, fragX, fragY);
+
+    if (!needsMarching(u)) {
+        // Early-out: starfield only, no marching needed
+        if (u.enableStarfield) {
+            return gammaCorrect(starField(u, rayDir, u.time));
+        }
+        // If literally everything is off, return black
+        return {};
+    }
+
+    return finishColor(traceRay(u, u.cameraPosition, rayDir));
+}
+
+} // namespace cpu
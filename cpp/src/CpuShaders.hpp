@@ -0,0 +1,91 @@
+#pragma once
+
+#include "GlslMath.hpp"
+#include "Simulation.hpp"
+
+// C++ port of BLACKHOLE_FRAG_SRC. Each function mirrors the GLSL function of
+// the same name and reads the uniforms from a FrameUniforms instead; keep the
+// two in sync when either changes.
+namespace cpu {
+
+// Constants
+constexpr int MAX_STEPS = 300;
+constexpr float MAX_DIST = 100.0f;
+constexpr float EPSILON = 0.001f;
+constexpr int LUT_SEGMENTS = 24;
+constexpr float GEODESIC_TOLERANCE = 1e-5f;
+
+float random(const Vec2 &st);
+float noise(const Vec2 &st);
+float fbm(Vec2 p);
+
+Vec2 skyCoord(const Vec3 &rd);
+float starTwinkle(float seed, float t);
+// Stars without their twinkle (linear); the twinkle seed of the star
+// contributing most is written to 'seed'
+Vec3 starLayer(const Vec3 &rd, float &seed);
+// Milky Way band nebula (linear)
+Vec3 nebulaLayer(const Vec3 &rd);
+// Background sky from the baked SkyCubemap, the same lookup as the GPU
+Vec3 starField(const FrameUniforms &u, const Vec3 &rd, float t);
+// Lit color of a point on u.planets[planet], or on small body
+// planet - MAX_PLANETS of u.bodies
+Vec3 shadePlanet(const FrameUniforms &u, const Vec3 &p, int planet);
+// Returns the emitted color, alpha is written to 'alpha'
+Vec3 getDiskSample(const FrameUniforms &u, const Vec3 &p, float &alpha);
+
+// Radius of the sphere around the hole outside which rayMarch rays stay straight
+// and meet nothing
+float sceneRadius(const FrameUniforms &u);
+// rayMarch with lensing off, planets and disk intersected in closed form
+Vec3 traceStraight(const FrameUniforms &u, const Vec3 &rayOrigin, const Vec3 &rayDir, float farDist);
+Vec3 rayMarch(const FrameUniforms &u, const Vec3 &rayOrigin, Vec3 rayDir);
+
+// Deflection table mode: rayMarch replaced by lookups into DeflectionTable
+bool useDeflectionLut(const FrameUniforms &u);
+Vec3 rayMarchLut(const FrameUniforms &u, const Vec3 &rayOrigin, const Vec3 &rayDir);
+// Entry parameter in [0, 1] of segment a->b into a sphere, 2 if it misses
+float segmentSphere(const Vec3 &a, const Vec3 &b, const Vec3 &center, float radius);
+// First planet or small body hit on segment a->b: entry parameter (2 on a
+// miss), index to 'planet' (small bodies from MAX_PLANETS on)
+float segmentPlanets(const FrameUniforms &u, const Vec3 &a, const Vec3 &b, int &planet);
+
+// Geodesic mode: the exact Schwarzschild photon path x'' = -3/2 rs h^2 x / r^5
+// (h = |x cross x'|) integrated with adaptive Dormand-Prince RK45 steps
+bool useGeodesic(const FrameUniforms &u);
+// One step of size h from (x, v) with a = acceleration at x. Writes the
+// 5th-order result and its acceleration (the next step's first stage) and
+// returns the error estimate relative to GEODESIC_TOLERANCE; accept when <= 1.
+float dormandPrinceStep(const Vec3 &x, const Vec3 &v, const Vec3 &a, float h, float k, Vec3 &xNext, Vec3 &vNext,
+                        Vec3 &aNext);
+Vec3 rayMarchGeodesic(const FrameUniforms &u, const Vec3 &rayOrigin, const Vec3 &rayDir);
+
+// Kerr mode: photon orbits around a hole of mass M = rs / 2 and spin
+// a = spin M about +y. E, L and K = Q + (L - a)^2 are conserved, so RK4 only
+// integrates r'' = R'(r) / 2, theta'' = Theta'(theta) / 2 and phi' in Mino time.
+struct KerrOrbit {
+    float m, a, L, K;
+};
+bool useKerr(const FrameUniforms &u);
+Vec3 rayMarchKerr(const FrameUniforms &u, const Vec3 &rayOrigin, const Vec3 &rayDir);
+
+// Binet mode: the Schwarzschild ray reduced to its orbit plane, u = 1 / r
+// over the swept angle with u'' + u = 3/2 rs u^2, integrated with RK4
+bool useBinet(const FrameUniforms &u);
+Vec3 rayMarchBinet(const FrameUniforms &u, const Vec3 &rayOrigin, const Vec3 &rayDir);
+
+// rayMarch, rayMarchLut, rayMarchGeodesic, rayMarchKerr or rayMarchBinet, as
+// picked by the lensing model
+Vec3 traceRay(const FrameUniforms &u, const Vec3 &rayOrigin, const Vec3 &rayDir);
+
+// Pieces of main(), shared with the packet marcher
+Vec3 primaryRayDir(const FrameUniforms &u, float fragX, float fragY);
+// False when main() takes one of its early-outs instead of calling rayMarch
+bool needsMarching(const FrameUniforms &u);
+// Highlight boost and gamma applied to the rayMarch result
+Vec3 finishColor(Vec3 color);
+
+// Port of main(): final gamma-corrected color for the pixel at gl_FragCoord
+Vec3 shadePixel(const FrameUniforms &u, float fragX, float fragY);
+
+} // namespace cpu
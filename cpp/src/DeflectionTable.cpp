@@ -0,0 +1,144 @@
+#include "DeflectionTable.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Impact parameters of the first captured / scattered row sit just off b_c,
+// where the orbit would circle the photon sphere forever
+static constexpr double CAPTURED_LIMIT = DeflectionTable::CRITICAL_IMPACT * (1.0 - 1e-4);
+static constexpr double SCATTERED_LIMIT = DeflectionTable::CRITICAL_IMPACT * (1.0 + 1e-4);
+
+static double rowImpact(const int row) {
+    constexpr int last = DeflectionTable::ROWS_PER_BRANCH - 1;
+    if (row < DeflectionTable::ROWS_PER_BRANCH) {
+        const double s = 1.0 - static_cast<double>(row) / last;
+        return CAPTURED_LIMIT * (1.0 - s * s);
+    }
+    const double s = static_cast<double>(row - DeflectionTable::ROWS_PER_BRANCH) / last;
+    return SCATTERED_LIMIT + (DeflectionTable::MAX_IMPACT - SCATTERED_LIMIT) * s * s * s * s;
+}
+
+const DeflectionTable &DeflectionTable::get() {
+    static const DeflectionTable table;
+    return table;
+}
+
+DeflectionTable::DeflectionTable() : texels(static_cast<std::size_t>(COLUMNS) * ROWS * 4) {
+    for (int row = 0; row < ROWS; row++) {
+        buildRow(row);
+    }
+}
+
+float DeflectionTable::rowCoord(const float impact) {
+    constexpr float last = ROWS_PER_BRANCH - 1;
+    float row;
+    if (impact < CRITICAL_IMPACT) {
+        const float s = 1.0f - std::sqrt(std::max(0.0f, 1.0f - impact / static_cast<float>(CAPTURED_LIMIT)));
+        row = std::min(s, 1.0f) * last;
+    } else {
+        const float s = std::pow(std::max(0.0f, impact - static_cast<float>(SCATTERED_LIMIT)) /
+                                 (MAX_IMPACT - static_cast<float>(SCATTERED_LIMIT)), 0.25f);
+        row = ROWS_PER_BRANCH + std::min(s, 1.0f) * last;
+    }
+    return (row + 0.5f) / ROWS;
+}
+
+float DeflectionTable::phiColumn(const float x) {
+    const float c = 1.0f - std::sqrt(std::max(0.0f, 1.0f - x));
+    return (std::min(c, 1.0f) * (COLUMNS - 1) + 0.5f) / COLUMNS;
+}
+
+float DeflectionTable::uColumn(const float t) {
+    return (std::clamp(t, 0.0f, 1.0f) * (COLUMNS - 1) + 0.5f) / COLUMNS;
+}
+
+DeflectionTable::Sample DeflectionTable::sample(const float s, const float t) const {
+    const float fx = std::clamp(s * COLUMNS - 0.5f, 0.0f, static_cast<float>(COLUMNS - 1));
+    const float fy = std::clamp(t * ROWS - 0.5f, 0.0f, static_cast<float>(ROWS - 1));
+    const int x0 = static_cast<int>(fx);
+    const int y0 = static_cast<int>(fy);
+    const int x1 = std::min(x0 + 1, COLUMNS - 1);
+    const int y1 = std::min(y0 + 1, ROWS - 1);
+    const float ax = fx - static_cast<float>(x0);
+    const float ay = fy - static_cast<float>(y0);
+
+    float out[4];
+    for (int c = 0; c < 4; c++) {
+        const auto texel = [&](const int x, const int y) {
+            return texels[(static_cast<std::size_t>(y) * COLUMNS + x) * 4 + c];
+        };
+        const float top = texel(x0, y0) * (1.0f - ax) + texel(x1, y0) * ax;
+        const float bottom = texel(x0, y1) * (1.0f - ax) + texel(x1, y1) * ax;
+        out[c] = top * (1.0f - ay) + bottom * ay;
+    }
+    return {out[0], out[1], out[2], out[3]};
+}
+
+// Integrates the Binet equation u'' = -u + 3/2 u^2 (rs = 1) in the swept angle
+// from infinity (u = 0, u' = 1/b) with RK4 until periapsis or the horizon,
+// then resamples the monotonic u(phi) onto the two column grids.
+void DeflectionTable::buildRow(const int row) {
+    // b = 0 is a radial plunge; a tiny impact parameter gives the same orbit
+    const double impact = std::max(rowImpact(row), 1e-3);
+    const bool captured = row < ROWS_PER_BRANCH;
+    constexpr double h = 0.002;
+    constexpr double maxPhi = 40.0;
+
+    std::vector<double> phis = {0.0};
+    std::vector<double> us = {0.0};
+    double phi = 0.0, u = 0.0, w = 1.0 / impact;
+
+    const auto accel = [](const double uu) { return -uu + 1.5 * uu * uu; };
+    while (phi < maxPhi) {
+        const double k1u = w, k1w = accel(u);
+        const double k2u = w + 0.5 * h * k1w, k2w = accel(u + 0.5 * h * k1u);
+        const double k3u = w + 0.5 * h * k2w, k3w = accel(u + 0.5 * h * k2u);
+        const double k4u = w + h * k3w, k4w = accel(u + h * k3u);
+        const double uNext = u + h / 6.0 * (k1u + 2.0 * k2u + 2.0 * k3u + k4u);
+        const double wNext = w + h / 6.0 * (k1w + 2.0 * k2w + 2.0 * k3w + k4w);
+
+        if (captured && uNext >= 1.0) {
+            // Crossed the horizon during this step
+            const double f = (1.0 - u) / (uNext - u);
+            phis.push_back(phi + f * h);
+            us.push_back(1.0);
+            break;
+        }
+        if (!captured && wNext <= 0.0) {
+            // Periapsis: u' changes sign during this step
+            const double f = w / (w - wNext);
+            phis.push_back(phi + f * h);
+            us.push_back(u + 0.5 * w * f * h);
+            break;
+        }
+
+        phi += h;
+        u = uNext;
+        w = wNext;
+        phis.push_back(phi);
+        us.push_back(u);
+    }
+
+    const double phiMax = phis.back();
+    const double uMax = us.back();
+
+    // Linear interpolation of y(x) over the monotonic samples xs
+    const auto interpolate = [](const std::vector<double> &xs, const std::vector<double> &ys, const double x) {
+        const auto it = std::lower_bound(xs.begin(), xs.end(), x);
+        if (it == xs.begin()) return ys.front();
+        if (it == xs.end()) return ys.back();
+        const std::size_t i = it - xs.begin();
+        const double f = (x - xs[i - 1]) / std::max(xs[i] - xs[i - 1], 1e-300);
+        return ys[i - 1] + (ys[i] - ys[i - 1]) * f;
+    };
+
+    float *dst = texels.data() + static_cast<std::size_t>(row) * COLUMNS * 4;
+    for (int col = 0; col < COLUMNS; col++) {
+        const double c = static_cast<double>(col) / (COLUMNS - 1);
+        const double x = 1.0 - (1.0 - c) * (1.0 - c);
+        dst[col * 4 + 0] = static_cast<float>(interpolate(us, phis, x * uMax));
+        dst[col * 4 + 1] = static_cast<float>(interpolate(phis, us, c * phiMax) / uMax);
+        dst[col * 4 + 2] = static_cast<float>(phiMax);
+        dst[col * 4 + 3] = static_cast<float>(uMax);
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+
+// Precomputed Schwarzschild photon orbits. Every ray around a non-rotating
+// mass stays in one plane and is fully described by its impact parameter b;
+// in units of the Schwarzschild radius the orbit equation has no free
+// parameters (u'' + u = 3/2 u^2 with u = rs / r), so one table serves every
+// mass and camera position.
+//
+// Rows are orbits: ROWS_PER_BRANCH captured ones (b < b_c, falling from
+// infinity into the horizon) followed by ROWS_PER_BRANCH scattered ones
+// (b > b_c, turning at periapsis). Each texel holds
+//   r: Phi, the angle swept from infinity until u = x * uMax, x on a grid
+//      dense near 1 (see phiColumn)
+//   g: x = u / uMax reached after sweeping t * phiMax, t on a uniform grid
+//   b: phiMax, angle swept from infinity to periapsis / horizon
+//   a: uMax, u at periapsis (scattered) or at the horizon (captured, 1.0)
+// BLACKHOLE_FRAG_SRC mirrors the layout constants below.
+class DeflectionTable {
+public:
+    static constexpr int COLUMNS = 256;
+    static constexpr int ROWS_PER_BRANCH = 256;
+    static constexpr int ROWS = 2 * ROWS_PER_BRANCH;
+    // Critical impact parameter 3*sqrt(3)/2 rs; orbits closer are captured
+    static constexpr float CRITICAL_IMPACT = 2.5980762f;
+    // Largest tabulated impact parameter, in units of rs
+    static constexpr float MAX_IMPACT = 1000.0f;
+
+    struct Sample {
+        float phi;
+        float x;
+        float phiMax;
+        float uMax;
+    };
+
+    // The shared table, built on first use (a few ms)
+    static const DeflectionTable &get();
+
+    // RGBA32F texels, COLUMNS x ROWS, row 0 first (glTexImage2D order)
+    [[nodiscard]] const float *data() const { return texels.data(); }
+
+    // Texture coordinates of an impact parameter (in rs) and of the two grids
+    static float rowCoord(float impact);
+    static float phiColumn(float x);
+    static float uColumn(float t);
+
+    // Bilinear lookup with clamp-to-edge, like texture() on the GPU copy
+    [[nodiscard]] Sample sample(float s, float t) const;
+
+private:
+    DeflectionTable();
+    void buildRow(int row);
+
+    std::vector<float> texels;
+};
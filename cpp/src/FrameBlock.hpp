@@ -0,0 +1,109 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include "BodyGrid.hpp"
+#include "Simulation.hpp"
+
+// std140 image of the FrameBlock uniform block in BLACKHOLE_FRAG_SRC. Member
+// order follows the GLSL declaration; the asserts pin the std140 offsets.
+struct FrameBlock {
+    float invViewMatrix[16];
+    float cameraPosition[3];
+    float time;
+    float resolution[2];
+    float mass;
+    float schwarzschildRadius;
+    float diskInnerRadius;
+    float diskOuterRadius;
+    float stepSize;
+    float farDist;
+    float lensMaxRadius;
+    std::int32_t maxSteps;
+    std::int32_t enableStarfield;
+    std::int32_t enablePlanets;
+    std::int32_t enableDisk;
+    std::int32_t enableLensing;
+    std::int32_t lensingModel;
+    float spin;
+};
+static_assert(offsetof(FrameBlock, cameraPosition) == 64);
+static_assert(offsetof(FrameBlock, resolution) == 80);
+static_assert(offsetof(FrameBlock, maxSteps) == 116);
+static_assert(sizeof(FrameBlock) == 144, "std140 rounds the block up to 16 bytes");
+
+// std140 image of the PlanetBlock uniform block: vec4 arrays, the count and
+// extents, then the small body grid
+struct PlanetBlock {
+    float spheres[MAX_PLANETS][4];
+    float colors[MAX_PLANETS][4];
+    std::int32_t count;
+    float reach;
+    float maxRadius;
+    float bodySlab;
+    float bodyGrid[4];
+    float bodyInnerRadius;
+    float padding[3];
+};
+static_assert(offsetof(PlanetBlock, count) == 32 * MAX_PLANETS);
+static_assert(offsetof(PlanetBlock, bodyGrid) == 32 * MAX_PLANETS + 16);
+static_assert(sizeof(PlanetBlock) == 32 * MAX_PLANETS + 48, "std140 rounds the block up to 16 bytes");
+
+// Binding points of FrameBlock and PlanetBlock in every program that declares them
+constexpr unsigned int FRAME_BLOCK_BINDING = 0;
+constexpr unsigned int PLANET_BLOCK_BINDING = 1;
+
+inline FrameBlock makeFrameBlock(const FrameUniforms &u) {
+    FrameBlock block{};
+    std::copy(std::begin(u.invViewMatrix.m), std::end(u.invViewMatrix.m), block.invViewMatrix);
+    block.cameraPosition[0] = u.cameraPosition.x;
+    block.cameraPosition[1] = u.cameraPosition.y;
+    block.cameraPosition[2] = u.cameraPosition.z;
+    block.time = u.time;
+    block.resolution[0] = u.resolution[0];
+    block.resolution[1] = u.resolution[1];
+    block.mass = u.mass;
+    block.schwarzschildRadius = u.schwarzschildRadius;
+    block.diskInnerRadius = u.diskInnerRadius;
+    block.diskOuterRadius = u.diskOuterRadius;
+    block.stepSize = u.stepSize;
+    block.farDist = u.farDist;
+    block.lensMaxRadius = u.lensMaxRadius;
+    block.maxSteps = u.maxSteps;
+    block.enableStarfield = u.enableStarfield ? 1 : 0;
+    block.enablePlanets = u.enablePlanets ? 1 : 0;
+    block.enableDisk = u.enableDisk ? 1 : 0;
+    block.enableLensing = u.enableLensing ? 1 : 0;
+    block.lensingModel = static_cast<std::int32_t>(u.lensingModel);
+    block.spin = u.spin;
+    return block;
+}
+
+inline PlanetBlock makePlanetBlock(const FrameUniforms &u) {
+    PlanetBlock block{};
+    for (int i = 0; i < u.planetCount; i++) {
+        const PlanetInstance &planet = u.planets[i];
+        block.spheres[i][0] = planet.position.x;
+        block.spheres[i][1] = planet.position.y;
+        block.spheres[i][2] = planet.position.z;
+        block.spheres[i][3] = planet.radius;
+        block.colors[i][0] = planet.color.x;
+        block.colors[i][1] = planet.color.y;
+        block.colors[i][2] = planet.color.z;
+        block.colors[i][3] = planet.bands;
+    }
+    block.count = u.planetCount;
+    block.reach = u.planetReach;
+    block.maxRadius = u.planetMaxRadius;
+    if (u.bodies) {
+        block.bodySlab = u.bodies->slab();
+        block.bodyGrid[0] = u.bodies->originX();
+        block.bodyGrid[1] = u.bodies->originZ();
+        block.bodyGrid[2] = u.bodies->cellSize();
+        block.bodyGrid[3] = static_cast<float>(u.bodies->resolution());
+        block.bodyInnerRadius = u.bodies->innerRadius();
+    }
+    return block;
+}
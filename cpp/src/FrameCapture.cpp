@@ -0,0 +1,142 @@
+#include <GLFW/glfw3.h>
+#include "FrameCapture.hpp"
+#include "Shader.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+FrameCapture::FrameCapture(std::string directory, const Format format)
+    : directory(std::move(directory)), format(format) {
+    std::error_code error;
+    std::filesystem::create_directories(this->directory, error);
+
+    for (Slot& slot : slots) {
+        glGenBuffers(1, &slot.buffer);
+    }
+    writer = std::thread(&FrameCapture::writerLoop, this);
+}
+
+FrameCapture::~FrameCapture() {
+    finish();
+    for (Slot& slot : slots) {
+        glDeleteBuffers(1, &slot.buffer);
+    }
+}
+
+void FrameCapture::capture(const int width, const int height) {
+    Slot& slot = slots[nextSlot];
+    nextSlot = (nextSlot + 1) % RING_SIZE;
+
+    // The readback queued RING_SIZE frames ago; normally finished by now
+    if (slot.frame >= 0) {
+        collect(slot);
+    }
+
+    const std::size_t size = static_cast<std::size_t>(width) * height * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    if (size > slot.capacity) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(size), nullptr, GL_STREAM_READ);
+        slot.capacity = size;
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    // With a pack buffer bound the pointer is an offset and the call returns immediately
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.width = width;
+    slot.height = height;
+    slot.frame = nextFrame++;
+}
+
+void FrameCapture::flush() {
+    // Oldest first, so frames reach the writer in order
+    for (int i = 0; i < RING_SIZE; i++) {
+        Slot& slot = slots[(nextSlot + i) % RING_SIZE];
+        if (slot.frame >= 0) {
+            collect(slot);
+        }
+    }
+}
+
+int FrameCapture::finish() {
+    if (writer.joinable()) {
+        flush();
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        jobQueued.notify_one();
+        writer.join();
+    }
+    return errors;
+}
+
+void FrameCapture::collect(Slot& slot) {
+    Job job{slot.frame, Image()};
+    job.image.resize(slot.width, slot.height);
+    slot.frame = -1;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    if (const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                                              static_cast<GLsizeiptr>(job.image.rgba.size()), GL_MAP_READ_BIT)) {
+        std::memcpy(job.image.rgba.data(), pixels, job.image.rgba.size());
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    std::unique_lock lock(mutex);
+    jobTaken.wait(lock, [this] { return jobs.size() < MAX_QUEUED; });
+    jobs.push_back(std::move(job));
+    lock.unlock();
+    jobQueued.notify_one();
+}
+
+void FrameCapture::writerLoop() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock lock(mutex);
+            jobQueued.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        jobTaken.notify_one();
+
+        char name[32];
+        std::snprintf(name, sizeof(name), "frame_%06d.%s", job.frame, extension(format));
+        const std::string path = (std::filesystem::path(directory) / name).string();
+
+        bool written = false;
+        switch (format) {
+            case Format::Ppm: written = writePPM(path, job.image); break;
+            case Format::Png: written = writePNG(path, job.image); break;
+            case Format::Raw: written = writeRaw(path, job.image); break;
+        }
+        if (!written) {
+            std::lock_guard lock(mutex);
+            if (errors++ == 0) {
+                std::cerr << "Failed to write " << path << std::endl;
+            }
+        }
+    }
+}
+
+bool FrameCapture::parseFormat(const std::string& name, Format& format) {
+    if (name == "png") format = Format::Png;
+    else if (name == "ppm") format = Format::Ppm;
+    else if (name == "raw") format = Format::Raw;
+    else return false;
+    return true;
+}
+
+const char* FrameCapture::extension(const Format format) {
+    switch (format) {
+        case Format::Ppm: return "ppm";
+        case Format::Png: return "png";
+        case Format::Raw: return "rgba";
+    }
+    return "";
+}
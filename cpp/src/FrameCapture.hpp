@@ -0,0 +1,74 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "Image.hpp"
+
+// Image sequence export that stays off the render thread's critical path.
+// capture() only queues an asynchronous glReadPixels into one of RING_SIZE
+// pixel pack buffers; the buffer is mapped RING_SIZE frames later, when the GPU
+// is long done with it, and the copy goes to a writer thread that encodes
+// <directory>/frame_NNNNNN.<ext>. If the writer falls MAX_QUEUED frames behind,
+// capture() waits for it rather than dropping frames.
+class FrameCapture {
+public:
+    enum class Format { Ppm, Png, Raw };
+
+    static constexpr int RING_SIZE = 3;
+    static constexpr std::size_t MAX_QUEUED = 16;
+
+    FrameCapture(std::string directory, Format format);
+    ~FrameCapture();
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+
+    // Queues a readback of the bound read framebuffer, width x height from the origin
+    void capture(int width, int height);
+    // Hands every in-flight readback to the writer (blocks on the GPU)
+    void flush();
+    // Flushes and waits until every frame is on disk; returns the number of
+    // files that failed to write. The destructor does the same.
+    int finish();
+
+    [[nodiscard]] int framesCaptured() const { return nextFrame; }
+
+    // "png" / "ppm" / "raw"; false for anything else
+    static bool parseFormat(const std::string& name, Format& format);
+    static const char* extension(Format format);
+
+private:
+    struct Slot {
+        unsigned int buffer = 0;
+        std::size_t capacity = 0;
+        int width = 0;
+        int height = 0;
+        int frame = -1; // -1: nothing in flight
+    };
+
+    struct Job {
+        int frame = 0;
+        Image image;
+    };
+
+    std::string directory;
+    Format format;
+    Slot slots[RING_SIZE];
+    int nextSlot = 0;
+    int nextFrame = 0;
+
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable jobQueued;
+    std::condition_variable jobTaken;
+    std::deque<Job> jobs;
+    bool stopping = false;
+    int errors = 0;
+
+    void collect(Slot& slot);
+    void writerLoop();
+};
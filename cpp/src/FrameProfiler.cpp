@@ -0,0 +1,188 @@
+#include "FrameProfiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include "Shader.hpp"
+
+// Histogram bucket upper bounds in ms; the last bucket is open-ended
+static constexpr double BUCKET_LIMITS[] = {1.0, 2.0, 4.0, 8.0, 16.7, 33.3, 66.7, 133.3};
+static constexpr int BUCKET_COUNT = std::size(BUCKET_LIMITS) + 1;
+
+static void histogram(const std::vector<float>& values, int (&counts)[BUCKET_COUNT]) {
+    std::fill(std::begin(counts), std::end(counts), 0);
+    for (const float v : values) {
+        const auto it = std::upper_bound(std::begin(BUCKET_LIMITS), std::end(BUCKET_LIMITS), static_cast<double>(v));
+        counts[it - std::begin(BUCKET_LIMITS)]++;
+    }
+}
+
+void FrameProfiler::Samples::push(const float value) {
+    if (values.size() < MAX_SAMPLES) {
+        values.push_back(value);
+    } else {
+        values[next] = value;
+    }
+    next = (next + 1) % MAX_SAMPLES;
+    total++;
+}
+
+std::vector<float> FrameProfiler::Samples::newest(std::size_t count) const {
+    count = std::min(count, values.size());
+    std::vector<float> out;
+    out.reserve(count);
+    // Oldest first: the ring starts at 'next' once full
+    const std::size_t size = values.size();
+    const std::size_t start = (size < MAX_SAMPLES ? size : next + size) - count;
+    for (std::size_t i = 0; i < count; i++) {
+        out.push_back(values[(start + i) % size]);
+    }
+    return out;
+}
+
+FrameProfiler::FrameProfiler() {
+    glGenQueries(QUERY_LATENCY, queries);
+}
+
+FrameProfiler::~FrameProfiler() {
+    glDeleteQueries(QUERY_LATENCY, queries);
+}
+
+void FrameProfiler::collectQueries() {
+    // Oldest first, so the GPU series stays in submission order
+    for (int i = 1; i <= QUERY_LATENCY; i++) {
+        const int slot = (currentQuery + i) % QUERY_LATENCY;
+        if (!pending[slot]) continue;
+
+        int available = 0;
+        glGetQueryObjectiv(queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) break;
+
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &elapsed);
+        samples[Gpu].push(static_cast<float>(static_cast<double>(elapsed) * 1e-6));
+        pending[slot] = false;
+    }
+}
+
+void FrameProfiler::beginFrame() {
+    const Clock::time_point now = Clock::now();
+    if (hasFrameStart) {
+        samples[Frame].push(std::chrono::duration<float, std::milli>(now - frameStart).count());
+    }
+    frameStart = now;
+    hasFrameStart = true;
+    collectQueries();
+}
+
+void FrameProfiler::beginGpu() {
+    currentQuery = (currentQuery + 1) % QUERY_LATENCY;
+    queryActive = !pending[currentQuery];
+    if (queryActive) {
+        glBeginQuery(GL_TIME_ELAPSED, queries[currentQuery]);
+    }
+}
+
+void FrameProfiler::endGpu() {
+    if (queryActive) {
+        glEndQuery(GL_TIME_ELAPSED);
+        pending[currentQuery] = true;
+        queryActive = false;
+    }
+}
+
+void FrameProfiler::endFrame() {
+    samples[Cpu].push(std::chrono::duration<float, std::milli>(Clock::now() - frameStart).count());
+}
+
+FrameProfiler::Stats FrameProfiler::stats(const Series series, const std::size_t lastSamples) const {
+    std::vector<float> values = samples[series].newest(lastSamples);
+    Stats s;
+    s.count = values.size();
+    if (values.empty()) {
+        return s;
+    }
+
+    std::sort(values.begin(), values.end());
+    double sum = 0.0;
+    for (const float v : values) sum += v;
+    // Nearest-rank percentiles
+    const auto percentile = [&](const double p) {
+        const std::size_t rank = static_cast<std::size_t>(std::ceil(p * static_cast<double>(values.size())));
+        return static_cast<double>(values[std::clamp<std::size_t>(rank, 1, values.size()) - 1]);
+    };
+    s.min = values.front();
+    s.avg = sum / static_cast<double>(values.size());
+    s.p50 = percentile(0.50);
+    s.p95 = percentile(0.95);
+    s.p99 = percentile(0.99);
+    s.max = values.back();
+    return s;
+}
+
+const char* FrameProfiler::seriesName(const Series series) {
+    switch (series) {
+        case Gpu: return "gpu";
+        case Cpu: return "cpu";
+        case Frame: return "frame";
+        default: return "?";
+    }
+}
+
+void FrameProfiler::printReport(std::ostream& out) const {
+    out << std::fixed << std::setprecision(2);
+    for (int i = 0; i < SERIES_COUNT; i++) {
+        const auto series = static_cast<Series>(i);
+        const Stats s = stats(series);
+        out << std::left << std::setw(6) << seriesName(series) << std::right << std::setw(6) << s.count
+            << " samples  min " << s.min << "  avg " << s.avg << "  p50 " << s.p50 << "  p95 " << s.p95 << "  p99 " << s.p99
+            << "  max " << s.max << " ms" << std::endl;
+
+        int counts[BUCKET_COUNT];
+        histogram(samples[series].values, counts);
+        const int peak = std::max(1, *std::max_element(std::begin(counts), std::end(counts)));
+        for (int b = 0; b < BUCKET_COUNT; b++) {
+            if (counts[b] == 0) continue;
+            out << "    " << (b < BUCKET_COUNT - 1 ? "< " : ">= ") << std::setw(6)
+                << BUCKET_LIMITS[std::min(b, BUCKET_COUNT - 2)] << " ms " << std::setw(6) << counts[b] << " "
+                << std::string(static_cast<std::size_t>(40 * counts[b] / peak), '#') << std::endl;
+        }
+    }
+}
+
+bool FrameProfiler::writeJson(const std::string& path) const {
+    std::ofstream file(path);
+    if (!file) {
+        return false;
+    }
+
+    file << "{\n  \"bucket_limits_ms\": [";
+    for (int b = 0; b < BUCKET_COUNT - 1; b++) {
+        file << (b ? ", " : "") << BUCKET_LIMITS[b];
+    }
+    file << "],\n  \"series\": {";
+
+    for (int i = 0; i < SERIES_COUNT; i++) {
+        const auto series = static_cast<Series>(i);
+        const Stats s = stats(series);
+        const std::vector<float> values = samples[series].newest(MAX_SAMPLES);
+        int counts[BUCKET_COUNT];
+        histogram(values, counts);
+
+        file << (i ? "," : "") << "\n    \"" << seriesName(series) << "\": {\n"
+             << "      \"count\": " << s.count << ", \"min\": " << s.min << ", \"avg\": " << s.avg
+             << ", \"p50\": " << s.p50 << ", \"p95\": " << s.p95 << ", \"p99\": " << s.p99 << ", \"max\": " << s.max << ",\n"
+             << "      \"histogram\": [";
+        for (int b = 0; b < BUCKET_COUNT; b++) {
+            file << (b ? ", " : "") << counts[b];
+        }
+        file << "],\n      \"samples_ms\": [";
+        for (std::size_t k = 0; k < values.size(); k++) {
+            file << (k ? ", " : "") << values[k];
+        }
+        file << "]\n    }";
+    }
+    file << "\n  }\n}\n";
+    return static_cast<bool>(file);
+}
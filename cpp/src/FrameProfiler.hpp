@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Frame timing for the render loop:
+//   gpu   - GPU time of the scene draw, from GL_TIME_ELAPSED queries. Results
+//           are collected QUERY_LATENCY frames later without waiting; a frame
+//           whose query slot is still busy is simply not measured.
+//   cpu   - CPU time from beginFrame() to endFrame() (uniforms + submission)
+//   frame - interval between beginFrame() calls, including vsync waits
+// Each series keeps the last MAX_SAMPLES values in milliseconds.
+class FrameProfiler {
+public:
+    enum Series { Gpu, Cpu, Frame, SERIES_COUNT };
+
+    static constexpr int QUERY_LATENCY = 3;
+    static constexpr std::size_t MAX_SAMPLES = 8192;
+
+    struct Stats {
+        std::size_t count = 0;
+        double min = 0.0;
+        double avg = 0.0;
+        double p50 = 0.0;
+        double p95 = 0.0;
+        double p99 = 0.0;
+        double max = 0.0;
+    };
+
+    FrameProfiler();
+    ~FrameProfiler();
+    FrameProfiler(const FrameProfiler&) = delete;
+    FrameProfiler& operator=(const FrameProfiler&) = delete;
+
+    void beginFrame();
+    void beginGpu();
+    void endGpu();
+    void endFrame();
+
+    // Values ever recorded in a series; tells a caller when a new one arrived
+    [[nodiscard]] std::size_t sampleCount(Series series) const { return samples[series].total; }
+    // Stats over the newest 'lastSamples' values of a series
+    [[nodiscard]] Stats stats(Series series, std::size_t lastSamples = MAX_SAMPLES) const;
+    // Stats and a bucketed histogram of every series
+    void printReport(std::ostream& out) const;
+    // Same as printReport plus the raw samples, as JSON. False if the file can't be written.
+    bool writeJson(const std::string& path) const;
+
+    static const char* seriesName(Series series);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Samples {
+        std::vector<float> values; // ring buffer once full
+        std::size_t next = 0;
+        std::size_t total = 0;
+
+        void push(float value);
+        [[nodiscard]] std::vector<float> newest(std::size_t count) const;
+    };
+
+    unsigned int queries[QUERY_LATENCY] = {};
+    bool pending[QUERY_LATENCY] = {};
+    int currentQuery = 0;
+    bool queryActive = false;
+
+    Clock::time_point frameStart;
+    bool hasFrameStart = false;
+    Samples samples[SERIES_COUNT];
+
+    void collectQueries();
+};
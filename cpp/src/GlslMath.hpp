@@ -0,0 +1,50 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include "Math.hpp"
+
+// Scalar GLSL built-ins used by the CPU port of the shaders. They follow the
+// GLSL spec definitions so the C++ code can be read side by side with
+// ShadersEmbedded.hpp.
+
+struct Vec2 {
+    float x, y;
+
+    Vec2() : x(0), y(0) {
+    }
+
+    Vec2(const float x, const float y) : x(x), y(y) {
+    }
+
+    Vec2 operator+(const Vec2 &other) const { return {x + other.x, y + other.y}; }
+    Vec2 operator-(const Vec2 &other) const { return {x - other.x, y - other.y}; }
+    Vec2 operator*(const Vec2 &other) const { return {x * other.x, y * other.y}; }
+    Vec2 operator*(const float scalar) const { return {x * scalar, y * scalar}; }
+
+    [[nodiscard]] float length() const { return std::sqrt(x * x + y * y); }
+    [[nodiscard]] float dot(const Vec2 &other) const { return x * other.x + y * other.y; }
+};
+
+namespace glsl {
+
+inline float fract(const float x) { return x - std::floor(x); }
+
+inline Vec2 floor(const Vec2 &v) { return {std::floor(v.x), std::floor(v.y)}; }
+inline Vec2 fract(const Vec2 &v) { return {fract(v.x), fract(v.y)}; }
+
+inline float clamp(const float x, const float lo, const float hi) { return std::min(std::max(x, lo), hi); }
+
+inline float mix(const float a, const float b, const float t) { return a * (1.0f - t) + b * t; }
+inline Vec3 mix(const Vec3 &a, const Vec3 &b, const float t) { return a * (1.0f - t) + b * t; }
+
+inline float step(const float edge, const float x) { return x < edge ? 0.0f : 1.0f; }
+
+// Also used with edge0 > edge1 by the shaders, which GLSL implementations
+// evaluate with the same formula.
+inline float smoothstep(const float edge0, const float edge1, const float x) {
+    const float t = clamp((x - edge0) / (edge1 - edge0), 0.0f, 1.0f);
+    return t * t * (3.0f - 2.0f * t);
+}
+
+} // namespace glsl
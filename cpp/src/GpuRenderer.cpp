@@ -0,0 +1,627 @@
+#include <GLFW/glfw3.h>
+#include "GpuRenderer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+#include "BodyGrid.hpp"
+#include "CpuShaders.hpp"
+#include "DeflectionTable.hpp"
+#include "FrameBlock.hpp"
+#include "ShadersEmbedded.hpp"
+#include "SkyCubemap.hpp"
+
+// Texture units: the deflection table stays on 1; the block pass results go on 2 and 3,
+// the temporal history on 4 and 5; the sky cubemaps stay on 6 and 7, the small body
+// grid on 8 and 9
+static constexpr int BLOCK_COLOR_UNIT = 2;
+static constexpr int BLOCK_INFO_UNIT = 3;
+static constexpr int HISTORY_COLOR_UNIT = 4;
+static constexpr int HISTORY_INFO_UNIT = 5;
+static constexpr int SKY_STARS_UNIT = 6;
+static constexpr int SKY_NEBULA_UNIT = 7;
+static constexpr int BODY_CELLS_UNIT = 8;
+static constexpr int BODY_ITEMS_UNIT = 9;
+
+// Texels per row of the small body items (BODY_ITEMS_WIDTH in BLACKHOLE_FRAG_SRC),
+// two per item: center and radius, then color and bands
+static constexpr int BODY_ITEMS_WIDTH = 1024;
+static_assert(sizeof(PlanetInstance) == 8 * sizeof(float), "items are uploaded as they are");
+
+// Stars per upload when splatting a catalog, bounding its GPU memory (2 MB)
+static constexpr std::size_t CATALOG_STREAM_STARS = 1 << 18;
+static constexpr float CATALOG_POINT_SIZE = 3.0f;
+
+// Pixel of each 2x2 block renderTemporal marches, cycled per frame; diagonal
+// neighbours alternate so a static image fills in evenly
+static constexpr int SUBSET_OFFSETS[4][2] = {{0, 0}, {1, 1}, {1, 0}, {0, 1}};
+
+// Compute path work group sizes (local_size in COMPUTE_CLASSIFY and COMPUTE_MARCH)
+static constexpr int CLASSIFY_TILE = 8;
+// RayQueue header: the march dispatch size (x, y, z) and the ray count
+static constexpr unsigned int RAY_QUEUE_RESET[4] = {0, 1, 1, 0};
+// Steps per COMPUTE_MARCH_PASS dispatch, between compactions
+static constexpr int MARCH_PASS_STEPS = 64;
+// MarchState in COMPUTE_MARCH_PASS: position, colors, direction, colors
+static constexpr long long MARCH_STATE_BYTES = 32;
+
+// Grows a shader storage buffer to at least 'size' bytes; the contents are lost
+static void reserveStorage(unsigned int& buffer, long long& capacity, const long long size) {
+    if (size <= capacity) {
+        return;
+    }
+    if (buffer == 0) {
+        glGenBuffers(1, &buffer);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(size), nullptr, GL_DYNAMIC_DRAW);
+    capacity = size;
+}
+
+// Per-frame state goes through two uniform buffers every program shares; the
+// samplers never change
+static void setupProgram(const Shader& shader) {
+    shader.bindUniformBlock("FrameBlock", FRAME_BLOCK_BINDING);
+    shader.bindUniformBlock("PlanetBlock", PLANET_BLOCK_BINDING);
+    shader.use();
+    shader.setInt("u_deflectionLut", 1);
+    shader.setInt("u_blockColor", BLOCK_COLOR_UNIT);
+    shader.setInt("u_blockInfo", BLOCK_INFO_UNIT);
+    shader.setInt("u_historyColor", HISTORY_COLOR_UNIT);
+    shader.setInt("u_historyInfo", HISTORY_INFO_UNIT);
+    shader.setInt("u_skyStars", SKY_STARS_UNIT);
+    shader.setInt("u_skyNebula", SKY_NEBULA_UNIT);
+    shader.setInt("u_bodyCells", BODY_CELLS_UNIT);
+    shader.setInt("u_bodyItems", BODY_ITEMS_UNIT);
+}
+
+static void bindTextures(const int unit, const RenderTarget& target) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, target.texture);
+    glActiveTexture(GL_TEXTURE0 + unit + 1);
+    glBindTexture(GL_TEXTURE_2D, target.auxTexture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+// One program per combination of the 1-4 toggles
+GpuRenderer::GpuRenderer()
+    : frameBuffer(sizeof(FrameBlock), FRAME_BLOCK_BINDING),
+      planetBuffer(sizeof(PlanetBlock), PLANET_BLOCK_BINDING),
+      shaders(BLACKHOLE_VERT_SRC, BLACKHOLE_FRAG_SRC, FEATURE_PERMUTATIONS, setupProgram) {
+    // Fullscreen quad
+    constexpr float vertices[] = {
+        -1.0f,  1.0f,
+         1.0f,  1.0f,
+        -1.0f, -1.0f,
+         1.0f, -1.0f
+    };
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), static_cast<void *>(nullptr));
+    glEnableVertexAttribArray(0);
+
+    // Deflection table for the table lensing model, bound to unit 1 for good
+    const DeflectionTable& deflectionTable = DeflectionTable::get();
+    glGenTextures(1, &deflectionLut);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, deflectionLut);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, DeflectionTable::COLUMNS, DeflectionTable::ROWS, 0, GL_RGBA,
+                 GL_FLOAT, deflectionTable.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glActiveTexture(GL_TEXTURE0);
+
+    bakeSky();
+
+    // Compute shaders need GL 4.3; the context only promises 3.3
+    int major = 0;
+    int minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    compute = (major > 4 || (major == 4 && minor >= 3)) && glDispatchCompute && glDispatchComputeIndirect &&
+              glBindImageTexture && glMemoryBarrier && glGetIntegeri_v;
+    if (compute) {
+        glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 0, &maxGroupsX);
+    }
+}
+
+GpuRenderer::~GpuRenderer() {
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteTextures(1, &deflectionLut);
+    glDeleteTextures(1, &skyStars);
+    glDeleteTextures(1, &skyNebula);
+    glDeleteTextures(1, &bodyCells);
+    glDeleteTextures(1, &bodyItems);
+    glDeleteBuffers(2, rayQueues);
+    glDeleteBuffers(1, &marchStates);
+}
+
+// Renders the static sky layers into two HDR cubemaps, one face per draw,
+// and binds them to their units for good
+void GpuRenderer::bakeSky() {
+    Shader bake(BLACKHOLE_VERT_SRC, BLACKHOLE_FRAG_SRC, "#define BAKE_SKY\n");
+    int previous = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+    unsigned int framebuffer = 0;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+    const auto bakeLayer = [&](unsigned int& texture, const int unit, const int layer, const int size) {
+        const bool mipmapped = layer == 0;
+        glGenTextures(1, &texture);
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+        for (int face = 0; face < 6; face++) {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGBA16F, size, size, 0, GL_RGBA, GL_FLOAT,
+                         nullptr);
+        }
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, mipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, mipmapped ? 1000 : 0);
+
+        bake.use();
+        bake.setInt("u_bakeLayer", layer);
+        bake.setFloat("u_bakeSize", static_cast<float>(size));
+        for (int face = 0; face < 6; face++) {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face,
+                                   texture, 0);
+            bake.setInt("u_bakeFace", face);
+            drawQuad(bake, size, size);
+        }
+        if (mipmapped) {
+            glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+        }
+    };
+    bakeLayer(skyStars, SKY_STARS_UNIT, 0, SkyCubemap::STARS_SIZE);
+    bakeLayer(skyNebula, SKY_NEBULA_UNIT, 1, SkyCubemap::NEBULA_SIZE);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindFramebuffer(GL_FRAMEBUFFER, static_cast<unsigned int>(previous));
+    glDeleteFramebuffers(1, &framebuffer);
+}
+
+bool GpuRenderer::warmUp() {
+    if (shaders.warmUp()) return true;
+    if (blockShaders && blockShaders->warmUp()) return true;
+    if (reconstructShaders && reconstructShaders->warmUp()) return true;
+    if (subsetShaders && subsetShaders->warmUp()) return true;
+    if (resolveShaders && resolveShaders->warmUp()) return true;
+    if (historyShaders && historyShaders->warmUp()) return true;
+    if (classifyShaders && classifyShaders->warmUp()) return true;
+    if (marchShaders && marchShaders->warmUp()) return true;
+    return passShaders && passShaders->warmUp();
+}
+
+bool GpuRenderer::loadStarCatalog(const std::string& path) {
+    const auto start = std::chrono::steady_clock::now();
+    StarCatalog catalog;
+    if (!catalog.open(path)) {
+        return false;
+    }
+    splatStars(catalog);
+    glFinish();
+    std::cout << "Star catalog: " << catalog.starCount() << " stars in "
+              << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms"
+              << std::endl;
+    return true;
+}
+
+void GpuRenderer::splatStars(const StarCatalog& catalog) {
+    Shader splat(CATALOG_VERT_SRC, CATALOG_FRAG_SRC);
+    int previous = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+    unsigned int framebuffer = 0;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+    unsigned int starArray = 0;
+    unsigned int starBuffer = 0;
+    glGenVertexArrays(1, &starArray);
+    glGenBuffers(1, &starBuffer);
+    glBindVertexArray(starArray);
+    glBindBuffer(GL_ARRAY_BUFFER, starBuffer);
+    constexpr int stride = sizeof(StarCatalog::Star);
+    glVertexAttribPointer(0, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride,
+                          reinterpret_cast<void*>(offsetof(StarCatalog::Star, s)));
+    glVertexAttribPointer(1, 1, GL_SHORT, GL_FALSE, stride,
+                          reinterpret_cast<void*>(offsetof(StarCatalog::Star, magnitude)));
+    glVertexAttribPointer(2, 1, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+                          reinterpret_cast<void*>(offsetof(StarCatalog::Star, color)));
+    for (int attribute = 0; attribute < 3; attribute++) {
+        glEnableVertexAttribArray(attribute);
+    }
+
+    // Colors add up; where splats overlap the texel keeps the largest twinkle seed
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    glBlendEquationSeparate(GL_FUNC_ADD, GL_MAX);
+    glEnable(GL_PROGRAM_POINT_SIZE);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glViewport(0, 0, SkyCubemap::STARS_SIZE, SkyCubemap::STARS_SIZE);
+
+    const int tiles = catalog.tilesPerFace();
+    const float tileSize = 2.0f / static_cast<float>(tiles);
+    splat.use();
+    splat.setFloat("u_tileSize", tileSize);
+    splat.setFloat("u_pointSize", CATALOG_POINT_SIZE);
+    for (int face = 0; face < 6; face++) {
+        // Splats are clipped at the face edge rather than continued on the neighbour
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, skyStars,
+                               0);
+        glClear(GL_COLOR_BUFFER_BIT);
+        for (int ty = 0; ty < tiles; ty++) {
+            for (int tx = 0; tx < tiles; tx++) {
+                const std::span<const StarCatalog::Star> stars = catalog.tile((face * tiles + ty) * tiles + tx);
+                splat.setVec2("u_tileOrigin", -1.0f + tx * tileSize, -1.0f + ty * tileSize);
+                for (std::size_t first = 0; first < stars.size(); first += CATALOG_STREAM_STARS) {
+                    const std::size_t count = std::min(stars.size() - first, CATALOG_STREAM_STARS);
+                    // Orphan the previous upload instead of waiting for its draw
+                    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(count * stride), stars.data() + first,
+                                 GL_STREAM_DRAW);
+                    glDrawArrays(GL_POINTS, 0, static_cast<int>(count));
+                }
+            }
+        }
+        // No nebula band in a real sky: the faint stars make the Milky Way
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, skyNebula,
+                               0);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+
+    glDisable(GL_PROGRAM_POINT_SIZE);
+    glBlendEquationSeparate(GL_FUNC_ADD, GL_FUNC_ADD);
+    glBlendFunc(GL_ONE, GL_ZERO);
+    glDisable(GL_BLEND);
+    glActiveTexture(GL_TEXTURE0 + SKY_STARS_UNIT);
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    glActiveTexture(GL_TEXTURE0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, static_cast<unsigned int>(previous));
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteBuffers(1, &starBuffer);
+    glDeleteVertexArrays(1, &starArray);
+}
+
+// Upload this frame's uniforms, one write per block
+void GpuRenderer::uploadFrame(const FrameUniforms& u) {
+    const FrameBlock frameBlock = makeFrameBlock(u);
+    frameBuffer.update(&frameBlock, sizeof(frameBlock));
+    const PlanetBlock planetBlock = makePlanetBlock(u);
+    planetBuffer.update(&planetBlock, sizeof(planetBlock));
+    if (u.enablePlanets && u.bodies) {
+        uploadBodies(*u.bodies);
+    }
+}
+
+// The grid is rebuilt every frame, so both textures are rewritten every frame
+void GpuRenderer::uploadBodies(const BodyGrid& grid) {
+    if (bodyCells == 0) {
+        glGenTextures(1, &bodyCells);
+        glGenTextures(1, &bodyItems);
+        for (const unsigned int texture : {bodyCells, bodyItems}) {
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        }
+    }
+
+    const int side = grid.resolution();
+    glActiveTexture(GL_TEXTURE0 + BODY_CELLS_UNIT);
+    glBindTexture(GL_TEXTURE_2D, bodyCells);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32I, side, side, 0, GL_RG_INTEGER, GL_INT, grid.cellRanges().data());
+
+    // Whole rows, then what is left for the last one; the texture only grows
+    const int texels = 2 * static_cast<int>(grid.cellItems().size());
+    const int rows = (texels + BODY_ITEMS_WIDTH - 1) / BODY_ITEMS_WIDTH;
+    const float* data = &grid.cellItems().front().position.x;
+    glActiveTexture(GL_TEXTURE0 + BODY_ITEMS_UNIT);
+    glBindTexture(GL_TEXTURE_2D, bodyItems);
+    if (rows > bodyItemRows) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, BODY_ITEMS_WIDTH, rows, 0, GL_RGBA, GL_FLOAT, nullptr);
+        bodyItemRows = rows;
+    }
+    if (texels >= BODY_ITEMS_WIDTH) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, BODY_ITEMS_WIDTH, texels / BODY_ITEMS_WIDTH, GL_RGBA, GL_FLOAT, data);
+    }
+    if (texels % BODY_ITEMS_WIDTH) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, texels / BODY_ITEMS_WIDTH, texels % BODY_ITEMS_WIDTH, 1, GL_RGBA, GL_FLOAT,
+                        data + 4 * (texels - texels % BODY_ITEMS_WIDTH));
+    }
+    glActiveTexture(GL_TEXTURE0);
+}
+
+// Fullscreen quad into the bound framebuffer
+void GpuRenderer::drawQuad(const Shader& shader, const int width, const int height) const {
+    glViewport(0, 0, width, height);
+    shader.use();
+    glBindVertexArray(VAO);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+void GpuRenderer::render(const FrameUniforms& u) {
+    // Clear
+    glViewport(0, 0, static_cast<int>(u.resolution[0]), static_cast<int>(u.resolution[1]));
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    uploadFrame(u);
+    drawQuad(shaders.get(featureMask(u)), static_cast<int>(u.resolution[0]), static_cast<int>(u.resolution[1]));
+}
+
+void GpuRenderer::renderScaled(const FrameUniforms& u, const float scale) {
+    const int outputWidth = static_cast<int>(u.resolution[0]);
+    const int outputHeight = static_cast<int>(u.resolution[1]);
+    const int width = std::clamp(static_cast<int>(std::lround(outputWidth * scale)), 1, outputWidth);
+    const int height = std::clamp(static_cast<int>(std::lround(outputHeight * scale)), 1, outputHeight);
+    if (width == outputWidth && height == outputHeight) {
+        render(u);
+        return;
+    }
+
+    int output = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &output);
+    if (!sceneTarget || sceneTarget->width < outputWidth || sceneTarget->height < outputHeight) {
+        sceneTarget = std::make_unique<RenderTarget>(outputWidth, outputHeight);
+    }
+
+    // Ray march into the lower left width x height texels
+    FrameUniforms scaled = u;
+    scaled.resolution[0] = static_cast<float>(width);
+    scaled.resolution[1] = static_cast<float>(height);
+    sceneTarget->bind();
+    render(scaled);
+
+    // Upsample to the caller's framebuffer
+    present(*sceneTarget, width, height, static_cast<unsigned int>(output), outputWidth, outputHeight);
+}
+
+void GpuRenderer::present(const RenderTarget& source, const int width, const int height,
+                          const unsigned int output, const int outputWidth, const int outputHeight) {
+    if (!upsample) {
+        upsample = std::make_unique<Shader>(BLACKHOLE_VERT_SRC, UPSAMPLE_FRAG_SRC);
+        upsample->use();
+        upsample->setInt("u_source", 0);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, output);
+    upsample->use();
+    upsample->setVec2("u_sourceSize", static_cast<float>(width), static_cast<float>(height));
+    upsample->setVec2("u_outputSize", static_cast<float>(outputWidth), static_cast<float>(outputHeight));
+    glBindTexture(GL_TEXTURE_2D, source.texture);
+    drawQuad(*upsample, outputWidth, outputHeight);
+}
+
+void GpuRenderer::renderReconstructed(const FrameUniforms& u, const int stride) {
+    if (stride <= 1) {
+        render(u);
+        return;
+    }
+    const int width = static_cast<int>(u.resolution[0]);
+    const int height = static_cast<int>(u.resolution[1]);
+    const int blocksX = (width + stride - 1) / stride;
+    const int blocksY = (height + stride - 1) / stride;
+
+    // Before any target is created: creating one binds its framebuffer
+    int output = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &output);
+
+    if (stride != reducedStride) {
+        const std::string strideDefine = "#define MARCH_STRIDE " + std::to_string(stride) + "\n";
+        blockShaders = std::make_unique<ShaderPermutations>(BLACKHOLE_VERT_SRC, BLACKHOLE_FRAG_SRC,
+                                                            FEATURE_PERMUTATIONS, setupProgram,
+                                                            strideDefine + "#define HIT_INFO\n");
+        reconstructShaders = std::make_unique<ShaderPermutations>(BLACKHOLE_VERT_SRC, BLACKHOLE_FRAG_SRC,
+                                                                  FEATURE_PERMUTATIONS, setupProgram,
+                                                                  strideDefine + "#define RECONSTRUCT\n");
+        reducedStride = stride;
+    }
+    if (!blockTarget || blockTarget->width < blocksX || blockTarget->height < blocksY) {
+        blockTarget = std::make_unique<RenderTarget>(blocksX, blocksY, GL_RGBA16F);
+    }
+
+    const unsigned int mask = featureMask(u);
+    uploadFrame(u);
+
+    // Pass 1: one ray per block, color + classification
+    glBindFramebuffer(GL_FRAMEBUFFER, blockTarget->framebuffer);
+    drawQuad(blockShaders->get(mask), blocksX, blocksY);
+
+    // Pass 2: interpolate where the blocks agree and mark those pixels in the stencil
+    glBindFramebuffer(GL_FRAMEBUFFER, static_cast<unsigned int>(output));
+    bindTextures(BLOCK_COLOR_UNIT, *blockTarget);
+
+    glEnable(GL_STENCIL_TEST);
+    glStencilMask(0xFF);
+    glClearStencil(0);
+    glClear(GL_STENCIL_BUFFER_BIT);
+    glStencilFunc(GL_ALWAYS, 1, 0xFF);
+    glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+    drawQuad(reconstructShaders->get(mask), width, height);
+
+    // Pass 3: a full-resolution ray for every pixel pass 2 discarded
+    glStencilFunc(GL_EQUAL, 0, 0xFF);
+    glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+    drawQuad(shaders.get(mask), width, height);
+    glDisable(GL_STENCIL_TEST);
+}
+
+void GpuRenderer::renderTemporal(const FrameUniforms& u) {
+    const int width = static_cast<int>(u.resolution[0]);
+    const int height = static_cast<int>(u.resolution[1]);
+    const int blocksX = (width + 1) / 2;
+    const int blocksY = (height + 1) / 2;
+    int output = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &output);
+
+    if (!subsetShaders) {
+        subsetShaders = std::make_unique<ShaderPermutations>(BLACKHOLE_VERT_SRC, BLACKHOLE_FRAG_SRC,
+                                                             FEATURE_PERMUTATIONS, setupProgram,
+                                                             "#define MARCH_STRIDE 2\n#define HIT_INFO\n"
+                                                             "#define TEMPORAL\n");
+        resolveShaders = std::make_unique<ShaderPermutations>(BLACKHOLE_VERT_SRC, BLACKHOLE_FRAG_SRC,
+                                                              FEATURE_PERMUTATIONS, setupProgram,
+                                                              "#define MARCH_STRIDE 2\n#define HIT_INFO\n"
+                                                              "#define TEMPORAL_RESOLVE\n");
+        historyShaders = std::make_unique<ShaderPermutations>(BLACKHOLE_VERT_SRC, BLACKHOLE_FRAG_SRC,
+                                                              FEATURE_PERMUTATIONS, setupProgram,
+                                                              "#define HIT_INFO\n");
+    }
+    for (std::unique_ptr<RenderTarget>& target : history) {
+        if (!target || target->width < width || target->height < height) {
+            target = std::make_unique<RenderTarget>(width, height, GL_RGBA16F);
+            historyValid = false;
+        }
+    }
+    if (!blockTarget || blockTarget->width < blocksX || blockTarget->height < blocksY) {
+        blockTarget = std::make_unique<RenderTarget>(blocksX, blocksY, GL_RGBA16F);
+    }
+
+    // The history only carries over camera motion and time
+    const unsigned int mask = featureMask(u);
+    historyValid = historyValid && historyFrame.resolution[0] == u.resolution[0] &&
+                   historyFrame.resolution[1] == u.resolution[1] && featureMask(historyFrame) == mask &&
+                   historyFrame.lensingModel == u.lensingModel && historyFrame.mass == u.mass &&
+                   historyFrame.spin == u.spin && historyFrame.diskOuterRadius == u.diskOuterRadius &&
+                   historyFrame.planetCount == u.planetCount && historyFrame.bodies == u.bodies;
+
+    const RenderTarget& previous = *history[historyIndex];
+    const RenderTarget& current = *history[historyIndex ^ 1];
+    uploadFrame(u);
+
+    if (!historyValid) {
+        glBindFramebuffer(GL_FRAMEBUFFER, current.framebuffer);
+        drawQuad(historyShaders->get(mask), width, height);
+    } else {
+        const int* offset = SUBSET_OFFSETS[temporalFrame++ % 4];
+
+        // Pass 1: this frame's quarter of the pixels, color + classification
+        glBindFramebuffer(GL_FRAMEBUFFER, blockTarget->framebuffer);
+        const Shader& subset = subsetShaders->get(mask);
+        subset.use();
+        subset.setVec2("u_subsetOffset", static_cast<float>(offset[0]), static_cast<float>(offset[1]));
+        drawQuad(subset, blocksX, blocksY);
+
+        // Pass 2: fresh pixels and accepted history, marking both in the stencil
+        glBindFramebuffer(GL_FRAMEBUFFER, current.framebuffer);
+        bindTextures(BLOCK_COLOR_UNIT, *blockTarget);
+        bindTextures(HISTORY_COLOR_UNIT, previous);
+        const Mat4 previousView = historyFrame.invViewMatrix.inverse();
+        const Shader& resolve = resolveShaders->get(mask);
+        resolve.use();
+        resolve.setVec2("u_subsetOffset", static_cast<float>(offset[0]), static_cast<float>(offset[1]));
+        resolve.setMat4("u_previousView", previousView.m);
+
+        glEnable(GL_STENCIL_TEST);
+        glStencilMask(0xFF);
+        glClearStencil(0);
+        glClear(GL_STENCIL_BUFFER_BIT);
+        glStencilFunc(GL_ALWAYS, 1, 0xFF);
+        glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+        drawQuad(resolve, width, height);
+
+        // Pass 3: a full ray for every rejected pixel
+        glStencilFunc(GL_EQUAL, 0, 0xFF);
+        glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+        drawQuad(historyShaders->get(mask), width, height);
+        glDisable(GL_STENCIL_TEST);
+    }
+
+    present(current, width, height, static_cast<unsigned int>(output), width, height);
+    historyIndex ^= 1;
+    historyFrame = u;
+    historyValid = true;
+}
+
+void GpuRenderer::renderCompute(const FrameUniforms& u) {
+    const int width = static_cast<int>(u.resolution[0]);
+    const int height = static_cast<int>(u.resolution[1]);
+    // Before any target is created: creating one binds its framebuffer
+    int output = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &output);
+
+    if (!classifyShaders) {
+        classifyShaders = std::make_unique<ShaderPermutations>(nullptr, BLACKHOLE_FRAG_SRC, FEATURE_PERMUTATIONS,
+                                                               setupProgram,
+                                                               "#define COMPUTE\n#define COMPUTE_CLASSIFY\n");
+        marchShaders = std::make_unique<ShaderPermutations>(nullptr, BLACKHOLE_FRAG_SRC, FEATURE_PERMUTATIONS,
+                                                            setupProgram, "#define COMPUTE\n#define COMPUTE_MARCH\n");
+        passShaders = std::make_unique<ShaderPermutations>(
+            nullptr, BLACKHOLE_FRAG_SRC, FEATURE_PERMUTATIONS, setupProgram,
+            "#define COMPUTE\n#define COMPUTE_MARCH_PASS\n#define MARCH_PASS_STEPS " +
+                std::to_string(MARCH_PASS_STEPS) + "\n");
+    }
+    if (!computeTarget || computeTarget->width < width || computeTarget->height < height) {
+        computeTarget = std::make_unique<RenderTarget>(width, height);
+    }
+    // The marched model runs in passes; the others march each ray to its end
+    const bool passes = u.enableLensing && !cpu::useBinet(u) && !cpu::useKerr(u) && !cpu::useGeodesic(u) &&
+                        !cpu::useDeflectionLut(u);
+    // Header plus one packed pixel per ray
+    const long long queueSize = sizeof(RAY_QUEUE_RESET) + 4LL * width * height;
+    reserveStorage(rayQueues[0], rayQueueSizes[0], queueSize);
+    if (passes) {
+        reserveStorage(rayQueues[1], rayQueueSizes[1], queueSize);
+        reserveStorage(marchStates, marchStatesSize, MARCH_STATE_BYTES * width * height);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, rayQueues[0]);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(RAY_QUEUE_RESET), RAY_QUEUE_RESET);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, rayQueues[0]);
+
+    const unsigned int mask = featureMask(u);
+    uploadFrame(u);
+    glBindImageTexture(0, computeTarget->texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+    // Stage 1: sky-only rays shaded, the rest queued
+    const Shader& classify = classifyShaders->get(mask);
+    classify.use();
+    classify.setInt("u_maxGroupsX", maxGroupsX);
+    glDispatchCompute((width + CLASSIFY_TILE - 1) / CLASSIFY_TILE, (height + CLASSIFY_TILE - 1) / CLASSIFY_TILE, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+    if (!passes) {
+        // Stage 2: march the queue, its size read back on the GPU
+        marchShaders->get(mask).use();
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, rayQueues[0]);
+        glDispatchComputeIndirect(0);
+    } else {
+        // Stage 2, in passes: each marches its queue MARCH_PASS_STEPS further
+        // and compacts the unfinished rays into the other queue. Enough passes
+        // for every step are issued; the ones after the queue empties
+        // dispatch no groups.
+        const Shader& pass = passShaders->get(mask);
+        pass.use();
+        pass.setInt("u_maxGroupsX", maxGroupsX);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, marchStates);
+        const int steps = std::min(u.maxSteps, cpu::MAX_STEPS);
+        const int passCount = std::max((steps + MARCH_PASS_STEPS - 1) / MARCH_PASS_STEPS, 1);
+        for (int i = 0; i < passCount; i++) {
+            const unsigned int queue = rayQueues[i & 1];
+            const unsigned int next = rayQueues[(i + 1) & 1];
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, next);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(RAY_QUEUE_RESET), RAY_QUEUE_RESET);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, queue);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, next);
+            pass.setInt("u_marchPass", i);
+            glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, queue);
+            glDispatchComputeIndirect(0);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+        }
+    }
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    present(*computeTarget, width, height, static_cast<unsigned int>(output), width, height);
+}
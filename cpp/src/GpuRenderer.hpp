@@ -0,0 +1,117 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "RenderTarget.hpp"
+#include "Shader.hpp"
+#include "Simulation.hpp"
+#include "StarCatalog.hpp"
+
+// The GPU ray marcher: fullscreen quad, the shader permutations, the shared
+// frame uniform buffer and the deflection table texture. Needs a current
+// OpenGL 3.3 context with functions loaded; the window and the headless
+// path draw through the same instance.
+class GpuRenderer {
+public:
+    GpuRenderer();
+    ~GpuRenderer();
+    GpuRenderer(const GpuRenderer&) = delete;
+    GpuRenderer& operator=(const GpuRenderer&) = delete;
+
+    // Draws one frame into the bound framebuffer, viewport set from u.resolution
+    void render(const FrameUniforms& u);
+    // Ray marches at 'scale' times the resolution of u into an offscreen target,
+    // then stretches the result over the bound framebuffer (u.resolution)
+    void renderScaled(const FrameUniforms& u, float scale);
+    // Marches one ray per stride x stride pixel block, then fills in the full
+    // resolution image: interpolated where neighbouring blocks agree on what
+    // the ray hit, re-marched per pixel along silhouettes and strong lensing.
+    // The re-march is a separate pass masked by the stencil buffer, so the
+    // interpolated pixels never run the march code. The bound framebuffer
+    // needs stencil bits to save anything (without, every pixel is re-marched).
+    // stride 2 or 4; 1 is the same as render().
+    void renderReconstructed(const FrameUniforms& u, int stride);
+    // Temporal reprojection for slowly moving cameras: each frame marches one
+    // pixel of every 2x2 block (rotating through the four), reprojects the
+    // previous frame with the old view matrix for the other three and
+    // re-marches the pixels whose history disagrees with the fresh rays around
+    // them. Needs no stencil in the bound framebuffer; the history lives in two
+    // offscreen targets. Any change besides the camera and time (size, toggles,
+    // lensing model, mass, disk) restarts from a full frame.
+    void renderTemporal(const FrameUniforms& u);
+    // Compute shader path (GL 4.3): a classification dispatch over 8x8 tiles
+    // writes the rays that only see the sky straight into an offscreen image
+    // and compacts the rest into a ray queue, which indirect dispatches of 64
+    // rays per group march. The marched model goes in passes of 64 steps,
+    // each requeueing only the unfinished rays, so rays that hit the
+    // horizon or the disk early leave their groups instead of idling beside
+    // long sky rays; the other models march every ray to its end in one
+    // dispatch. The image is then copied to the bound framebuffer. Only call
+    // when computeAvailable().
+    void renderCompute(const FrameUniforms& u);
+    [[nodiscard]] bool computeAvailable() const { return compute; }
+    // Replaces the procedural stars and nebula with a StarCatalog file: maps
+    // it, streams it tile by tile through a small vertex buffer and splats
+    // the stars into the sky cubemap once. False if the file can't be used.
+    bool loadStarCatalog(const std::string& path);
+    // Builds one more shader permutation ahead of use; false once all exist
+    bool warmUp();
+
+private:
+    unsigned int VAO = 0;
+    unsigned int VBO = 0;
+    unsigned int deflectionLut = 0;
+    // Baked background sky (starField in BLACKHOLE_FRAG_SRC)
+    unsigned int skyStars = 0;
+    unsigned int skyNebula = 0;
+    // Small body grid cells and items, written by every frame that has bodies
+    unsigned int bodyCells = 0;
+    unsigned int bodyItems = 0;
+    int bodyItemRows = 0;
+    UniformBuffer frameBuffer;
+    UniformBuffer planetBuffer;
+    ShaderPermutations shaders;
+    // Created on the first scaled frame; the target only ever grows
+    std::unique_ptr<RenderTarget> sceneTarget;
+    std::unique_ptr<Shader> upsample;
+    // Block march (HIT_INFO) and interpolation (RECONSTRUCT) programs for reducedStride
+    int reducedStride = 0;
+    std::unique_ptr<ShaderPermutations> blockShaders;
+    std::unique_ptr<ShaderPermutations> reconstructShaders;
+    std::unique_ptr<RenderTarget> blockTarget;
+    // Temporal pipeline: subset march (TEMPORAL), resolve (TEMPORAL_RESOLVE)
+    // and full-resolution march with HIT_INFO, all writing the history targets
+    std::unique_ptr<ShaderPermutations> subsetShaders;
+    std::unique_ptr<ShaderPermutations> resolveShaders;
+    std::unique_ptr<ShaderPermutations> historyShaders;
+    std::unique_ptr<RenderTarget> history[2];
+    int historyIndex = 0;
+    unsigned int temporalFrame = 0;
+    bool historyValid = false;
+    FrameUniforms historyFrame;
+    // Compute path: classification (COMPUTE_CLASSIFY), march (COMPUTE_MARCH)
+    // and march pass (COMPUTE_MARCH_PASS) programs, the output image, the two
+    // ray queues the passes alternate between and the saved ray states, all
+    // grown on demand
+    bool compute = false;
+    std::unique_ptr<ShaderPermutations> classifyShaders;
+    std::unique_ptr<ShaderPermutations> marchShaders;
+    std::unique_ptr<ShaderPermutations> passShaders;
+    std::unique_ptr<RenderTarget> computeTarget;
+    unsigned int rayQueues[2] = {0, 0};
+    long long rayQueueSizes[2] = {0, 0};
+    unsigned int marchStates = 0;
+    long long marchStatesSize = 0;
+    // GL_MAX_COMPUTE_WORK_GROUP_COUNT in x; longer queues spill into y
+    int maxGroupsX = 65535;
+
+    void bakeSky();
+    void splatStars(const StarCatalog& catalog);
+    void uploadFrame(const FrameUniforms& u);
+    void uploadBodies(const BodyGrid& grid);
+    void drawQuad(const Shader& shader, int width, int height) const;
+    // Stretches the lower left width x height texels of source over the output framebuffer
+    void present(const RenderTarget& source, int width, int height, unsigned int output,
+                 int outputWidth, int outputHeight);
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "Shader.hpp"
+
+// OpenGL 3.3 core context with no window and no display server: a surfaceless
+// EGL display (Mesa's llvmpipe works on any farm node). Rendering goes into a
+// RenderTarget since there is no default framebuffer.
+class HeadlessContext {
+public:
+    HeadlessContext() = default;
+    ~HeadlessContext();
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+    // Creates the context and makes it current; false (with a message) if the
+    // platform has no usable EGL or the build has no EGL support
+    bool create();
+
+    // Pass to loadOpenGLFunctions() once create() succeeded
+    static GLProcLoader procLoader();
+
+private:
+    void* display = nullptr;
+    void* context = nullptr;
+};
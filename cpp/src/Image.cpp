@@ -0,0 +1,125 @@
+#include "Image.hpp"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+
+bool writePPM(const std::string &path, const Image &image) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) return false;
+
+    file << "P6\n" << image.width << " " << image.height << "\n255\n";
+
+    std::vector<char> line(static_cast<std::size_t>(image.width) * 3);
+    for (int y = image.height - 1; y >= 0; y--) {
+        const std::uint8_t *src = image.row(y);
+        for (int x = 0; x < image.width; x++) {
+            line[x * 3 + 0] = static_cast<char>(src[x * 4 + 0]);
+            line[x * 3 + 1] = static_cast<char>(src[x * 4 + 1]);
+            line[x * 3 + 2] = static_cast<char>(src[x * 4 + 2]);
+        }
+        file.write(line.data(), static_cast<std::streamsize>(line.size()));
+    }
+    return static_cast<bool>(file);
+}
+
+static std::uint32_t crc32(const std::uint8_t *data, const std::size_t size, std::uint32_t crc = 0) {
+    static const std::array<std::uint32_t, 256> table = [] {
+        std::array<std::uint32_t, 256> t{};
+        for (std::uint32_t n = 0; n < 256; n++) {
+            std::uint32_t c = n;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[n] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for (std::size_t i = 0; i < size; i++) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void putBigEndian(std::vector<std::uint8_t> &out, const std::uint32_t value) {
+    out.push_back(static_cast<std::uint8_t>(value >> 24));
+    out.push_back(static_cast<std::uint8_t>(value >> 16));
+    out.push_back(static_cast<std::uint8_t>(value >> 8));
+    out.push_back(static_cast<std::uint8_t>(value));
+}
+
+static void writeChunk(std::ofstream &file, const char type[4], const std::vector<std::uint8_t> &data) {
+    std::vector<std::uint8_t> chunk;
+    chunk.reserve(data.size() + 12);
+    putBigEndian(chunk, static_cast<std::uint32_t>(data.size()));
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    putBigEndian(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+    file.write(reinterpret_cast<const char *>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+}
+
+bool writePNG(const std::string &path, const Image &image) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) return false;
+
+    constexpr std::uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    file.write(reinterpret_cast<const char *>(signature), sizeof(signature));
+
+    std::vector<std::uint8_t> header;
+    putBigEndian(header, static_cast<std::uint32_t>(image.width));
+    putBigEndian(header, static_cast<std::uint32_t>(image.height));
+    header.insert(header.end(), {8, 2, 0, 0, 0}); // 8-bit RGB, no interlace
+    writeChunk(file, "IHDR", header);
+
+    // Scanlines (filter byte 0 + RGB), top-down
+    const std::size_t stride = static_cast<std::size_t>(image.width) * 3 + 1;
+    std::vector<std::uint8_t> raw(stride * image.height);
+    for (int y = 0; y < image.height; y++) {
+        const std::uint8_t *src = image.row(image.height - 1 - y);
+        std::uint8_t *dst = raw.data() + y * stride;
+        dst[0] = 0;
+        for (int x = 0; x < image.width; x++) {
+            dst[1 + x * 3 + 0] = src[x * 4 + 0];
+            dst[1 + x * 3 + 1] = src[x * 4 + 1];
+            dst[1 + x * 3 + 2] = src[x * 4 + 2];
+        }
+    }
+
+    // zlib stream of stored deflate blocks (at most 65535 bytes each)
+    std::vector<std::uint8_t> zlib = {0x78, 0x01};
+    zlib.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+    std::uint32_t a = 1, b = 0;
+    for (std::size_t offset = 0; offset < raw.size() || offset == 0;) {
+        const std::size_t size = std::min<std::size_t>(65535, raw.size() - offset);
+        const bool last = offset + size == raw.size();
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back(static_cast<std::uint8_t>(size));
+        zlib.push_back(static_cast<std::uint8_t>(size >> 8));
+        zlib.push_back(static_cast<std::uint8_t>(~size));
+        zlib.push_back(static_cast<std::uint8_t>(~size >> 8));
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + size);
+        // Adler-32; 5552 bytes is the most that can be summed before the modulo overflows
+        for (std::size_t i = offset; i < offset + size;) {
+            for (const std::size_t end = std::min(offset + size, i + 5552); i < end; i++) {
+                a += raw[i];
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+        }
+        offset += size;
+        if (last) break;
+    }
+    putBigEndian(zlib, (b << 16) | a);
+    writeChunk(file, "IDAT", zlib);
+    writeChunk(file, "IEND", {});
+    return static_cast<bool>(file);
+}
+
+bool writeRaw(const std::string &path, const Image &image) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) return false;
+
+    const auto rowBytes = static_cast<std::streamsize>(image.width) * 4;
+    for (int y = image.height - 1; y >= 0; y--) {
+        file.write(reinterpret_cast<const char *>(image.row(y)), rowBytes);
+    }
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 8-bit RGBA pixels, rows stored bottom-up like glReadPixels returns them
+struct Image {
+    int width = 0;
+    int height = 0;
+    std::vector<std::uint8_t> rgba;
+
+    void resize(const int w, const int h) {
+        width = w;
+        height = h;
+        rgba.assign(static_cast<std::size_t>(w) * static_cast<std::size_t>(h) * 4, 0);
+    }
+
+    [[nodiscard]] std::uint8_t *row(const int y) { return rgba.data() + static_cast<std::size_t>(y) * width * 4; }
+    [[nodiscard]] const std::uint8_t *row(const int y) const {
+        return rgba.data() + static_cast<std::size_t>(y) * width * 4;
+    }
+};
+
+// Binary PPM (P6), written top-down. Returns false if the file can't be written.
+bool writePPM(const std::string &path, const Image &image);
+// 8-bit RGB PNG, top-down. Deflate blocks are stored, not compressed: no zlib
+// needed and cheap enough for a writer thread to keep up with capture.
+bool writePNG(const std::string &path, const Image &image);
+// Headerless RGBA8, top row first (width * height * 4 bytes)
+bool writeRaw(const std::string &path, const Image &image);
@@ -14,6 +14,15 @@ struct Vec3 {
     Vec3 operator+(const Vec3 &other) const { return {x + other.x, y + other.y, z + other.z}; }
     Vec3 operator-(const Vec3 &other) const { return {x - other.x, y - other.y, z - other.z}; }
     Vec3 operator*(const float scalar) const { return {x * scalar, y * scalar, z * scalar}; }
+    Vec3 operator*(const Vec3 &other) const { return {x * other.x, y * other.y, z * other.z}; }
+    Vec3 operator-() const { return {-x, -y, -z}; }
+
+    Vec3 &operator+=(const Vec3 &other) {
+        x += other.x;
+        y += other.y;
+        z += other.z;
+        return *this;
+    }
 
     [[nodiscard]] float length() const { return std::sqrt(x * x + y * y + z * z); }
 
@@ -65,6 +74,13 @@ struct Mat4 {
         return result;
     }
 
+    // Column-major like GLSL: equivalent to (M * vec4(v, 0.0)).xyz
+    [[nodiscard]] Vec3 transformDirection(const Vec3 &v) const {
+        return {m[0] * v.x + m[4] * v.y + m[8] * v.z,
+                m[1] * v.x + m[5] * v.y + m[9] * v.z,
+                m[2] * v.x + m[6] * v.y + m[10] * v.z};
+    }
+
     [[nodiscard]] Mat4 inverse() const {
         Mat4 inv;
 
@@ -0,0 +1,263 @@
+#include <GLFW/glfw3.h>
+#include "OfflineRender.hpp"
+
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+
+#include "GpuRenderer.hpp"
+#include "HeadlessContext.hpp"
+#include "RenderTarget.hpp"
+
+void printOfflineUsage(const char* program) {
+    std::cerr << "Usage: " << program << " --render [options]\n"
+              << "  --size WxH            resolution (1280x720)\n"
+              << "  --frames N            frame count (1)\n"
+              << "  --fps F               simulation frames per second (30)\n"
+              << "  --start T             time of the first frame in seconds (0)\n"
+              << "  --azimuth A           camera azimuth in radians (0.5)\n"
+              << "  --elevation E         camera angle from the pole in radians (1.5)\n"
+              << "  --radius R            camera distance (15)\n"
+              << "  --orbit W             camera azimuth speed in radians per second (0)\n"
+              << "  --mass M              black hole mass (1)\n"
+              << "  --disk R              disk outer radius (8)\n"
+              << "  --spin S              spin a/M of the kerr model, 0 to 0.998 (0)\n"
+              << "  --lensing MODEL       marched, table, rk45, kerr or binet (marched)\n"
+              << "  --no-starfield, --no-planets, --no-disk, --no-lensing\n"
+              << "  --march-stride S      one ray per SxS block plus edge re-marching, 1, 2 or 4 (1)\n"
+              << "  --temporal            march a quarter of the pixels, reproject the previous frame\n"
+              << "  --compute             compute shader path with ray compaction (needs OpenGL 4.3)\n"
+              << "  --stars FILE          star catalog from blackhole_starcatalog instead of the procedural sky\n"
+              << "  --planets FILE        planet list instead of the default two (see loadPlanets)\n"
+              << "  --belt N              asteroid belt of N small bodies between the planets (0)\n"
+              << "  --output DIR          write frames to DIR (nothing is written without it)\n"
+              << "  --format FMT          png, ppm or raw (png)" << std::endl;
+}
+
+static bool parseNumber(const char* text, double& value) {
+    char* end = nullptr;
+    value = std::strtod(text, &end);
+    return end != text && *end == '\0';
+}
+
+bool loadPlanets(const std::string& path, std::vector<Planet>& planets) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Failed to open planet list " << path << std::endl;
+        return false;
+    }
+    planets.clear();
+    std::string line;
+    for (int number = 1; std::getline(file, line); number++) {
+        const std::size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') {
+            continue;
+        }
+        std::istringstream fields(line);
+        Planet planet{};
+        planet.bands = 0.0f;
+        if (!(fields >> planet.orbitRadius >> planet.speed >> planet.phase >> planet.radius >> planet.color.x >>
+              planet.color.y >> planet.color.z) ||
+            planet.radius <= 0.0f) {
+            std::cerr << path << ":" << number << ": expected orbit speed phase radius r g b [bands]" << std::endl;
+            return false;
+        }
+        fields >> planet.bands;
+        planets.push_back(planet);
+    }
+    if (planets.size() > MAX_PLANETS) {
+        std::cerr << path << ": " << planets.size() << " planets, only the first " << MAX_PLANETS << " are drawn"
+                  << std::endl;
+    }
+    return true;
+}
+
+bool parseOfflineOptions(const int argc, char* argv[], const int first, OfflineOptions& options) {
+    for (int i = first; i < argc; i++) {
+        const std::string arg = argv[i];
+
+        // Flags without a value
+        if (arg == "--no-starfield") { options.params.starfieldOn = false; continue; }
+        if (arg == "--no-planets") { options.params.planetsOn = false; continue; }
+        if (arg == "--no-disk") { options.params.diskOn = false; continue; }
+        if (arg == "--no-lensing") { options.params.lensingOn = false; continue; }
+        if (arg == "--temporal") { options.temporal = true; continue; }
+        if (arg == "--compute") { options.compute = true; continue; }
+
+        if (i + 1 >= argc) {
+            std::cerr << "Unknown option or missing value: '" << arg << "'" << std::endl;
+            return false;
+        }
+        const char* value = argv[++i];
+        double number = 0.0;
+        const bool isNumber = parseNumber(value, number);
+        // Counts are never truncated: --frames 2.5 is an error, not 2 frames
+        const bool isCount = isNumber && number == std::floor(number) && number <= INT_MAX;
+
+        if (arg == "--size") {
+            char* end = nullptr;
+            options.width = static_cast<int>(std::strtol(value, &end, 10));
+            options.height = (*end == 'x') ? static_cast<int>(std::strtol(end + 1, &end, 10)) : 0;
+            if (*end != '\0' || options.width <= 0 || options.height <= 0) {
+                std::cerr << "Invalid size '" << value << "', expected WxH" << std::endl;
+                return false;
+            }
+        } else if (arg == "--output") {
+            options.outputDirectory = value;
+        } else if (arg == "--stars") {
+            options.starCatalog = value;
+        } else if (arg == "--planets") {
+            if (!loadPlanets(value, options.params.planets)) {
+                return false;
+            }
+        } else if (arg == "--format") {
+            if (!FrameCapture::parseFormat(value, options.format)) {
+                std::cerr << "Unknown format '" << value << "' (png, ppm or raw)" << std::endl;
+                return false;
+            }
+        } else if (arg == "--lensing") {
+            bool found = false;
+            for (int model = 0; model < LENSING_MODEL_COUNT; model++) {
+                if (std::string(value) == lensingModelName(static_cast<LensingModel>(model))) {
+                    options.params.lensingModel = static_cast<LensingModel>(model);
+                    found = true;
+                }
+            }
+            if (!found) {
+                std::cerr << "Unknown lensing model '" << value << "' (marched, table, rk45, kerr or binet)" << std::endl;
+                return false;
+            }
+        } else if (!isNumber) {
+            std::cerr << "Unknown option or invalid number: " << arg << " " << value << std::endl;
+            return false;
+        } else if (arg == "--frames" && isCount && number >= 1) {
+            options.frames = static_cast<int>(number);
+        } else if (arg == "--fps" && number > 0) {
+            options.fps = number;
+        } else if (arg == "--start") {
+            options.startTime = number;
+        } else if (arg == "--azimuth") {
+            options.camera.azimuth = static_cast<float>(number);
+        } else if (arg == "--elevation") {
+            options.camera.elevation = static_cast<float>(number);
+        } else if (arg == "--radius" && number > 0) {
+            options.camera.radius = static_cast<float>(number);
+        } else if (arg == "--orbit") {
+            options.orbitSpeed = number;
+        } else if (arg == "--march-stride" && (number == 1 || number == 2 || number == 4)) {
+            options.marchStride = static_cast<int>(number);
+        } else if (arg == "--mass" && number > 0) {
+            options.params.mass = static_cast<float>(number);
+        } else if (arg == "--spin" && number >= 0 && number <= MAX_SPIN) {
+            options.params.spin = static_cast<float>(number);
+        } else if (arg == "--disk" && number > 0) {
+            options.params.diskOuter = static_cast<float>(number);
+        } else if (arg == "--belt" && isCount && number >= 0) {
+            options.params.bodies = asteroidBelt(static_cast<int>(number));
+        } else {
+            std::cerr << "Unknown option or out of range value: " << arg << " " << value << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+FrameUniforms offlineFrameUniforms(const OfflineOptions& options, const int frame, BodyGrid& bodies) {
+    // Computed from the frame index, never accumulated, so long runs don't drift
+    const double time = options.startTime + frame / options.fps;
+    Camera camera = options.camera;
+    camera.azimuth = static_cast<float>(options.camera.azimuth + options.orbitSpeed * (time - options.startTime));
+    camera.updatePosition();
+    FrameUniforms u =
+        makeFrameUniforms(camera, options.params, static_cast<float>(time), options.width, options.height, 0.0f);
+    bodies.build(options.params.bodies, static_cast<float>(time));
+    bodies.attach(u);
+    return u;
+}
+
+int runOfflineRender(const OfflineOptions& options) {
+    HeadlessContext context;
+    if (!context.create()) {
+        return -1;
+    }
+    if (!loadOpenGLFunctions(HeadlessContext::procLoader())) {
+        std::cerr << "Failed to load OpenGL functions" << std::endl;
+        return -1;
+    }
+
+    const RenderTarget target(options.width, options.height);
+    if (!target.complete()) {
+        std::cerr << "Failed to create a " << options.width << "x" << options.height << " render target" << std::endl;
+        return -1;
+    }
+    target.bind();
+
+    GpuRenderer renderer;
+    if (options.compute && !renderer.computeAvailable()) {
+        std::cerr << "Compute shaders need OpenGL 4.3, " << glGetString(GL_VERSION) << " found" << std::endl;
+        return -1;
+    }
+    if (!options.starCatalog.empty() && !renderer.loadStarCatalog(options.starCatalog)) {
+        return -1;
+    }
+    std::unique_ptr<FrameCapture> capture;
+    if (!options.outputDirectory.empty()) {
+        capture = std::make_unique<FrameCapture>(options.outputDirectory, options.format);
+    }
+
+    std::cout << "Rendering " << options.frames << " frames at " << options.width << "x" << options.height << ", "
+              << options.fps << " fps on " << glGetString(GL_RENDERER) << std::endl;
+
+    BodyGrid bodies;
+
+    // The first frame also builds its shader permutation, so it is timed on its own
+    using Clock = std::chrono::steady_clock;
+    const auto start = Clock::now();
+    Clock::time_point steadyStart = start;
+    for (int frame = 0; frame < options.frames; frame++) {
+        const FrameUniforms uniforms = offlineFrameUniforms(options, frame, bodies);
+        if (options.compute) {
+            renderer.renderCompute(uniforms);
+        } else if (options.temporal) {
+            renderer.renderTemporal(uniforms);
+        } else {
+            renderer.renderReconstructed(uniforms, options.marchStride);
+        }
+        if (capture) {
+            capture->capture(options.width, options.height);
+        }
+        if (frame == 0) {
+            glFinish();
+            steadyStart = Clock::now();
+        }
+    }
+    if (capture) {
+        capture->flush();
+    }
+    glFinish();
+    const auto end = Clock::now();
+
+    const double firstMs = std::chrono::duration<double, std::milli>(steadyStart - start).count();
+    std::cout << std::fixed << std::setprecision(1) << "First frame: " << firstMs << " ms" << std::endl;
+    if (options.frames > 1) {
+        const double ms = std::chrono::duration<double, std::milli>(end - steadyStart).count();
+        const double perFrame = ms / (options.frames - 1);
+        std::cout << "Remaining " << options.frames - 1 << " frames: " << std::setprecision(2) << perFrame
+                  << " ms/frame (" << std::setprecision(1) << 1000.0 / perFrame << " fps)" << std::endl;
+    }
+
+    if (capture) {
+        if (const int errors = capture->finish(); errors > 0) {
+            std::cerr << errors << " frames could not be written" << std::endl;
+            return -1;
+        }
+        std::cout << options.frames << " frames written to " << options.outputDirectory << std::endl;
+    }
+    return 0;
+}
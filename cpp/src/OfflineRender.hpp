@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+
+#include "BodyGrid.hpp"
+#include "FrameCapture.hpp"
+#include "Math.hpp"
+#include "Simulation.hpp"
+
+// Batch rendering with no window: a fixed timestep (frame n is shown at
+// startTime + n / fps), no vsync and no FPS-driven quality changes, so the
+// same options give the same frames on every run and every machine with
+// the same driver.
+struct OfflineOptions {
+    int width = 1280;
+    int height = 720;
+    int frames = 1;
+    double fps = 30.0;
+    double startTime = 0.0;
+    double orbitSpeed = 0.0; // camera azimuth change, radians per second
+    int marchStride = 1;     // GpuRenderer::renderReconstructed stride
+    bool temporal = false;   // GpuRenderer::renderTemporal instead
+    bool compute = false;    // GpuRenderer::renderCompute instead (GL 4.3)
+    Camera camera;
+    SimParams params;
+    std::string starCatalog;     // StarCatalog file; empty: procedural sky
+    std::string outputDirectory; // empty: render only (throughput runs)
+    FrameCapture::Format format = FrameCapture::Format::Png;
+};
+
+void printOfflineUsage(const char* program);
+// Reads a planet list, one planet per line: orbit radius, speed (rad/s),
+// phase (rad), radius, color r g b and optionally bands (0 to 1); '#' starts
+// a comment line. Prints the problem and returns false on bad input.
+bool loadPlanets(const std::string& path, std::vector<Planet>& planets);
+// Parses argv[first, argc); prints the problem and returns false on bad input
+bool parseOfflineOptions(int argc, char* argv[], int first, OfflineOptions& options);
+
+// Uniforms of one frame, a function of the options and frame index only;
+// the small bodies are binned into 'bodies' for the frame time
+FrameUniforms offlineFrameUniforms(const OfflineOptions& options, int frame, BodyGrid& bodies);
+
+// Renders the whole sequence on a headless context; returns the exit code
+int runOfflineRender(const OfflineOptions& options);
@@ -0,0 +1,137 @@
+#include <GLFW/glfw3.h>
+#include "ProgramCache.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string_view>
+#include <vector>
+#include <unistd.h>
+#include "Shader.hpp"
+
+namespace fs = std::filesystem;
+
+static constexpr std::uint32_t CACHE_MAGIC = 0x43504842; // "BHPC"
+
+struct CacheHeader {
+    std::uint32_t magic;
+    std::uint32_t binaryFormat;
+    std::uint32_t length;
+};
+
+// FNV-1a, 64 bit
+static std::uint64_t hashBytes(std::uint64_t h, const std::string_view bytes) {
+    for (const char c : bytes) {
+        h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    }
+    // Separator so ("ab", "c") and ("a", "bc") differ
+    return (h ^ 0xff) * 1099511628211ull;
+}
+
+static fs::path cacheDirectory() {
+    if (const char* dir = std::getenv("BLACKHOLE_SHADER_CACHE")) {
+        return dir;
+    }
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) {
+        return fs::path(xdg) / "blackhole";
+    }
+    if (const char* home = std::getenv("HOME"); home && *home) {
+        return fs::path(home) / ".cache" / "blackhole";
+    }
+    return {};
+}
+
+static bool cacheAvailable() {
+    static const bool available = [] {
+        if (!glGetProgramBinary || !glProgramBinary || !glProgramParameteri || cacheDirectory().empty()) {
+            return false;
+        }
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        return formats > 0;
+    }();
+    return available;
+}
+
+static fs::path cachePath(const std::uint64_t key) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+    return cacheDirectory() / name;
+}
+
+std::uint64_t programCacheKey(const char* vertexSource, const char* fragmentSource, const std::string& defines) {
+    std::uint64_t h = 14695981039346656037ull;
+    for (const GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+        const auto* value = reinterpret_cast<const char*>(glGetString(name));
+        h = hashBytes(h, value ? value : "");
+    }
+    h = hashBytes(h, vertexSource ? vertexSource : "");
+    h = hashBytes(h, fragmentSource);
+    return hashBytes(h, defines);
+}
+
+unsigned int loadCachedProgram(const std::uint64_t key) {
+    if (!cacheAvailable()) {
+        return 0;
+    }
+
+    std::ifstream file(cachePath(key), std::ios::binary);
+    CacheHeader header{};
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != CACHE_MAGIC) {
+        return 0;
+    }
+    std::vector<char> binary(header.length);
+    if (!file.read(binary.data(), static_cast<std::streamsize>(binary.size()))) {
+        return 0;
+    }
+
+    const unsigned int program = glCreateProgram();
+    glProgramBinary(program, header.binaryFormat, binary.data(), static_cast<GLsizei>(binary.size()));
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        // Stale entry (e.g. driver build changed without a version bump)
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+void storeCachedProgram(const std::uint64_t key, const unsigned int program) {
+    if (!cacheAvailable()) {
+        return;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+    std::vector<char> binary(length);
+    GLenum binaryFormat = 0;
+    glGetProgramBinary(program, length, &length, &binaryFormat, binary.data());
+
+    std::error_code error;
+    fs::create_directories(cacheDirectory(), error);
+    if (error) {
+        return;
+    }
+
+    // Write then rename, so concurrent workers never read a partial entry
+    const fs::path path = cachePath(key);
+    fs::path temporary = path;
+    temporary += ".tmp" + std::to_string(getpid());
+    {
+        std::ofstream file(temporary, std::ios::binary);
+        const CacheHeader header{CACHE_MAGIC, binaryFormat, static_cast<std::uint32_t>(length)};
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(binary.data(), length);
+        if (!file) {
+            file.close();
+            fs::remove(temporary, error);
+            return;
+        }
+    }
+    fs::rename(temporary, path, error);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// On-disk cache of linked program binaries (glGetProgramBinary). Entries are
+// keyed by the shader sources, the injected defines and the GL vendor,
+// renderer and version strings, so a driver update or an edited shader just
+// misses and the caller compiles from source again.
+//
+// Lives in $BLACKHOLE_SHADER_CACHE, else $XDG_CACHE_HOME/blackhole, else
+// ~/.cache/blackhole. Setting BLACKHOLE_SHADER_CACHE to an empty string
+// disables it, as does a driver without binary formats.
+
+// Cache key of a program; needs a current context
+std::uint64_t programCacheKey(const char* vertexSource, const char* fragmentSource, const std::string& defines);
+
+// Program linked from the cached binary, or 0 on a miss or a binary the driver rejects
+unsigned int loadCachedProgram(std::uint64_t key);
+
+// Saves a program linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT; failures are ignored
+void storeCachedProgram(std::uint64_t key, unsigned int program);
@@ -0,0 +1,339 @@
+#include "RayPacket.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <iterator>
+#include <vector>
+#include "BodyGrid.hpp"
+#include "CpuShaders.hpp"
+#include "RayPacketKernel.hpp"
+
+namespace {
+
+// One lane at a time; the portable fallback and the reference for the SIMD kernels
+struct ScalarOps {
+    using F = float;
+    using M = bool;
+    static constexpr int LANES = 1;
+
+    static F load(const float *p) { return *p; }
+    static void store(float *p, const F v) { *p = v; }
+    static F set(const float v) { return v; }
+    static F sqrt(const F v) { return std::sqrt(v); }
+    static F abs(const F v) { return std::abs(v); }
+    static F min(const F a, const F b) { return std::min(a, b); }
+    static F max(const F a, const F b) { return std::max(a, b); }
+    static M lt(const F a, const F b) { return a < b; }
+    static M gt(const F a, const F b) { return a > b; }
+    static M mand(const M a, const M b) { return a && b; }
+    static M mor(const M a, const M b) { return a || b; }
+    static M mandnot(const M a, const M b) { return a && !b; }
+    static F select(const M m, const F a, const F b) { return m ? a : b; }
+    static std::uint32_t bits(const M m) { return m ? 1u : 0u; }
+    static M fromBits(const std::uint32_t b) { return b != 0; }
+};
+
+void packetStepScalar(const PacketConstants &c, RayPacket &rays, const std::uint32_t active, PacketEvents &events) {
+    packetStep<ScalarOps>(c, rays, active, events);
+}
+
+} // namespace
+
+#if defined(__x86_64__) || defined(__i386__)
+// RayPacketAVX2.cpp / RayPacketAVX512.cpp, built with their own -m flags
+void packetStepAvx2(const PacketConstants &c, RayPacket &rays, std::uint32_t active, PacketEvents &events);
+void packetStepAvx512(const PacketConstants &c, RayPacket &rays, std::uint32_t active, PacketEvents &events);
+
+static bool cpuSupports(const std::string_view name) {
+    __builtin_cpu_init();
+    if (name == "avx512") return __builtin_cpu_supports("avx512f");
+    if (name == "avx2") return __builtin_cpu_supports("avx2");
+    return true;
+}
+
+static const PacketKernel PACKET_KERNELS[] = {
+    {"avx512", 16, packetStepAvx512},
+    {"avx2", 8, packetStepAvx2},
+    {"scalar", 1, packetStepScalar},
+};
+#else
+static bool cpuSupports(std::string_view) { return true; }
+
+static const PacketKernel PACKET_KERNELS[] = {
+    {"scalar", 1, packetStepScalar},
+};
+#endif
+
+const PacketKernel *findPacketKernel(const std::string_view name) {
+    for (const PacketKernel &kernel : PACKET_KERNELS) {
+        if (name == kernel.name) {
+            return cpuSupports(kernel.name) ? &kernel : nullptr;
+        }
+    }
+    return nullptr;
+}
+
+const PacketKernel &bestPacketKernel() {
+    static const PacketKernel &best = *[] {
+        // Ordered widest first, scalar is always supported
+        for (const PacketKernel &kernel : PACKET_KERNELS) {
+            if (cpuSupports(kernel.name)) return &kernel;
+        }
+        return std::end(PACKET_KERNELS) - 1;
+    }();
+    return best;
+}
+
+PacketConstants makePacketConstants(const FrameUniforms &u) {
+    PacketConstants c{};
+    c.planetCount = u.planetCount;
+    c.planetMaxRadius = u.planetMaxRadius;
+    for (int k = 0; k < u.planetCount; k++) {
+        c.planetPos[k][0] = u.planets[k].position.x;
+        c.planetPos[k][1] = u.planets[k].position.y;
+        c.planetPos[k][2] = u.planets[k].position.z;
+        c.planetRadiusSq[k] = u.planets[k].radius * u.planets[k].radius;
+    }
+
+    c.horizonRadius = u.schwarzschildRadius + cpu::EPSILON;
+    c.mass = u.mass;
+    c.stepSize = u.stepSize;
+    c.farDist = (u.farDist > 0.0f) ? u.farDist : cpu::MAX_DIST;
+    c.farRampStart = u.diskOuterRadius + 2.0f;
+    c.diskInnerRadius = u.diskInnerRadius;
+    c.diskOuterRadius = u.diskOuterRadius;
+    c.lensMaxRadius = u.lensMaxRadius;
+    c.sceneRadius = cpu::sceneRadius(u);
+    c.enablePlanets = u.enablePlanets;
+    c.enableDisk = u.enableDisk;
+    c.enableLensing = u.enableLensing;
+    return c;
+}
+
+namespace {
+
+// Rays of one wavefront, kept compacted: live rays fill the first packets
+// front to back, so the step kernel runs on full packets. 'ray' maps each
+// slot (packet * RAY_PACKET_LANES + lane) back to its index in rayDirs.
+struct Wavefront {
+    std::vector<RayPacket> packets;
+    std::vector<std::uint32_t> active;
+    std::vector<int> ray;
+    std::vector<float> transmittance;
+};
+
+void copyLane(const RayPacket &from, const int a, RayPacket &to, const int b) {
+    to.px[b] = from.px[a];
+    to.py[b] = from.py[a];
+    to.pz[b] = from.pz[a];
+    to.dx[b] = from.dx[a];
+    to.dy[b] = from.dy[a];
+    to.dz[b] = from.dz[a];
+}
+
+// Moves the live slots to the front (in order) and drops the packets left empty
+void compact(Wavefront &w, const int live) {
+    int next = 0;
+    for (std::size_t p = 0; p < w.packets.size(); p++) {
+        for (std::uint32_t mask = w.active[p]; mask; mask &= mask - 1) {
+            const int from = static_cast<int>(p) * RAY_PACKET_LANES + std::countr_zero(mask);
+            if (from != next) {
+                copyLane(w.packets[p], from % RAY_PACKET_LANES, w.packets[next / RAY_PACKET_LANES],
+                         next % RAY_PACKET_LANES);
+                w.ray[next] = w.ray[from];
+                w.transmittance[next] = w.transmittance[from];
+            }
+            next++;
+        }
+    }
+    const std::size_t packets = (live + RAY_PACKET_LANES - 1) / RAY_PACKET_LANES;
+    w.packets.resize(packets);
+    w.active.assign(packets, ~0u >> (32 - RAY_PACKET_LANES));
+    if (live % RAY_PACKET_LANES) {
+        w.active.back() = (1u << (live % RAY_PACKET_LANES)) - 1u;
+    }
+}
+
+} // namespace
+
+void rayMarchWavefront(const FrameUniforms &u, const PacketKernel &kernel, const Vec3 *rayDirs, const int count,
+                       Vec3 *colors) {
+    const PacketConstants c = makePacketConstants(u);
+    if (!c.enableLensing) {
+        for (int l = 0; l < count; l++) {
+            colors[l] = cpu::traceStraight(u, u.cameraPosition, rayDirs[l], c.farDist);
+        }
+        return;
+    }
+
+    // Same pre-pass as rayMarch: rays missing sceneRadius see the sky right
+    // away, the others are queued at their entry point
+    Wavefront w;
+    w.packets.resize((count + RAY_PACKET_LANES - 1) / RAY_PACKET_LANES);
+    w.active.resize(w.packets.size());
+    w.ray.resize(w.packets.size() * RAY_PACKET_LANES);
+    w.transmittance.assign(w.ray.size(), 1.0f);
+    const Vec3 &origin = u.cameraPosition;
+    const float reachSq = c.sceneRadius * c.sceneRadius;
+    int live = 0;
+    for (int l = 0; l < count; l++) {
+        colors[l] = Vec3();
+        const float tca = -origin.dot(rayDirs[l]);
+        const float missDistSq = origin.dot(origin) - tca * tca;
+        float t = 0.0f;
+        if (origin.dot(origin) > reachSq) {
+            if (tca <= 0.0f || missDistSq >= reachSq) {
+                if (u.enableStarfield) {
+                    colors[l] = cpu::starField(u, rayDirs[l], u.time);
+                }
+                continue;
+            }
+            t = tca - std::sqrt(reachSq - missDistSq);
+        }
+        const Vec3 p = origin + rayDirs[l] * t;
+        RayPacket &rays = w.packets[live / RAY_PACKET_LANES];
+        const int lane = live % RAY_PACKET_LANES;
+        rays.px[lane] = p.x;
+        rays.py[lane] = p.y;
+        rays.pz[lane] = p.z;
+        rays.dx[lane] = rayDirs[l].x;
+        rays.dy[lane] = rayDirs[l].y;
+        rays.dz[lane] = rayDirs[l].z;
+        w.active[live / RAY_PACKET_LANES] |= 1u << lane;
+        w.ray[live] = l;
+        live++;
+    }
+    w.packets.resize((live + RAY_PACKET_LANES - 1) / RAY_PACKET_LANES);
+    w.active.resize(w.packets.size());
+
+    const int maxSteps = std::min(u.maxSteps, cpu::MAX_STEPS);
+    std::vector<PacketEvents> events(w.packets.size());
+    // Small bodies are looked up per ray after the kernel, on the segment
+    // from where each ray started the step
+    const BodyGrid *bodies = u.enablePlanets ? u.bodies : nullptr;
+    std::vector<Vec3> stepStart(bodies ? w.ray.size() : 0);
+    // Slots that hit something this step, one queue per shading stage
+    std::vector<int> planetQueue, diskQueue, skyQueue;
+
+    const auto rays = [&](const int slot) -> RayPacket & { return w.packets[slot / RAY_PACKET_LANES]; };
+    const auto queueLanes = [](std::vector<int> &queue, const std::size_t packet, std::uint32_t mask) {
+        for (; mask; mask &= mask - 1) {
+            queue.push_back(static_cast<int>(packet) * RAY_PACKET_LANES + std::countr_zero(mask));
+        }
+    };
+
+    for (int i = 0; i < maxSteps && live > 0; i++) {
+        if (bodies) {
+            for (std::size_t p = 0; p < w.packets.size(); p++) {
+                const RayPacket &r = w.packets[p];
+                for (std::uint32_t mask = w.active[p]; mask; mask &= mask - 1) {
+                    const int l = std::countr_zero(mask);
+                    stepStart[p * RAY_PACKET_LANES + l] = Vec3(r.px[l], r.py[l], r.pz[l]);
+                }
+            }
+        }
+
+        // Lens step: every packet, all of them full but the last
+        for (std::size_t p = 0; p < w.packets.size(); p++) {
+            kernel.step(c, w.packets[p], w.active[p], events[p]);
+        }
+
+        // Small bodies hit before where the kernel stopped each ray (the step
+        // end or a planet) take over the planet event
+        if (bodies) {
+            for (std::size_t p = 0; p < w.packets.size(); p++) {
+                RayPacket &r = w.packets[p];
+                for (std::uint32_t mask = w.active[p] & ~events[p].horizon; mask; mask &= mask - 1) {
+                    const int l = std::countr_zero(mask);
+                    const Vec3 &a = stepStart[p * RAY_PACKET_LANES + l];
+                    const Vec3 b(r.px[l], r.py[l], r.pz[l]);
+                    float t = 2.0f;
+                    int item;
+                    if (!bodies->segment(a, b, t, item)) continue;
+                    const std::uint32_t bit = 1u << l;
+                    // A disk crossing only counts in front of the body
+                    if ((events[p].disk & bit) && a.y / (a.y - b.y) >= t) {
+                        events[p].disk &= ~bit;
+                    }
+                    events[p].planet |= bit;
+                    events[p].escaped &= ~bit;
+                    r.planet[l] = static_cast<float>(MAX_PLANETS + item);
+                    const Vec3 hit = glsl::mix(a, b, t);
+                    r.px[l] = hit.x;
+                    r.py[l] = hit.y;
+                    r.pz[l] = hit.z;
+                }
+            }
+        }
+
+        // Horizon rays are done
+        diskQueue.clear();
+        for (std::size_t p = 0; p < w.packets.size(); p++) {
+            queueLanes(diskQueue, p, events[p].disk);
+            w.active[p] &= ~events[p].horizon;
+        }
+
+        // Disk crossing shading, before any planet on the step; opaque enough ends the ray
+        for (const int slot : diskQueue) {
+            const RayPacket &r = rays(slot);
+            const int l = slot % RAY_PACKET_LANES;
+            float diskAlpha;
+            const Vec3 disk = cpu::getDiskSample(u, Vec3(r.hx[l], r.hy[l], r.hz[l]), diskAlpha);
+            colors[w.ray[slot]] += disk * w.transmittance[slot];
+            w.transmittance[slot] *= (1.0f - diskAlpha);
+            if (w.transmittance[slot] < 0.02f) {
+                w.active[slot / RAY_PACKET_LANES] &= ~(1u << l);
+            }
+        }
+
+        // Planet shading for the rays the disk let through
+        planetQueue.clear();
+        for (std::size_t p = 0; p < w.packets.size(); p++) {
+            queueLanes(planetQueue, p, events[p].planet & w.active[p]);
+            w.active[p] &= ~events[p].planet;
+        }
+        for (const int slot : planetQueue) {
+            const RayPacket &r = rays(slot);
+            const int l = slot % RAY_PACKET_LANES;
+            colors[w.ray[slot]] += cpu::shadePlanet(u, Vec3(r.px[l], r.py[l], r.pz[l]), static_cast<int>(r.planet[l])) *
+                                   w.transmittance[slot];
+        }
+
+        // Sky shading for the rays leaving the scene
+        skyQueue.clear();
+        live = 0;
+        for (std::size_t p = 0; p < w.packets.size(); p++) {
+            const std::uint32_t escaped = events[p].escaped & w.active[p];
+            w.active[p] &= ~escaped;
+            queueLanes(skyQueue, p, escaped);
+            live += std::popcount(w.active[p]);
+        }
+        if (u.enableStarfield) {
+            for (const int slot : skyQueue) {
+                const RayPacket &r = rays(slot);
+                const int l = slot % RAY_PACKET_LANES;
+                colors[w.ray[slot]] +=
+                    cpu::starField(u, Vec3(r.dx[l], r.dy[l], r.dz[l]), u.time) * w.transmittance[slot];
+            }
+        }
+
+        // Refill: compact once a whole packet can be dropped
+        if ((live + RAY_PACKET_LANES - 1) / RAY_PACKET_LANES < static_cast<int>(w.packets.size())) {
+            compact(w, live);
+        }
+    }
+
+    // Rays still active after the loop see the sky
+    if (u.enableStarfield) {
+        for (std::size_t p = 0; p < w.packets.size(); p++) {
+            for (std::uint32_t mask = w.active[p]; mask; mask &= mask - 1) {
+                const int l = std::countr_zero(mask);
+                const RayPacket &r = w.packets[p];
+                const int slot = static_cast<int>(p) * RAY_PACKET_LANES + l;
+                colors[w.ray[slot]] +=
+                    cpu::starField(u, Vec3(r.dx[l], r.dy[l], r.dz[l]), u.time) * w.transmittance[slot];
+            }
+        }
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include "Math.hpp"
+#include "Simulation.hpp"
+
+// Rays marched in lockstep by the CPU renderer. A packet always holds 16
+// lanes; SIMD kernels narrower than that process it in several chunks.
+constexpr int RAY_PACKET_LANES = 16;
+
+// Structure-of-arrays ray state, one float per lane in each array
+struct alignas(64) RayPacket {
+    float px[RAY_PACKET_LANES], py[RAY_PACKET_LANES], pz[RAY_PACKET_LANES];
+    float dx[RAY_PACKET_LANES], dy[RAY_PACKET_LANES], dz[RAY_PACKET_LANES];
+
+    // Disk-plane hit point, valid for lanes in PacketEvents::disk
+    float hx[RAY_PACKET_LANES], hy[RAY_PACKET_LANES], hz[RAY_PACKET_LANES];
+    // Index of the planet that was hit, valid for lanes in PacketEvents::planet
+    // (the lane's position is then the hit point); small bodies from MAX_PLANETS on
+    float planet[RAY_PACKET_LANES];
+};
+
+// The uniforms used by one rayMarch step, hoisted out of the step loop
+struct PacketConstants {
+    float planetPos[MAX_PLANETS][3];
+    float planetRadiusSq[MAX_PLANETS];
+    float planetMaxRadius;
+    int planetCount;
+    float horizonRadius;
+    float mass;
+    float stepSize;
+    float farRampStart;
+    float farDist;
+    float diskInnerRadius;
+    float diskOuterRadius;
+    float lensMaxRadius;
+    float sceneRadius;
+    bool enablePlanets;
+    bool enableDisk;
+    bool enableLensing;
+};
+
+PacketConstants makePacketConstants(const FrameUniforms &u);
+
+// Lane bitmasks reported by one step. Horizon lanes did not move, planet
+// lanes stopped at the hit point. A disk crossing comes before any planet hit
+// on the step, so disk may be set together with planet or escaped.
+struct PacketEvents {
+    std::uint32_t planet;
+    std::uint32_t horizon;
+    std::uint32_t disk;
+    std::uint32_t escaped;
+};
+
+// One iteration of the rayMarch loop for every lane in 'active': event-horizon
+// test, lensing, advance, then planet and disk-plane crossings on the step
+using PacketStepFn = void (*)(const PacketConstants &c, RayPacket &rays, std::uint32_t active,
+                              PacketEvents &events);
+
+struct PacketKernel {
+    const char *name;
+    int simdWidth;
+    PacketStepFn step;
+};
+
+// Widest kernel the running CPU supports, detected once at first use
+const PacketKernel &bestPacketKernel();
+// Kernel by name ("scalar", "avx2", "avx512"), nullptr if unknown or unsupported here
+const PacketKernel *findPacketKernel(std::string_view name);
+
+// rayMarch for any number of rays from the camera, as a wavefront: the rays
+// live in a structure-of-arrays queue of packets, and each iteration runs one
+// stage at a time over the whole queue (the step kernel on every packet, the
+// small body grid per ray, then disk, planet and sky shading on the rays that
+// hit each). Finished rays are compacted out, so the kernel keeps running on
+// full packets while the rays left are the long ones. Events are shaded with
+// the scalar functions from CpuShaders, so results match rayMarch.
+void rayMarchWavefront(const FrameUniforms &u, const PacketKernel &kernel, const Vec3 *rayDirs, int count,
+                       Vec3 *colors);
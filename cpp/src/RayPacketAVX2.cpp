@@ -0,0 +1,49 @@
+// Built with -mavx2 (see CMakeLists.txt); only called after CPU detection
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+#include "RayPacketKernel.hpp"
+
+namespace {
+
+struct Avx2Ops {
+    struct F {
+        __m256 v;
+        F operator+(const F &o) const { return {_mm256_add_ps(v, o.v)}; }
+        F operator-(const F &o) const { return {_mm256_sub_ps(v, o.v)}; }
+        F operator*(const F &o) const { return {_mm256_mul_ps(v, o.v)}; }
+        F operator/(const F &o) const { return {_mm256_div_ps(v, o.v)}; }
+    };
+    // All-ones / all-zeros lanes
+    using M = F;
+    static constexpr int LANES = 8;
+
+    static F load(const float *p) { return {_mm256_load_ps(p)}; }
+    static void store(float *p, const F &a) { _mm256_store_ps(p, a.v); }
+    static F set(const float a) { return {_mm256_set1_ps(a)}; }
+    static F sqrt(const F &a) { return {_mm256_sqrt_ps(a.v)}; }
+    static F abs(const F &a) { return {_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v)}; }
+    static F min(const F &a, const F &b) { return {_mm256_min_ps(a.v, b.v)}; }
+    static F max(const F &a, const F &b) { return {_mm256_max_ps(a.v, b.v)}; }
+    static M lt(const F &a, const F &b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)}; }
+    static M gt(const F &a, const F &b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)}; }
+    static M mand(const M &a, const M &b) { return {_mm256_and_ps(a.v, b.v)}; }
+    static M mor(const M &a, const M &b) { return {_mm256_or_ps(a.v, b.v)}; }
+    static M mandnot(const M &a, const M &b) { return {_mm256_andnot_ps(b.v, a.v)}; }
+    static F select(const M &m, const F &a, const F &b) { return {_mm256_blendv_ps(b.v, a.v, m.v)}; }
+    static std::uint32_t bits(const M &m) { return static_cast<std::uint32_t>(_mm256_movemask_ps(m.v)); }
+
+    static M fromBits(const std::uint32_t b) {
+        const __m256i lane = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+        const __m256i set = _mm256_and_si256(_mm256_set1_epi32(static_cast<int>(b)), lane);
+        return {_mm256_castsi256_ps(_mm256_cmpeq_epi32(set, lane))};
+    }
+};
+
+} // namespace
+
+void packetStepAvx2(const PacketConstants &c, RayPacket &rays, const std::uint32_t active, PacketEvents &events) {
+    packetStep<Avx2Ops>(c, rays, active, events);
+}
+
+#endif
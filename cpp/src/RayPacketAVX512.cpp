@@ -0,0 +1,44 @@
+// Built with -mavx512f (see CMakeLists.txt); only called after CPU detection
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+#include "RayPacketKernel.hpp"
+
+namespace {
+
+struct Avx512Ops {
+    struct F {
+        __m512 v;
+        F operator+(const F &o) const { return {_mm512_add_ps(v, o.v)}; }
+        F operator-(const F &o) const { return {_mm512_sub_ps(v, o.v)}; }
+        F operator*(const F &o) const { return {_mm512_mul_ps(v, o.v)}; }
+        F operator/(const F &o) const { return {_mm512_div_ps(v, o.v)}; }
+    };
+    // One bit per lane
+    using M = __mmask16;
+    static constexpr int LANES = 16;
+
+    static F load(const float *p) { return {_mm512_load_ps(p)}; }
+    static void store(float *p, const F &a) { _mm512_store_ps(p, a.v); }
+    static F set(const float a) { return {_mm512_set1_ps(a)}; }
+    static F sqrt(const F &a) { return {_mm512_sqrt_ps(a.v)}; }
+    static F abs(const F &a) { return {_mm512_abs_ps(a.v)}; }
+    static F min(const F &a, const F &b) { return {_mm512_min_ps(a.v, b.v)}; }
+    static F max(const F &a, const F &b) { return {_mm512_max_ps(a.v, b.v)}; }
+    static M lt(const F &a, const F &b) { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ); }
+    static M gt(const F &a, const F &b) { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ); }
+    static M mand(const M a, const M b) { return static_cast<M>(a & b); }
+    static M mor(const M a, const M b) { return static_cast<M>(a | b); }
+    static M mandnot(const M a, const M b) { return static_cast<M>(a & ~b); }
+    static F select(const M m, const F &a, const F &b) { return {_mm512_mask_blend_ps(m, b.v, a.v)}; }
+    static std::uint32_t bits(const M m) { return m; }
+    static M fromBits(const std::uint32_t b) { return static_cast<M>(b); }
+};
+
+} // namespace
+
+void packetStepAvx512(const PacketConstants &c, RayPacket &rays, const std::uint32_t active, PacketEvents &events) {
+    packetStep<Avx512Ops>(c, rays, active, events);
+}
+
+#endif
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "RayPacket.hpp"
+
+// Generic body of the packet step, instantiated once per instruction set by
+// RayPacket.cpp (scalar), RayPacketAVX2.cpp and RayPacketAVX512.cpp.
+//
+// S provides the lane type F (with + - * /), the mask type M and:
+//   LANES, load, store, set, sqrt, abs, min, max, lt, gt, mand, mor, mandnot,
+//   select(m, a, b) = m ? a : b, bits(m), fromBits(bits)
+//
+// Each instruction-set file is compiled with its own -m flags, so everything
+// here lives in an anonymous namespace and calls no library code: an inline
+// function emitted with AVX-512 instructions must never be picked by the
+// linker for the baseline build.
+namespace {
+
+template <class S>
+typename S::F packetSmoothstep(const float edge0, const float edge1, const typename S::F &x) {
+    using F = typename S::F;
+    const F t = S::min(S::max((x - S::set(edge0)) / S::set(edge1 - edge0), S::set(0.0f)), S::set(1.0f));
+    return t * t * (S::set(3.0f) - S::set(2.0f) * t);
+}
+
+template <class S>
+void packetStep(const PacketConstants &c, RayPacket &rays, const std::uint32_t active, PacketEvents &events) {
+    using F = typename S::F;
+    using M = typename S::M;
+    constexpr std::uint32_t laneMask = (S::LANES >= 32) ? ~0u : ((1u << S::LANES) - 1u);
+
+    events = PacketEvents{0, 0, 0, 0};
+    const F zero = S::set(0.0f);
+
+    for (int base = 0; base < RAY_PACKET_LANES; base += S::LANES) {
+        const std::uint32_t liveBits = (active >> base) & laneMask;
+        if (liveBits == 0) continue;
+        const M live = S::fromBits(liveBits);
+
+        const F px = S::load(rays.px + base);
+        const F py = S::load(rays.py + base);
+        const F pz = S::load(rays.pz + base);
+        F dx = S::load(rays.dx + base);
+        F dy = S::load(rays.dy + base);
+        F dz = S::load(rays.dz + base);
+
+        const F r2 = px * px + py * py + pz * pz;
+        const F r = S::sqrt(r2);
+
+        // Event horizon check
+        M horizon = S::fromBits(0);
+        if (c.enableLensing) {
+            horizon = S::mand(S::lt(r, S::set(c.horizonRadius)), live);
+        }
+        const M moving = S::mandnot(live, horizon);
+
+        // Apply gravitational lensing
+        const F distToCenterSq = S::max(r2, S::set(1e-4f));
+        F stepSize = S::set(c.stepSize);
+        stepSize = stepSize + stepSize * packetSmoothstep<S>(c.farRampStart, c.farDist, r) * S::set(2.5f);
+        stepSize = stepSize * (S::set(1.0f) + S::set(1.2f) * packetSmoothstep<S>(0.5f, 3.0f, S::abs(py)));
+
+        if (c.enableLensing) {
+            const M lens = S::lt(r, S::set(c.lensMaxRadius));
+            // gravityDir * (G * mass) / r^2 * stepSize with gravityDir = -p / r
+            const F invR = S::select(S::gt(r, S::set(1e-6f)), S::set(1.0f) / r, zero);
+            const F k = S::set(c.mass) / distToCenterSq * stepSize * invR;
+            const F bx = dx - px * k;
+            const F by = dy - py * k;
+            const F bz = dz - pz * k;
+            const F invLen = S::set(1.0f) / S::sqrt(bx * bx + by * by + bz * bz);
+            dx = S::select(lens, bx * invLen, dx);
+            dy = S::select(lens, by * invLen, dy);
+            dz = S::select(lens, bz * invLen, dz);
+        }
+        const F nx = px + dx * stepSize;
+        const F ny = py + dy * stepSize;
+        const F nz = pz + dz * stepSize;
+
+        // Planets hit anywhere on the step (segmentPlanets)
+        M planet = S::fromBits(0);
+        F tPlanet = S::set(2.0f);
+        // All planets sit in the disk plane: steps wholly above or below the
+        // largest radius skip the loop
+        const F slab = S::set(c.planetMaxRadius);
+        const M nearPlane = S::mandnot(S::mandnot(moving, S::mand(S::gt(py, slab), S::gt(ny, slab))),
+                                       S::mand(S::lt(py, zero - slab), S::lt(ny, zero - slab)));
+        if (c.enablePlanets && S::bits(nearPlane) != 0) {
+            const F one = S::set(1.0f);
+            const F sx = nx - px;
+            const F sy = ny - py;
+            const F sz = nz - pz;
+            const F a = sx * sx + sy * sy + sz * sz;
+            F index = S::set(-1.0f);
+            for (int k = 0; k < c.planetCount; k++) {
+                const F mx = px - S::set(c.planetPos[k][0]);
+                const F my = py - S::set(c.planetPos[k][1]);
+                const F mz = pz - S::set(c.planetPos[k][2]);
+                const F cc = mx * mx + my * my + mz * mz - S::set(c.planetRadiusSq[k]);
+                const F b = mx * sx + my * sy + mz * sz;
+                const F disc = b * b - a * cc;
+                // Entry parameter, 0 when the step starts inside
+                const M inside = S::lt(cc, zero);
+                const F t = S::select(inside, zero, (zero - b - S::sqrt(S::max(disc, zero))) / a);
+                const M enters = S::mandnot(S::mandnot(S::mandnot(nearPlane, S::lt(disc, zero)), S::gt(b, zero)),
+                                            S::gt(t, one));
+                const M closer = S::mand(S::mor(S::mand(inside, nearPlane), enters), S::lt(t, tPlanet));
+                tPlanet = S::select(closer, t, tPlanet);
+                index = S::select(closer, S::set(static_cast<float>(k)), index);
+                planet = S::mor(planet, closer);
+            }
+            S::store(rays.planet + base, index);
+        }
+
+        // Disk intersection before the planet
+        M disk = S::fromBits(0);
+        if (c.enableDisk) {
+            const M crossing = S::mand(moving, S::lt(py * ny, zero));
+            if (S::bits(crossing) != 0) {
+                const F t = (zero - py) / (ny - py);
+                const F hx = px + (nx - px) * t;
+                const F hy = py + (ny - py) * t;
+                const F hz = pz + (nz - pz) * t;
+                const F rHit = S::sqrt(hx * hx + hz * hz);
+                disk = S::mand(S::mand(crossing, S::lt(t, tPlanet)),
+                               S::mand(S::gt(rHit, S::set(c.diskInnerRadius)), S::lt(rHit, S::set(c.diskOuterRadius))));
+                S::store(rays.hx + base, hx);
+                S::store(rays.hy + base, hy);
+                S::store(rays.hz + base, hz);
+            }
+        }
+
+        // Past farDist, or heading out past sceneRadius where nothing bends it back
+        const F rNext = S::sqrt(nx * nx + ny * ny + nz * nz);
+        const M leaving = S::mand(S::gt(rNext, S::set(c.sceneRadius)), S::gt(nx * dx + ny * dy + nz * dz, zero));
+        const M escaped = S::mandnot(S::mand(moving, S::mor(S::gt(rNext, S::set(c.farDist)), leaving)), planet);
+
+        // Planet lanes stop at the hit point
+        S::store(rays.px + base, S::select(moving, S::select(planet, px + (nx - px) * tPlanet, nx), px));
+        S::store(rays.py + base, S::select(moving, S::select(planet, py + (ny - py) * tPlanet, ny), py));
+        S::store(rays.pz + base, S::select(moving, S::select(planet, pz + (nz - pz) * tPlanet, nz), pz));
+        S::store(rays.dx + base, dx);
+        S::store(rays.dy + base, dy);
+        S::store(rays.dz + base, dz);
+
+        events.planet |= S::bits(planet) << base;
+        events.horizon |= S::bits(horizon) << base;
+        events.disk |= S::bits(disk) << base;
+        events.escaped |= S::bits(escaped) << base;
+    }
+}
+
+} // namespace
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "Image.hpp"
+
+// Color texture + framebuffer object of a fixed size, read back as RGBA8,
+// with a depth/stencil renderbuffer like a window's default framebuffer.
+// An optional second attachment (location 1) holds per-pixel side data.
+class RenderTarget {
+public:
+    unsigned int framebuffer = 0;
+    unsigned int texture = 0;
+    unsigned int auxTexture = 0;
+    unsigned int depthStencil = 0;
+    int width;
+    int height;
+
+    // auxFormat: internal format of the second attachment, 0 for none
+    RenderTarget(int width, int height, unsigned int auxFormat = 0);
+    ~RenderTarget();
+    RenderTarget(const RenderTarget&) = delete;
+    RenderTarget& operator=(const RenderTarget&) = delete;
+
+    [[nodiscard]] bool complete() const;
+    void bind() const;
+    // glReadPixels of the whole target (waits for rendering to finish)
+    void read(Image& image) const;
+};
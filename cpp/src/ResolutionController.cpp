@@ -0,0 +1,24 @@
+#include "ResolutionController.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+float ResolutionController::update(const double gpuMs) {
+    if (gpuMs <= 0.0) {
+        return currentScale;
+    }
+
+    double error = 0.5 * std::log(settings.targetMs / gpuMs);
+    if (std::abs(gpuMs - settings.targetMs) < settings.deadband * settings.targetMs) {
+        error = 0.0;
+    }
+
+    const double delta = settings.kp * (error - previousError) + settings.ki * error +
+                         settings.kd * (error - 2.0 * previousError + previousError2);
+    previousError2 = previousError;
+    previousError = error;
+
+    const double logScale = std::log(static_cast<double>(currentScale)) + delta;
+    currentScale = std::clamp(static_cast<float>(std::exp(logScale)), settings.minScale, settings.maxScale);
+    return currentScale;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+
+// Picks the ray march resolution scale that keeps GPU frame time at a target.
+// Cost is proportional to the pixel count, i.e. scale^2, so the controller
+// works on log(scale) with error e = 0.5 * log(target / measured): the log
+// scale change that would hit the target exactly. A PID in velocity form
+// (increments, output clamped to [minScale, maxScale]) needs no separate
+// anti-windup; the gains are low enough to stay stable with the frames of
+// delay between a change and its timer query result.
+class ResolutionController {
+public:
+    struct Settings {
+        double targetMs = 15.0;
+        float minScale = 0.35f;
+        float maxScale = 1.0f;
+        double kp = 0.15;
+        double ki = 0.25;
+        double kd = 0.05;
+        // Errors under this fraction of the target are ignored (no jitter at steady state)
+        double deadband = 0.05;
+    };
+
+    explicit ResolutionController(const Settings& settings) : settings(settings) {}
+
+    // Feed each new GPU time measurement once; returns the scale for the next frame
+    float update(double gpuMs);
+    [[nodiscard]] float scale() const { return currentScale; }
+    [[nodiscard]] double targetMs() const { return settings.targetMs; }
+
+private:
+    Settings settings;
+    float currentScale = 1.0f;
+    double previousError = 0.0;
+    double previousError2 = 0.0;
+};
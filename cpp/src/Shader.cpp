@@ -1,5 +1,7 @@
 #include "Shader.hpp"
+#include "ProgramCache.hpp"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <GLFW/glfw3.h>
@@ -18,6 +20,7 @@ PFNGLDELETESHADERPROC glDeleteShader = nullptr;
 PFNGLDELETEPROGRAMPROC glDeleteProgram = nullptr;
 PFNGLUSEPROGRAMPROC glUseProgram = nullptr;
 PFNGLGETUNIFORMLOCATIONPROC glGetUniformLocation = nullptr;
+PFNGLGETACTIVEUNIFORMPROC glGetActiveUniform = nullptr;
 PFNGLUNIFORM1IPROC glUniform1i = nullptr;
 PFNGLUNIFORM1FPROC glUniform1f = nullptr;
 PFNGLUNIFORM2FPROC glUniform2f = nullptr;
@@ -32,61 +35,179 @@ PFNGLVERTEXATTRIBPOINTERPROC glVertexAttribPointer = nullptr;
 PFNGLENABLEVERTEXATTRIBARRAYPROC glEnableVertexAttribArray = nullptr;
 PFNGLDELETEVERTEXARRAYSPROC glDeleteVertexArrays = nullptr;
 PFNGLDELETEBUFFERSPROC glDeleteBuffers = nullptr;
+PFNGLBUFFERSUBDATAPROC glBufferSubData = nullptr;
+PFNGLBINDBUFFERBASEPROC glBindBufferBase = nullptr;
+PFNGLGETUNIFORMBLOCKINDEXPROC glGetUniformBlockIndex = nullptr;
+PFNGLUNIFORMBLOCKBINDINGPROC glUniformBlockBinding = nullptr;
+PFNGLGENQUERIESPROC glGenQueries = nullptr;
+PFNGLDELETEQUERIESPROC glDeleteQueries = nullptr;
+PFNGLBEGINQUERYPROC glBeginQuery = nullptr;
+PFNGLENDQUERYPROC glEndQuery = nullptr;
+PFNGLGETQUERYOBJECTIVPROC glGetQueryObjectiv = nullptr;
+PFNGLGETQUERYOBJECTUI64VPROC glGetQueryObjectui64v = nullptr;
+PFNGLGETPROGRAMBINARYPROC glGetProgramBinary = nullptr;
+PFNGLPROGRAMBINARYPROC glProgramBinary = nullptr;
+PFNGLPROGRAMPARAMETERIPROC glProgramParameteri = nullptr;
+PFNGLGENFRAMEBUFFERSPROC glGenFramebuffers = nullptr;
+PFNGLBINDFRAMEBUFFERPROC glBindFramebuffer = nullptr;
+PFNGLFRAMEBUFFERTEXTURE2DPROC glFramebufferTexture2D = nullptr;
+PFNGLCHECKFRAMEBUFFERSTATUSPROC glCheckFramebufferStatus = nullptr;
+PFNGLDELETEFRAMEBUFFERSPROC glDeleteFramebuffers = nullptr;
+PFNGLMAPBUFFERRANGEPROC glMapBufferRange = nullptr;
+PFNGLUNMAPBUFFERPROC glUnmapBuffer = nullptr;
+PFNGLDRAWBUFFERSPROC glDrawBuffers = nullptr;
+PFNGLGENRENDERBUFFERSPROC glGenRenderbuffers = nullptr;
+PFNGLBINDRENDERBUFFERPROC glBindRenderbuffer = nullptr;
+PFNGLRENDERBUFFERSTORAGEPROC glRenderbufferStorage = nullptr;
+PFNGLFRAMEBUFFERRENDERBUFFERPROC glFramebufferRenderbuffer = nullptr;
+PFNGLDELETERENDERBUFFERSPROC glDeleteRenderbuffers = nullptr;
+PFNGLGENERATEMIPMAPPROC glGenerateMipmap = nullptr;
+PFNGLBLENDEQUATIONSEPARATEPROC glBlendEquationSeparate = nullptr;
+PFNGLDISPATCHCOMPUTEPROC glDispatchCompute = nullptr;
+PFNGLDISPATCHCOMPUTEINDIRECTPROC glDispatchComputeIndirect = nullptr;
+PFNGLBINDIMAGETEXTUREPROC glBindImageTexture = nullptr;
+PFNGLMEMORYBARRIERPROC glMemoryBarrier = nullptr;
+PFNGLGETINTEGERI_VPROC glGetIntegeri_v = nullptr;
 
-bool loadOpenGLFunctions() {
-    glCreateShader = reinterpret_cast<PFNGLCREATESHADERPROC>(glfwGetProcAddress("glCreateShader"));
-    glShaderSource = reinterpret_cast<PFNGLSHADERSOURCEPROC>(glfwGetProcAddress("glShaderSource"));
-    glCompileShader = reinterpret_cast<PFNGLCOMPILESHADERPROC>(glfwGetProcAddress("glCompileShader"));
-    glGetShaderiv = reinterpret_cast<PFNGLGETSHADERIVPROC>(glfwGetProcAddress("glGetShaderiv"));
-    glGetShaderInfoLog = reinterpret_cast<PFNGLGETSHADERINFOLOGPROC>(glfwGetProcAddress("glGetShaderInfoLog"));
-    glCreateProgram = reinterpret_cast<PFNGLCREATEPROGRAMPROC>(glfwGetProcAddress("glCreateProgram"));
-    glAttachShader = reinterpret_cast<PFNGLATTACHSHADERPROC>(glfwGetProcAddress("glAttachShader"));
-    glLinkProgram = reinterpret_cast<PFNGLLINKPROGRAMPROC>(glfwGetProcAddress("glLinkProgram"));
-    glGetProgramiv = reinterpret_cast<PFNGLGETPROGRAMIVPROC>(glfwGetProcAddress("glGetProgramiv"));
-    glGetProgramInfoLog = reinterpret_cast<PFNGLGETPROGRAMINFOLOGPROC>(glfwGetProcAddress("glGetProgramInfoLog"));
-    glDeleteShader = reinterpret_cast<PFNGLDELETESHADERPROC>(glfwGetProcAddress("glDeleteShader"));
-    glDeleteProgram = reinterpret_cast<PFNGLDELETEPROGRAMPROC>(glfwGetProcAddress("glDeleteProgram"));
-    glUseProgram = reinterpret_cast<PFNGLUSEPROGRAMPROC>(glfwGetProcAddress("glUseProgram"));
-    glGetUniformLocation = reinterpret_cast<PFNGLGETUNIFORMLOCATIONPROC>(glfwGetProcAddress("glGetUniformLocation"));
-    glUniform1i = reinterpret_cast<PFNGLUNIFORM1IPROC>(glfwGetProcAddress("glUniform1i"));
-    glUniform1f = reinterpret_cast<PFNGLUNIFORM1FPROC>(glfwGetProcAddress("glUniform1f"));
-    glUniform2f = reinterpret_cast<PFNGLUNIFORM2FPROC>(glfwGetProcAddress("glUniform2f"));
-    glUniform3f = reinterpret_cast<PFNGLUNIFORM3FPROC>(glfwGetProcAddress("glUniform3f"));
-    glUniformMatrix4fv = reinterpret_cast<PFNGLUNIFORMMATRIX4FVPROC>(glfwGetProcAddress("glUniformMatrix4fv"));
-    glGenVertexArrays = reinterpret_cast<PFNGLGENVERTEXARRAYSPROC>(glfwGetProcAddress("glGenVertexArrays"));
-    glGenBuffers = reinterpret_cast<PFNGLGENBUFFERSPROC>(glfwGetProcAddress("glGenBuffers"));
-    glBindVertexArray = reinterpret_cast<PFNGLBINDVERTEXARRAYPROC>(glfwGetProcAddress("glBindVertexArray"));
-    glBindBuffer = reinterpret_cast<PFNGLBINDBUFFERPROC>(glfwGetProcAddress("glBindBuffer"));
-    glBufferData = reinterpret_cast<PFNGLBUFFERDATAPROC>(glfwGetProcAddress("glBufferData"));
-    glVertexAttribPointer = reinterpret_cast<PFNGLVERTEXATTRIBPOINTERPROC>(glfwGetProcAddress("glVertexAttribPointer"));
-    glEnableVertexAttribArray = reinterpret_cast<PFNGLENABLEVERTEXATTRIBARRAYPROC>(glfwGetProcAddress("glEnableVertexAttribArray"));
-    glDeleteVertexArrays = reinterpret_cast<PFNGLDELETEVERTEXARRAYSPROC>(glfwGetProcAddress("glDeleteVertexArrays"));
-    glDeleteBuffers = reinterpret_cast<PFNGLDELETEBUFFERSPROC>(glfwGetProcAddress("glDeleteBuffers"));
+bool loadOpenGLFunctions(const GLProcLoader loader) {
+    glCreateShader = reinterpret_cast<PFNGLCREATESHADERPROC>(loader("glCreateShader"));
+    glShaderSource = reinterpret_cast<PFNGLSHADERSOURCEPROC>(loader("glShaderSource"));
+    glCompileShader = reinterpret_cast<PFNGLCOMPILESHADERPROC>(loader("glCompileShader"));
+    glGetShaderiv = reinterpret_cast<PFNGLGETSHADERIVPROC>(loader("glGetShaderiv"));
+    glGetShaderInfoLog = reinterpret_cast<PFNGLGETSHADERINFOLOGPROC>(loader("glGetShaderInfoLog"));
+    glCreateProgram = reinterpret_cast<PFNGLCREATEPROGRAMPROC>(loader("glCreateProgram"));
+    glAttachShader = reinterpret_cast<PFNGLATTACHSHADERPROC>(loader("glAttachShader"));
+    glLinkProgram = reinterpret_cast<PFNGLLINKPROGRAMPROC>(loader("glLinkProgram"));
+    glGetProgramiv = reinterpret_cast<PFNGLGETPROGRAMIVPROC>(loader("glGetProgramiv"));
+    glGetProgramInfoLog = reinterpret_cast<PFNGLGETPROGRAMINFOLOGPROC>(loader("glGetProgramInfoLog"));
+    glDeleteShader = reinterpret_cast<PFNGLDELETESHADERPROC>(loader("glDeleteShader"));
+    glDeleteProgram = reinterpret_cast<PFNGLDELETEPROGRAMPROC>(loader("glDeleteProgram"));
+    glUseProgram = reinterpret_cast<PFNGLUSEPROGRAMPROC>(loader("glUseProgram"));
+    glGetUniformLocation = reinterpret_cast<PFNGLGETUNIFORMLOCATIONPROC>(loader("glGetUniformLocation"));
+    glGetActiveUniform = reinterpret_cast<PFNGLGETACTIVEUNIFORMPROC>(loader("glGetActiveUniform"));
+    glUniform1i = reinterpret_cast<PFNGLUNIFORM1IPROC>(loader("glUniform1i"));
+    glUniform1f = reinterpret_cast<PFNGLUNIFORM1FPROC>(loader("glUniform1f"));
+    glUniform2f = reinterpret_cast<PFNGLUNIFORM2FPROC>(loader("glUniform2f"));
+    glUniform3f = reinterpret_cast<PFNGLUNIFORM3FPROC>(loader("glUniform3f"));
+    glUniformMatrix4fv = reinterpret_cast<PFNGLUNIFORMMATRIX4FVPROC>(loader("glUniformMatrix4fv"));
+    glGenVertexArrays = reinterpret_cast<PFNGLGENVERTEXARRAYSPROC>(loader("glGenVertexArrays"));
+    glGenBuffers = reinterpret_cast<PFNGLGENBUFFERSPROC>(loader("glGenBuffers"));
+    glBindVertexArray = reinterpret_cast<PFNGLBINDVERTEXARRAYPROC>(loader("glBindVertexArray"));
+    glBindBuffer = reinterpret_cast<PFNGLBINDBUFFERPROC>(loader("glBindBuffer"));
+    glBufferData = reinterpret_cast<PFNGLBUFFERDATAPROC>(loader("glBufferData"));
+    glVertexAttribPointer = reinterpret_cast<PFNGLVERTEXATTRIBPOINTERPROC>(loader("glVertexAttribPointer"));
+    glEnableVertexAttribArray = reinterpret_cast<PFNGLENABLEVERTEXATTRIBARRAYPROC>(loader("glEnableVertexAttribArray"));
+    glDeleteVertexArrays = reinterpret_cast<PFNGLDELETEVERTEXARRAYSPROC>(loader("glDeleteVertexArrays"));
+    glDeleteBuffers = reinterpret_cast<PFNGLDELETEBUFFERSPROC>(loader("glDeleteBuffers"));
+    glBufferSubData = reinterpret_cast<PFNGLBUFFERSUBDATAPROC>(loader("glBufferSubData"));
+    glBindBufferBase = reinterpret_cast<PFNGLBINDBUFFERBASEPROC>(loader("glBindBufferBase"));
+    glGetUniformBlockIndex = reinterpret_cast<PFNGLGETUNIFORMBLOCKINDEXPROC>(loader("glGetUniformBlockIndex"));
+    glUniformBlockBinding = reinterpret_cast<PFNGLUNIFORMBLOCKBINDINGPROC>(loader("glUniformBlockBinding"));
+    glGenQueries = reinterpret_cast<PFNGLGENQUERIESPROC>(loader("glGenQueries"));
+    glDeleteQueries = reinterpret_cast<PFNGLDELETEQUERIESPROC>(loader("glDeleteQueries"));
+    glBeginQuery = reinterpret_cast<PFNGLBEGINQUERYPROC>(loader("glBeginQuery"));
+    glEndQuery = reinterpret_cast<PFNGLENDQUERYPROC>(loader("glEndQuery"));
+    glGetQueryObjectiv = reinterpret_cast<PFNGLGETQUERYOBJECTIVPROC>(loader("glGetQueryObjectiv"));
+    glGetQueryObjectui64v = reinterpret_cast<PFNGLGETQUERYOBJECTUI64VPROC>(loader("glGetQueryObjectui64v"));
+    glGetProgramBinary = reinterpret_cast<PFNGLGETPROGRAMBINARYPROC>(loader("glGetProgramBinary"));
+    glProgramBinary = reinterpret_cast<PFNGLPROGRAMBINARYPROC>(loader("glProgramBinary"));
+    glProgramParameteri = reinterpret_cast<PFNGLPROGRAMPARAMETERIPROC>(loader("glProgramParameteri"));
+    glGenFramebuffers = reinterpret_cast<PFNGLGENFRAMEBUFFERSPROC>(loader("glGenFramebuffers"));
+    glBindFramebuffer = reinterpret_cast<PFNGLBINDFRAMEBUFFERPROC>(loader("glBindFramebuffer"));
+    glFramebufferTexture2D = reinterpret_cast<PFNGLFRAMEBUFFERTEXTURE2DPROC>(loader("glFramebufferTexture2D"));
+    glCheckFramebufferStatus = reinterpret_cast<PFNGLCHECKFRAMEBUFFERSTATUSPROC>(loader("glCheckFramebufferStatus"));
+    glDeleteFramebuffers = reinterpret_cast<PFNGLDELETEFRAMEBUFFERSPROC>(loader("glDeleteFramebuffers"));
+    glMapBufferRange = reinterpret_cast<PFNGLMAPBUFFERRANGEPROC>(loader("glMapBufferRange"));
+    glUnmapBuffer = reinterpret_cast<PFNGLUNMAPBUFFERPROC>(loader("glUnmapBuffer"));
+    glDrawBuffers = reinterpret_cast<PFNGLDRAWBUFFERSPROC>(loader("glDrawBuffers"));
+    glGenRenderbuffers = reinterpret_cast<PFNGLGENRENDERBUFFERSPROC>(loader("glGenRenderbuffers"));
+    glBindRenderbuffer = reinterpret_cast<PFNGLBINDRENDERBUFFERPROC>(loader("glBindRenderbuffer"));
+    glRenderbufferStorage = reinterpret_cast<PFNGLRENDERBUFFERSTORAGEPROC>(loader("glRenderbufferStorage"));
+    glFramebufferRenderbuffer = reinterpret_cast<PFNGLFRAMEBUFFERRENDERBUFFERPROC>(loader("glFramebufferRenderbuffer"));
+    glDeleteRenderbuffers = reinterpret_cast<PFNGLDELETERENDERBUFFERSPROC>(loader("glDeleteRenderbuffers"));
+    glGenerateMipmap = reinterpret_cast<PFNGLGENERATEMIPMAPPROC>(loader("glGenerateMipmap"));
+    glBlendEquationSeparate = reinterpret_cast<PFNGLBLENDEQUATIONSEPARATEPROC>(loader("glBlendEquationSeparate"));
+    glDispatchCompute = reinterpret_cast<PFNGLDISPATCHCOMPUTEPROC>(loader("glDispatchCompute"));
+    glDispatchComputeIndirect = reinterpret_cast<PFNGLDISPATCHCOMPUTEINDIRECTPROC>(loader("glDispatchComputeIndirect"));
+    glBindImageTexture = reinterpret_cast<PFNGLBINDIMAGETEXTUREPROC>(loader("glBindImageTexture"));
+    glMemoryBarrier = reinterpret_cast<PFNGLMEMORYBARRIERPROC>(loader("glMemoryBarrier"));
+    glGetIntegeri_v = reinterpret_cast<PFNGLGETINTEGERI_VPROC>(loader("glGetIntegeri_v"));
 
     return glCreateShader && glShaderSource && glCompileShader && glCreateProgram;
 }
 
+bool loadOpenGLFunctions() {
+    return loadOpenGLFunctions(glfwGetProcAddress);
+}
+
+
+// Compiles one stage, with 'defines' spliced in after the #version line
+// (replaced by 4.30 for compute shaders)
+static unsigned int compileStage(const GLenum type, const char* source, const std::string& defines) {
+    static constexpr char COMPUTE_VERSION[] = "#version 430 core\n";
+    const std::string_view text(source);
+    const size_t version = text.find("#version");
+    const size_t versionEnd = (version == std::string_view::npos) ? 0 : text.find('\n', version) + 1;
+    const bool compute = type == GL_COMPUTE_SHADER;
+    const char* parts[3] = {compute ? COMPUTE_VERSION : source, defines.c_str(), source + versionEnd};
+    const int lengths[3] = {compute ? static_cast<int>(sizeof(COMPUTE_VERSION) - 1) : static_cast<int>(versionEnd),
+                            static_cast<int>(defines.size()), -1};
+
+    const unsigned int shader = glCreateShader(type);
+    glShaderSource(shader, 3, parts, lengths);
+    glCompileShader(shader);
+    return shader;
+}
+
+Shader::Shader(const char* vertexPath, const char* fragmentPath, const std::string& defines) {
+    const std::uint64_t cacheKey = programCacheKey(vertexPath, fragmentPath, defines);
+    ID = loadCachedProgram(cacheKey);
+    if (ID == 0 && !vertexPath) {
+        const unsigned int compute = compileStage(GL_COMPUTE_SHADER, fragmentPath, defines);
+        checkCompileErrors(compute, "COMPUTE");
+
+        ID = glCreateProgram();
+        if (glProgramParameteri) {
+            glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        glAttachShader(ID, compute);
+        glLinkProgram(ID);
+        checkCompileErrors(ID, "PROGRAM");
+        glDeleteShader(compute);
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath) {
-    // fromSource is ignored, just for API clarity
-    const unsigned int vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &vertexPath, nullptr);
-    glCompileShader(vertex);
-    checkCompileErrors(vertex, "VERTEX");
+        int linked = 0;
+        glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+        if (linked) {
+            storeCachedProgram(cacheKey, ID);
+        }
+    } else if (ID == 0) {
+        // fromSource is ignored, just for API clarity
+        const unsigned int vertex = compileStage(GL_VERTEX_SHADER, vertexPath, defines);
+        checkCompileErrors(vertex, "VERTEX");
 
-    const unsigned int fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fragmentPath, nullptr);
-    glCompileShader(fragment);
-    checkCompileErrors(fragment, "FRAGMENT");
+        const unsigned int fragment = compileStage(GL_FRAGMENT_SHADER, fragmentPath, defines);
+        checkCompileErrors(fragment, "FRAGMENT");
 
-    ID = glCreateProgram();
-    glAttachShader(ID, vertex);
-    glAttachShader(ID, fragment);
-    glLinkProgram(ID);
-    checkCompileErrors(ID, "PROGRAM");
+        ID = glCreateProgram();
+        if (glProgramParameteri) {
+            glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        glAttachShader(ID, vertex);
+        glAttachShader(ID, fragment);
+        glLinkProgram(ID);
+        checkCompileErrors(ID, "PROGRAM");
 
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+
+        int linked = 0;
+        glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+        if (linked) {
+            storeCachedProgram(cacheKey, ID);
+        }
+    }
+
+    cacheUniformLocations();
 }
 
 Shader::~Shader() {
@@ -97,28 +218,76 @@ void Shader::use() const {
     glUseProgram(ID);
 }
 
-void Shader::setBool(const std::string &name, const bool value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), static_cast<int>(value));
+void Shader::cacheUniformLocations() {
+    int count = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    uniformLocations.clear();
+    uniformLocations.reserve(count);
+
+    for (int i = 0; i < count; i++) {
+        char name[256];
+        int length = 0, size = 0;
+        unsigned int type = 0;
+        glGetActiveUniform(ID, i, sizeof(name), &length, &size, &type, name);
+
+        // Arrays are reported as "name[0]"; register them under the plain name
+        std::string_view key(name, length);
+        if (key.ends_with("[0]")) key.remove_suffix(3);
+
+        const int location = glGetUniformLocation(ID, name);
+        if (location >= 0) {
+            uniformLocations.emplace_back(UniformName::hashOf(key), location);
+        }
+    }
+
+    std::sort(uniformLocations.begin(), uniformLocations.end());
+    for (size_t i = 1; i < uniformLocations.size(); i++) {
+        if (uniformLocations[i].first == uniformLocations[i - 1].first) {
+            std::cout << "WARNING::SHADER_UNIFORM_HASH_COLLISION at location " << uniformLocations[i].second
+                      << std::endl;
+        }
+    }
+}
+
+int Shader::uniformLocation(const UniformName name) const {
+    const auto it = std::lower_bound(uniformLocations.begin(), uniformLocations.end(), name.hash,
+                                     [](const std::pair<std::uint32_t, int> &entry, const std::uint32_t hash) {
+                                         return entry.first < hash;
+                                     });
+    return (it != uniformLocations.end() && it->first == name.hash) ? it->second : -1;
 }
 
-void Shader::setInt(const std::string &name, const int value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+void Shader::setBool(const UniformName name, const bool value) const {
+    glUniform1i(uniformLocation(name), static_cast<int>(value));
 }
 
-void Shader::setFloat(const std::string &name, const float value) const {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+void Shader::setInt(const UniformName name, const int value) const {
+    glUniform1i(uniformLocation(name), value);
 }
 
-void Shader::setVec2(const std::string &name, const float x, const float y) const {
-    glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+void Shader::setFloat(const UniformName name, const float value) const {
+    glUniform1f(uniformLocation(name), value);
 }
 
-void Shader::setVec3(const std::string &name, const float x, const float y, const float z) const {
-    glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+void Shader::setVec2(const UniformName name, const float x, const float y) const {
+    glUniform2f(uniformLocation(name), x, y);
 }
 
-void Shader::setMat4(const std::string &name, const float* value) const {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, value);
+void Shader::setVec3(const UniformName name, const float x, const float y, const float z) const {
+    glUniform3f(uniformLocation(name), x, y, z);
+}
+
+void Shader::setMat4(const UniformName name, const float* value) const {
+    glUniformMatrix4fv(uniformLocation(name), 1, GL_FALSE, value);
+}
+
+bool Shader::bindUniformBlock(const char* blockName, const unsigned int binding) const {
+    const unsigned int index = glGetUniformBlockIndex(ID, blockName);
+    if (index == GL_INVALID_INDEX) {
+        return false;
+    }
+    glUniformBlockBinding(ID, index, binding);
+    return true;
 }
 
 void Shader::checkCompileErrors(const unsigned int shader, const std::string& type) {
@@ -138,3 +307,45 @@ void Shader::checkCompileErrors(const unsigned int shader, const std::string& ty
         }
     }
 }
+
+ShaderPermutations::ShaderPermutations(const char* vertexSource, const char* fragmentSource,
+                                       const unsigned int count, std::function<void(const Shader&)> setup,
+                                       std::string defines)
+    : vertexSource(vertexSource), fragmentSource(fragmentSource), setup(std::move(setup)),
+      defines(std::move(defines)), programs(count) {}
+
+const Shader& ShaderPermutations::get(const unsigned int mask) {
+    std::unique_ptr<Shader>& program = programs[mask];
+    if (!program) {
+        program = std::make_unique<Shader>(vertexSource, fragmentSource,
+                                           "#define FEATURE_MASK " + std::to_string(mask) + "\n" + defines);
+        setup(*program);
+    }
+    return *program;
+}
+
+bool ShaderPermutations::warmUp() {
+    for (unsigned int mask = 0; mask < programs.size(); mask++) {
+        if (!programs[mask]) {
+            get(mask);
+            return true;
+        }
+    }
+    return false;
+}
+
+UniformBuffer::UniformBuffer(const size_t size, const unsigned int binding) {
+    glGenBuffers(1, &ID);
+    glBindBuffer(GL_UNIFORM_BUFFER, ID);
+    glBufferData(GL_UNIFORM_BUFFER, static_cast<GLsizeiptr>(size), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, ID);
+}
+
+UniformBuffer::~UniformBuffer() {
+    glDeleteBuffers(1, &ID);
+}
+
+void UniformBuffer::update(const void* data, const size_t size) const {
+    glBindBuffer(GL_UNIFORM_BUFFER, ID);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, static_cast<GLsizeiptr>(size), data);
+}
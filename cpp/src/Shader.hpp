@@ -2,7 +2,13 @@
 
 #define GLFW_INCLUDE_NONE
 #include <GL/glcorearb.h>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 // OpenGL function pointers - will be loaded via GLFW
 extern PFNGLCREATESHADERPROC glCreateShader;
@@ -19,6 +25,7 @@ extern PFNGLDELETESHADERPROC glDeleteShader;
 extern PFNGLDELETEPROGRAMPROC glDeleteProgram;
 extern PFNGLUSEPROGRAMPROC glUseProgram;
 extern PFNGLGETUNIFORMLOCATIONPROC glGetUniformLocation;
+extern PFNGLGETACTIVEUNIFORMPROC glGetActiveUniform;
 extern PFNGLUNIFORM1IPROC glUniform1i;
 extern PFNGLUNIFORM1FPROC glUniform1f;
 extern PFNGLUNIFORM2FPROC glUniform2f;
@@ -33,25 +40,129 @@ extern PFNGLVERTEXATTRIBPOINTERPROC glVertexAttribPointer;
 extern PFNGLENABLEVERTEXATTRIBARRAYPROC glEnableVertexAttribArray;
 extern PFNGLDELETEVERTEXARRAYSPROC glDeleteVertexArrays;
 extern PFNGLDELETEBUFFERSPROC glDeleteBuffers;
+extern PFNGLBUFFERSUBDATAPROC glBufferSubData;
+extern PFNGLBINDBUFFERBASEPROC glBindBufferBase;
+extern PFNGLGETUNIFORMBLOCKINDEXPROC glGetUniformBlockIndex;
+extern PFNGLUNIFORMBLOCKBINDINGPROC glUniformBlockBinding;
+extern PFNGLGENQUERIESPROC glGenQueries;
+extern PFNGLDELETEQUERIESPROC glDeleteQueries;
+extern PFNGLBEGINQUERYPROC glBeginQuery;
+extern PFNGLENDQUERYPROC glEndQuery;
+extern PFNGLGETQUERYOBJECTIVPROC glGetQueryObjectiv;
+extern PFNGLGETQUERYOBJECTUI64VPROC glGetQueryObjectui64v;
+// GL 4.1 / ARB_get_program_binary, null when missing (ProgramCache)
+extern PFNGLGETPROGRAMBINARYPROC glGetProgramBinary;
+extern PFNGLPROGRAMBINARYPROC glProgramBinary;
+extern PFNGLPROGRAMPARAMETERIPROC glProgramParameteri;
+extern PFNGLGENFRAMEBUFFERSPROC glGenFramebuffers;
+extern PFNGLBINDFRAMEBUFFERPROC glBindFramebuffer;
+extern PFNGLFRAMEBUFFERTEXTURE2DPROC glFramebufferTexture2D;
+extern PFNGLCHECKFRAMEBUFFERSTATUSPROC glCheckFramebufferStatus;
+extern PFNGLDELETEFRAMEBUFFERSPROC glDeleteFramebuffers;
+extern PFNGLMAPBUFFERRANGEPROC glMapBufferRange;
+extern PFNGLUNMAPBUFFERPROC glUnmapBuffer;
+extern PFNGLDRAWBUFFERSPROC glDrawBuffers;
+extern PFNGLGENRENDERBUFFERSPROC glGenRenderbuffers;
+extern PFNGLBINDRENDERBUFFERPROC glBindRenderbuffer;
+extern PFNGLRENDERBUFFERSTORAGEPROC glRenderbufferStorage;
+extern PFNGLFRAMEBUFFERRENDERBUFFERPROC glFramebufferRenderbuffer;
+extern PFNGLDELETERENDERBUFFERSPROC glDeleteRenderbuffers;
+extern PFNGLGENERATEMIPMAPPROC glGenerateMipmap;
+extern PFNGLBLENDEQUATIONSEPARATEPROC glBlendEquationSeparate;
+// GL 4.3 compute shaders, null when missing (GpuRenderer::computeAvailable)
+extern PFNGLDISPATCHCOMPUTEPROC glDispatchCompute;
+extern PFNGLDISPATCHCOMPUTEINDIRECTPROC glDispatchComputeIndirect;
+extern PFNGLBINDIMAGETEXTUREPROC glBindImageTexture;
+extern PFNGLMEMORYBARRIERPROC glMemoryBarrier;
+extern PFNGLGETINTEGERI_VPROC glGetIntegeri_v;
 
-// Function to load OpenGL functions
+// glfwGetProcAddress, eglGetProcAddress, ...
+using GLProcLoader = void (*(*)(const char*))();
+
+// Function to load OpenGL functions; the first form uses GLFW's current context
 bool loadOpenGLFunctions();
+bool loadOpenGLFunctions(GLProcLoader loader);
+
+// Uniform name hashed (FNV-1a) at compile time. The setters take these, so
+// setting a uniform costs one search of the program's location table: no
+// string construction and no glGetUniformLocation per frame.
+struct UniformName {
+    std::uint32_t hash;
+
+    consteval UniformName(const char* name) : hash(hashOf(name)) {}
+
+    static constexpr std::uint32_t hashOf(const std::string_view name) {
+        std::uint32_t h = 2166136261u;
+        for (const char c : name) {
+            h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+        }
+        return h;
+    }
+};
 
 class Shader {
 public:
     unsigned int ID;
 
-    Shader(const char* vertexPath, const char* fragmentPath);
+    // 'defines' ("#define NAME VALUE" lines) goes right after each stage's #version line.
+    // Linked programs are kept in the on-disk ProgramCache and reused when the key matches.
+    // Without a vertex source the fragment source is built as a compute shader
+    // instead, its #version raised to 430 (needs a GL 4.3 context).
+    Shader(const char* vertexPath, const char* fragmentPath, const std::string& defines = {});
     ~Shader();
 
     void use() const;
-    void setBool(const std::string &name, bool value) const;
-    void setInt(const std::string &name, int value) const;
-    void setFloat(const std::string &name, float value) const;
-    void setVec2(const std::string &name, float x, float y) const;
-    void setVec3(const std::string &name, float x, float y, float z) const;
-    void setMat4(const std::string &name, const float* value) const;
+    // Location of an active uniform, -1 (ignored by glUniform*) if there is none
+    [[nodiscard]] int uniformLocation(UniformName name) const;
+
+    void setBool(UniformName name, bool value) const;
+    void setInt(UniformName name, int value) const;
+    void setFloat(UniformName name, float value) const;
+    void setVec2(UniformName name, float x, float y) const;
+    void setVec3(UniformName name, float x, float y, float z) const;
+    void setMat4(UniformName name, const float* value) const;
+    // Points the named uniform block at a binding; false if the program has no such block
+    bool bindUniformBlock(const char* blockName, unsigned int binding) const;
 
 private:
+    // (name hash, location) of every active uniform, sorted by hash; filled once after linking
+    std::vector<std::pair<std::uint32_t, int>> uniformLocations;
+
+    void cacheUniformLocations();
     static void checkCompileErrors(unsigned int shader, const std::string& type);
 };
+
+// Specialized builds of one shader, one per feature mask, each compiled with
+// "#define FEATURE_MASK <mask>" so the disabled features compile out. Programs
+// are built on first use; warmUp() builds the rest ahead of time, one per call.
+class ShaderPermutations {
+public:
+    // 'setup' runs once on every new program (block bindings, constant uniforms);
+    // 'defines' go into every permutation after FEATURE_MASK
+    ShaderPermutations(const char* vertexSource, const char* fragmentSource, unsigned int count,
+                       std::function<void(const Shader&)> setup, std::string defines = {});
+
+    const Shader& get(unsigned int mask);
+    // Builds one missing permutation; false once all exist
+    bool warmUp();
+
+private:
+    const char* vertexSource;
+    const char* fragmentSource;
+    std::function<void(const Shader&)> setup;
+    std::string defines;
+    std::vector<std::unique_ptr<Shader>> programs;
+};
+
+// Uniform buffer attached to a fixed binding point; programs that bind their
+// block to the same point all read it
+class UniformBuffer {
+public:
+    unsigned int ID;
+
+    UniformBuffer(size_t size, unsigned int binding);
+    ~UniformBuffer();
+
+    // One glBufferSubData of the whole block
+    void update(const void* data, size_t size) const;
+};
@@ -15,24 +15,117 @@ void main() {
 static auto BLACKHOLE_FRAG_SRC = R"glsl(
 #version 330 core
 
-out vec4 FragColor;
+// Besides the plain full-resolution shader this source builds the two passes
+// of the reduced-resolution pipeline (GpuRenderer::renderReconstructed):
+//   HIT_INFO     marches one ray per MARCH_STRIDE^2 pixel block and also writes
+//                the ray's classification (hitType, disk coverage, closest approach)
+//   RECONSTRUCT  full resolution: interpolates the block results where the
+//                classification agrees and discards the pixel where it doesn't,
+//                leaving it to a stencil-masked full-resolution pass
+// and of the temporal pipeline (GpuRenderer::renderTemporal):
+//   TEMPORAL          with HIT_INFO and MARCH_STRIDE 2: the ray goes through
+//                     pixel u_subsetOffset of each 2x2 block instead of its centre
+//   TEMPORAL_RESOLVE  full resolution: the freshly marched quarter plus the
+//                     previous frame reprojected for the rest; discards where
+//                     the reprojected history disagrees with the fresh rays
+// and of the sky bake (GpuRenderer::bakeSky):
+//   BAKE_SKY          renders face u_bakeFace of the star (u_bakeLayer 0) or
+//                     nebula (1) cubemap that starField() samples
+// and, compiled as a GL 4.3 compute shader with COMPUTE defined, of the
+// compute path (GpuRenderer::renderCompute):
+//   COMPUTE_CLASSIFY  8x8 tiles: shades the rays that can't meet anything
+//                     and appends the rest to RayQueue, one atomic per tile
+//   COMPUTE_MARCH     one invocation per queued ray, 64 per group
+//   COMPUTE_MARCH_PASS  the marched model in passes of MARCH_PASS_STEPS steps:
+//                       rays still going are saved and requeued compacted in
+//                       NextQueue, which the next pass marches on
+#ifndef MARCH_STRIDE
+#define MARCH_STRIDE 1
+#endif
+
+#ifdef COMPUTE
+layout(rgba8, binding = 0) writeonly uniform image2D u_output;
+// Pixels left to march, packed x | y << 16. The first three words are the
+// indirect dispatch size of the march stage: 64 rays per group, split over
+// x and y so x stays within u_maxGroupsX (GL_MAX_COMPUTE_WORK_GROUP_COUNT).
+layout(std430, binding = 0) buffer RayQueue {
+    uint queueGroupsX;
+    uint queueGroupsY;
+    uint queueGroupsZ;
+    uint queueCount;
+    uint queueRays[];
+};
+uniform int u_maxGroupsX;
+#else
+layout(location = 0) out vec4 FragColor;
+#endif
+#ifdef HIT_INFO
+layout(location = 1) out vec4 HitInfo;
+#endif
+#if defined(TEMPORAL) || defined(TEMPORAL_RESOLVE)
+uniform vec2 u_subsetOffset; // pixel of each 2x2 block marched this frame
+#endif
+
+// Per-frame state, one std140 buffer shared by every program (FrameBlock.hpp)
+layout(std140) uniform FrameBlock {
+    mat4 u_invViewMatrix;
+    vec3 u_cameraPosition;
+    float u_time;
+    vec2 u_resolution;
+    float u_mass;
+    float u_schwarzschildRadius;
+    float u_diskInnerRadius;
+    float u_diskOuterRadius;
+    float u_stepSize;
+    float u_farDist;
+    float u_lensMaxRadius;
+    int u_maxSteps;
+    int u_enableStarfield;
+    int u_enablePlanets;
+    int u_enableDisk;
+    int u_enableLensing;
+    int u_lensingModel;
+    float u_spin;
+};
+
+// Planets at the frame time, from SimParams::planets (PlanetBlock in FrameBlock.hpp)
+const int MAX_PLANETS = 32;
+layout(std140) uniform PlanetBlock {
+    vec4 u_planetSpheres[MAX_PLANETS]; // center, radius
+    vec4 u_planetColors[MAX_PLANETS];  // base color, bands (0 solid, 1 gas giant)
+    int u_planetCount;
+    float u_planetReach;               // outermost orbit plus its planet's radius, small bodies included
+    float u_planetMaxRadius;           // all planets lie within this of the disk plane
+    float u_bodySlab;                  // all small bodies lie within this of the disk plane, 0 without any
+    vec4 u_bodyGrid;                   // grid corner x and z, cell size, cells per side
+    float u_bodyInnerRadius;           // no small body comes closer to the axis
+};
+
+// Small bodies (BodyGrid.hpp): u_bodyCells holds the first item and item
+// count of every grid cell; items are two texels of u_bodyItems each, center
+// and radius, then color
+uniform isampler2D u_bodyCells;
+uniform sampler2D u_bodyItems;
+const int BODY_ITEMS_WIDTH = 1024;
+
+uniform sampler2D u_deflectionLut;
 
-uniform vec2 u_resolution;
-uniform float u_time;
-uniform mat4 u_invViewMatrix;
-uniform vec3 u_cameraPosition;
-uniform float u_mass;
-uniform float u_schwarzschildRadius;
-uniform float u_diskInnerRadius;
-uniform float u_diskOuterRadius;
-uniform int u_enableStarfield;
-uniform int u_enablePlanets;
-uniform int u_enableDisk;
-uniform int u_enableLensing;
-uniform float u_stepSize;
-uniform int u_maxSteps;
-uniform float u_farDist;
-uniform float u_lensMaxRadius;
+// Feature switches: compile-time constants in the permutations built with
+// FEATURE_MASK defined (ShaderPermutations), so disabled features compile
+// out of the march loops; the FrameBlock flags otherwise
+#ifdef FEATURE_MASK
+#define STARFIELD_ON ((FEATURE_MASK & 1) != 0)
+#define PLANETS_ON ((FEATURE_MASK & 2) != 0)
+#define DISK_ON ((FEATURE_MASK & 4) != 0)
+#define LENSING_ON ((FEATURE_MASK & 8) != 0)
+#define BODIES_ON ((FEATURE_MASK & 16) != 0)
+#else
+#define STARFIELD_ON (u_enableStarfield == 1)
+#define PLANETS_ON (u_enablePlanets == 1)
+#define DISK_ON (u_enableDisk == 1)
+#define LENSING_ON (u_enableLensing == 1)
+#define BODIES_ON (PLANETS_ON && u_bodySlab > 0.0)
+#endif
 
 // Constants
 const float PI = 3.14159265359;
@@ -40,20 +133,25 @@ const int MAX_STEPS = 300;
 const float MAX_DIST = 100.0;
 const float EPSILON = 0.001;
 
-// Planet Properties
-const float planet1_orbitRadius = 18.0;
-const float planet1_radius = 0.4;
-const float planet1_speed = 0.1;
-const vec3 planet1_color = vec3(0.8, 0.3, 0.1);
-
-const float planet2_orbitRadius = 30.0;
-const float planet2_radius = 1.0;
-const float planet2_speed = 0.05;
-const vec3 planet2_color_base = vec3(0.3, 0.4, 0.7);
-
 // Physics
 const float G = 1.0;
 
+// Ray classification for the reduced-resolution pass (HIT_INFO): what ended
+// the ray, how opaque the disk made it and how close it came to the hole
+const int HIT_SKY = 0;
+const int HIT_HORIZON = 1;
+const int HIT_PLANET = 2;
+const int HIT_DISK = 3;
+int hitType = HIT_SKY;
+float hitCoverage = 0.0;
+float hitMinRadius = 1e4;
+
+vec3 endRay(int type, vec3 color, float transmittance) {
+    hitType = type;
+    hitCoverage = 1.0 - transmittance;
+    return color;
+}
+
 // Utility Functions
 float random(vec2 st) {
     return fract(sin(dot(st.xy, vec2(12.9898, 78.233))) * 43758.5453123);
@@ -84,11 +182,20 @@ float fbm(vec2 p) {
     return (sum > 0.0) ? (f / sum) : 0.0;
 }
 
-vec3 starField(vec3 rd, float t) {
-    rd = normalize(rd);
+vec2 skyCoord(vec3 rd) {
     float lon = atan(rd.z, rd.x);
     float lat = asin(clamp(rd.y, -1.0, 1.0));
-    vec2 uv = vec2(lon / (2.0 * PI) + 0.5, lat / PI + 0.5);
+    return vec2(lon / (2.0 * PI) + 0.5, lat / PI + 0.5);
+}
+
+float starTwinkle(float seed, float t) {
+    return 0.88 + 0.22 * sin(t * (5.0 + 11.0 * seed) + seed * 6.28318);
+}
+
+// Stars without their twinkle (linear, before tone mapping); alpha is the
+// twinkle seed of the star contributing most
+vec4 starLayer(vec3 rd) {
+    vec2 uv = skyCoord(rd);
 
     const vec2 GRID = vec2(520.0, 260.0);
     vec2 gUV = uv * GRID;
@@ -96,6 +203,8 @@ vec3 starField(vec3 rd, float t) {
     vec2 f = fract(gUV);
 
     vec3 color = vec3(0.0);
+    float brightest = 0.0;
+    float seed = 0.0;
 
     for (int j = -1; j <= 1; j++) {
         for (int i = -1; i <= 1; i++) {
@@ -116,20 +225,28 @@ vec3 starField(vec3 rd, float t) {
             baseB += rare * 0.6;
 
             float twR = random(cid + vec2(9.2, 6.4));
-            float tw = 0.88 + 0.22 * sin(t * (5.0 + 11.0 * twR) + twR * 6.28318);
 
             float core = smoothstep(size, 0.0, dist);
             core = core * core;
             float halo = smoothstep(2.5 * size, 0.0, dist) * 0.35;
             float starM = core + halo;
-            float intensity = baseB * starM * tw;
+            float intensity = baseB * starM;
+            if (intensity > brightest) {
+                brightest = intensity;
+                seed = twR;
+            }
 
             float temp = random(cid + vec2(2.7, 8.9));
             vec3 starCol = mix(vec3(1.0, 0.92, 0.86), vec3(0.75, 0.86, 1.0), temp);
             color += intensity * starCol;
         }
     }
+    return vec4(color, seed);
+}
 
+// Milky Way band nebula (linear)
+vec3 nebulaLayer(vec3 rd) {
+    vec2 uv = skyCoord(rd);
     vec3 galN = normalize(vec3(0.0, 0.2, 1.0));
     float band = pow(1.0 - abs(dot(rd, galN)), 2.0);
 
@@ -140,45 +257,51 @@ vec3 starField(vec3 rd, float t) {
 
     vec3 nebColA = vec3(0.12, 0.16, 0.22);
     vec3 nebColB = vec3(0.18, 0.12, 0.20);
-    vec3 nebula = mix(nebColA, nebColB, nebDetail) * (0.06 * neb);
-    color += nebula;
-
-    color = color / (1.0 + color);
-    return color;
+    return mix(nebColA, nebColB, nebDetail) * (0.06 * neb);
 }
 
-vec4 getPlanetColor(vec3 p) {
-    if (u_enablePlanets == 0) {
-        return vec4(0.0);
-    }
-
-    // Planet 1 (Rocky Planet)
-    float angle1 = u_time * planet1_speed;
-    vec3 planet1_pos = vec3(cos(angle1) * planet1_orbitRadius, 0.0, sin(angle1) * planet1_orbitRadius);
+// Background sky: both layers come from cubemaps baked once at startup, so
+// only the twinkle is evaluated per ray. The mip level follows the pixel
+// footprint of an unbent ray (derivatives are undefined inside the marchers),
+// one level sharper since lensing stretches most of the sky the rays see.
+uniform samplerCube u_skyStars;
+uniform samplerCube u_skyNebula;
 
-    if (length(p - planet1_pos) < planet1_radius) {
-        vec3 normal = normalize(p - planet1_pos);
-        vec3 lightDir = normalize(-planet1_pos);
-        float diffuse = max(0.0, dot(normal, lightDir)) * 0.7 + 0.3;
-        return vec4(planet1_color * diffuse, 1.0);
-    }
+vec3 starField(vec3 rd, float t) {
+    float texelAngle = 0.5 * PI / float(textureSize(u_skyStars, 0).x);
+    float lod = max(log2(1.0 / (u_resolution.y * texelAngle)) - 1.0, 0.0);
+    vec4 stars = textureLod(u_skyStars, rd, lod);
+    vec3 color = stars.rgb * starTwinkle(stars.a, t) + textureLod(u_skyNebula, rd, 0.0).rgb;
+    return color / (1.0 + color);
+}
 
-    // Planet 2 (Gas Giant)
-    float angle2 = u_time * planet2_speed + 2.5;
-    vec3 planet2_pos = vec3(cos(angle2) * planet2_orbitRadius, 0.0, sin(angle2) * planet2_orbitRadius);
+vec4 bodyTexel(int texel) {
+    return texelFetch(u_bodyItems, ivec2(texel % BODY_ITEMS_WIDTH, texel / BODY_ITEMS_WIDTH), 0);
+}
 
-    if (length(p - planet2_pos) < planet2_radius) {
-        vec3 normal = normalize(p - planet2_pos);
-        vec3 lightDir = normalize(-planet2_pos);
-        float diffuse = max(0.0, dot(normal, lightDir)) * 0.6 + 0.4;
+// Lit color of a point on planet i (small body i - MAX_PLANETS from
+// MAX_PLANETS on): diffuse from the hole, bands mix in white noise stripes
+// like the gas giant's
+vec3 shadePlanet(vec3 p, int i) {
+    vec3 center;
+    vec4 look;
+    if (i < MAX_PLANETS) {
+        center = u_planetSpheres[i].xyz;
+        look = u_planetColors[i];
+    } else {
+        center = bodyTexel(2 * (i - MAX_PLANETS)).xyz;
+        look = bodyTexel(2 * (i - MAX_PLANETS) + 1);
+    }
+    vec3 normal = normalize(p - center);
+    vec3 lightDir = normalize(-center);
+    float diffuse = max(0.0, dot(normal, lightDir)) * (0.7 - 0.1 * look.a) + 0.3 + 0.1 * look.a;
 
+    vec3 color = look.rgb;
+    if (look.a > 0.0) {
         float n = noise(p.xy * 3.0) * 0.5 + noise(p.yz * 6.0) * 0.5;
-        vec3 texColor = mix(planet2_color_base, vec3(0.9), n);
-
-        return vec4(texColor * diffuse, 1.0);
+        color = mix(color, vec3(0.9), n * look.a);
     }
-
-    return vec4(0.0);
+    return color * diffuse;
 }
 
 vec4 getDiskSample(vec3 p) {
@@ -226,97 +349,1263 @@ vec4 getDiskSample(vec3 p) {
     return vec4(emissive, alpha);
 }
 
+// Entry parameter of segment a->b into a sphere, or 2.0 if it misses
+float segmentSphere(vec3 a, vec3 b, vec3 center, float radius) {
+    vec3 d = b - a;
+    vec3 m = a - center;
+    float c = dot(m, m) - radius * radius;
+    if (c < 0.0) return 0.0;
+    float A = dot(d, d);
+    float B = dot(m, d);
+    float disc = B * B - A * c;
+    if (disc < 0.0 || B > 0.0) return 2.0;
+    float t = (-B - sqrt(disc)) / A;
+    return (t <= 1.0) ? t : 2.0;
+}
+
+// First small body hit on segment a->b with entry parameter below t: walks
+// the grid cells the segment's xz projection crosses, nearest first, until
+// the next cell starts past the hit. Lowers t and returns the item, -1 on a miss.
+int segmentBodies(vec3 a, vec3 b, inout float t) {
+    if (min(a.y, b.y) > u_bodySlab || max(a.y, b.y) < -u_bodySlab) {
+        return -1;
+    }
+    // Both ends inside the belt's inner edge: so is the whole segment
+    float innerSq = u_bodyInnerRadius * u_bodyInnerRadius;
+    if (dot(a.xz, a.xz) < innerSq && dot(b.xz, b.xz) < innerSq) {
+        return -1;
+    }
+
+    // In grid coordinates, clipped to the grid square and the current hit
+    int cells = int(u_bodyGrid.w);
+    float n = u_bodyGrid.w;
+    vec2 p = (a.xz - u_bodyGrid.xy) / u_bodyGrid.z;
+    vec2 d = (b.xz - a.xz) / u_bodyGrid.z;
+    float t0 = 0.0;
+    float t1 = min(t, 1.0);
+    for (int k = 0; k < 2; k++) {
+        if (d[k] == 0.0) {
+            if (p[k] < 0.0 || p[k] > n) return -1;
+            continue;
+        }
+        float ta = -p[k] / d[k];
+        float tb = (n - p[k]) / d[k];
+        t0 = max(t0, min(ta, tb));
+        t1 = min(t1, max(ta, tb));
+    }
+    if (t0 > t1) {
+        return -1;
+    }
+
+    // 2D DDA
+    ivec2 cell = clamp(ivec2(floor(p + d * t0)), ivec2(0), ivec2(cells - 1));
+    ivec2 stepDir = ivec2(d.x > 0.0 ? 1 : -1, d.y > 0.0 ? 1 : -1);
+    vec2 tDelta = vec2(d.x != 0.0 ? 1.0 / abs(d.x) : 1e30, d.y != 0.0 ? 1.0 / abs(d.y) : 1e30);
+    vec2 tNext = vec2(d.x != 0.0 ? (float(cell.x + (d.x > 0.0 ? 1 : 0)) - p.x) / d.x : 1e30,
+                      d.y != 0.0 ? (float(cell.y + (d.y > 0.0 ? 1 : 0)) - p.y) / d.y : 1e30);
+    int item = -1;
+    for (float tCell = t0; tCell <= min(t1, t);) {
+        ivec2 range = texelFetch(u_bodyCells, cell, 0).xy;
+        for (int k = range.x; k < range.x + range.y; k++) {
+            vec4 sphere = bodyTexel(2 * k);
+            float tk = segmentSphere(a, b, sphere.xyz, sphere.w);
+            if (tk < t) {
+                t = tk;
+                item = k;
+            }
+        }
+        int axis = tNext.x < tNext.y ? 0 : 1;
+        tCell = tNext[axis];
+        tNext[axis] += tDelta[axis];
+        cell[axis] += stepDir[axis];
+        if (cell[axis] < 0 || cell[axis] >= cells) break;
+    }
+    return item;
+}
+
+// First planet or small body hit on segment a->b: entry parameter (2.0 on a
+// miss), the entry point and the index (small bodies from MAX_PLANETS on)
+float segmentPlanets(vec3 a, vec3 b, out vec3 hit, out int planet) {
+    hit = vec3(0.0);
+    planet = -1;
+    if (!PLANETS_ON) {
+        return 2.0;
+    }
+    float t = 2.0;
+    if (min(a.y, b.y) <= u_planetMaxRadius && max(a.y, b.y) >= -u_planetMaxRadius) {
+        for (int i = 0; i < u_planetCount; i++) {
+            float ti = segmentSphere(a, b, u_planetSpheres[i].xyz, u_planetSpheres[i].w);
+            if (ti < t) {
+                t = ti;
+                planet = i;
+            }
+        }
+    }
+    if (BODIES_ON) {
+        int item = segmentBodies(a, b, t);
+        if (item >= 0) {
+            planet = MAX_PLANETS + item;
+        }
+    }
+    if (t <= 1.0) {
+        hit = mix(a, b, t);
+    }
+    return t;
+}
+
+// Radius around the hole that holds everything rayMarch can hit or be bent
+// by: the lensing region and horizon, the disk and the planet orbits
+float sceneRadius() {
+    float reach = 0.0;
+    if (LENSING_ON) reach = max(u_lensMaxRadius, u_schwarzschildRadius + EPSILON);
+    if (DISK_ON) reach = max(reach, u_diskOuterRadius);
+    if (PLANETS_ON) reach = max(reach, u_planetReach);
+    return reach;
+}
+
+// rayMarch without lensing: the ray stays straight, so the planets and the
+// disk plane are intersected in closed form instead of stepped through
+vec3 traceStraight(vec3 rayOrigin, vec3 rayDir, float farDist) {
+    vec3 accColor = vec3(0.0);
+    float transmittance = 1.0;
+    float tca = -dot(rayOrigin, rayDir);
+    float tFar = max(tca + sqrt(max(farDist * farDist - dot(rayOrigin, rayOrigin) + tca * tca, 0.0)), 0.0);
+
+    vec3 planetHit;
+    int planet;
+    float tPlanet = segmentPlanets(rayOrigin, rayOrigin + rayDir * tFar, planetHit, planet);
+    float tEnd = (tPlanet <= 1.0) ? tPlanet * tFar : tFar;
+    hitMinRadius = min(hitMinRadius, length(rayOrigin + rayDir * clamp(tca, 0.0, tEnd)));
+
+    float tDisk = (abs(rayDir.y) > 1e-6) ? -rayOrigin.y / rayDir.y : -1.0;
+    if (DISK_ON && tDisk > 0.0 && tDisk < tEnd) {
+        vec3 hit = rayOrigin + rayDir * tDisk;
+        float r_hit = length(hit.xz);
+        if (r_hit > u_diskInnerRadius && r_hit < u_diskOuterRadius) {
+            vec4 disk = getDiskSample(hit);
+            accColor += transmittance * disk.rgb;
+            transmittance *= (1.0 - disk.a);
+            if (transmittance < 0.02) {
+                return endRay(HIT_DISK, accColor, transmittance);
+            }
+        }
+    }
+
+    if (tPlanet <= 1.0) {
+        accColor += transmittance * shadePlanet(planetHit, planet);
+        return endRay(HIT_PLANET, accColor, transmittance);
+    }
+    if (STARFIELD_ON) {
+        accColor += transmittance * starField(rayDir, u_time);
+    }
+    return endRay(HIT_SKY, accColor, transmittance);
+}
+
+// Moves p to where the ray enters sceneRadius(); false if it never does
+bool enterScene(inout vec3 p, vec3 rayDir, float reach) {
+    float tca = -dot(p, rayDir);
+    float missDistSq = dot(p, p) - tca * tca;
+    if (dot(p, p) > reach * reach) {
+        if (tca <= 0.0 || missDistSq >= reach * reach) {
+            hitMinRadius = (tca > 0.0) ? sqrt(max(missDistSq, 0.0)) : length(p);
+            return false;
+        }
+        p += rayDir * (tca - sqrt(reach * reach - missDistSq));
+    }
+    return true;
+}
+
+// One step of the rayMarch loop: bends and moves the ray, adding the disk
+// and planet it meets to accColor. True once the ray has ended.
+bool marchStep(inout vec3 p, inout vec3 rayDir, inout vec3 accColor, inout float transmittance, float reach,
+               float farDist) {
+    vec3 p_prev = p;
+
+    // Event horizon check
+    if (LENSING_ON) {
+        if (length(p) < u_schwarzschildRadius + EPSILON) {
+            endRay(HIT_HORIZON, accColor, transmittance);
+            return true;
+        }
+    }
+
+    // Apply gravitational lensing
+    float r = length(p);
+    hitMinRadius = min(hitMinRadius, r);
+    float distToCenterSq = max(r * r, 1e-4);
+    float stepSize = u_stepSize;
+    stepSize += stepSize * smoothstep(u_diskOuterRadius + 2.0, farDist, r) * 2.5;
+    stepSize *= 1.0 + 1.2 * smoothstep(0.5, 3.0, abs(p.y));
+
+    if (LENSING_ON && r < u_lensMaxRadius) {
+        vec3 gravityDir = (r > 1e-6) ? -p / r : vec3(0.0, 0.0, 0.0);
+        vec3 acceleration = gravityDir * (G * u_mass) / distToCenterSq;
+        rayDir = normalize(rayDir + acceleration * stepSize);
+    }
+    p += rayDir * stepSize;
+
+    // Planets hit anywhere on the step, not just at its ends
+    vec3 planetHit;
+    int planet;
+    float tPlanet = segmentPlanets(p_prev, p, planetHit, planet);
+
+    // Disk intersection before the planet
+    if (DISK_ON && p_prev.y * p.y < 0.0) {
+        float t = -p_prev.y / (p.y - p_prev.y);
+        vec3 hit = p_prev + t * (p - p_prev);
+        float r_hit = length(hit.xz);
+        if (t < tPlanet && r_hit > u_diskInnerRadius && r_hit < u_diskOuterRadius) {
+            vec4 disk = getDiskSample(hit);
+            accColor += transmittance * disk.rgb;
+            transmittance *= (1.0 - disk.a);
+            if (transmittance < 0.02) {
+                endRay(HIT_DISK, accColor, transmittance);
+                return true;
+            }
+        }
+    }
+
+    if (tPlanet <= 1.0) {
+        accColor += transmittance * shadePlanet(planetHit, planet);
+        endRay(HIT_PLANET, accColor, transmittance);
+        return true;
+    }
+
+    // Heading out past sceneRadius the ray stays straight and never comes back
+    float rNext = length(p);
+    if (rNext > farDist || (rNext > reach && dot(p, rayDir) > 0.0)) {
+        if (STARFIELD_ON) {
+            accColor += transmittance * starField(rayDir, u_time);
+        }
+        endRay(HIT_SKY, accColor, transmittance);
+        return true;
+    }
+    return false;
+}
+
 vec3 rayMarch(vec3 rayOrigin, vec3 rayDir) {
     vec3 accColor = vec3(0.0);
     float transmittance = 1.0;
     vec3 p = rayOrigin;
     float farDist = (u_farDist > 0.0) ? u_farDist : MAX_DIST;
+    if (!LENSING_ON) {
+        return traceStraight(rayOrigin, rayDir, farDist);
+    }
+
+    // Nothing happens outside sceneRadius: rays that miss the sphere go
+    // straight to the sky, the rest start marching where they enter it
+    float reach = sceneRadius();
+    if (!enterScene(p, rayDir, reach)) {
+        if (STARFIELD_ON) {
+            accColor += starField(rayDir, u_time);
+        }
+        return endRay(HIT_SKY, accColor, transmittance);
+    }
 
     for (int i = 0; i < MAX_STEPS; i++) {
         if (i >= u_maxSteps) break;
-        vec3 p_prev = p;
-
-        // Planet hit check
-        vec4 planetHitColor = getPlanetColor(p);
-        if (planetHitColor.w > 0.5) {
-            accColor += transmittance * planetHitColor.rgb;
+        if (marchStep(p, rayDir, accColor, transmittance, reach, farDist)) {
             return accColor;
         }
+    }
 
-        // Event horizon check
-        if (u_enableLensing == 1) {
-            if (length(p) < u_schwarzschildRadius + EPSILON) {
-                return accColor;
+    if (STARFIELD_ON) {
+        accColor += transmittance * starField(rayDir, u_time);
+    }
+    return endRay(HIT_SKY, accColor, transmittance);
+}
+
+// Deflection table mode (u_lensingModel == 1): follows the exact Schwarzschild
+// orbit of the ray from the precomputed table (see DeflectionTable.hpp)
+// instead of marching it. Layout constants must match DeflectionTable.
+const float LUT_COLUMNS = 256.0;
+const float LUT_ROWS_PER_BRANCH = 256.0;
+const float LUT_CRITICAL_IMPACT = 2.5980762;
+const float LUT_MAX_IMPACT = 1000.0;
+const float LUT_CAPTURED_LIMIT = LUT_CRITICAL_IMPACT * (1.0 - 1e-4);
+const float LUT_SCATTERED_LIMIT = LUT_CRITICAL_IMPACT * (1.0 + 1e-4);
+// Chords the orbit is split into for planet intersection
+const int LUT_SEGMENTS = 24;
+
+float lutRowCoord(float impact) {
+    float last = LUT_ROWS_PER_BRANCH - 1.0;
+    float row;
+    if (impact < LUT_CRITICAL_IMPACT) {
+        float s = 1.0 - sqrt(max(0.0, 1.0 - impact / LUT_CAPTURED_LIMIT));
+        row = min(s, 1.0) * last;
+    } else {
+        float s = pow(max(0.0, impact - LUT_SCATTERED_LIMIT) / (LUT_MAX_IMPACT - LUT_SCATTERED_LIMIT), 0.25);
+        row = LUT_ROWS_PER_BRANCH + min(s, 1.0) * last;
+    }
+    return (row + 0.5) / (2.0 * LUT_ROWS_PER_BRANCH);
+}
+
+float lutPhiColumn(float x) {
+    float c = 1.0 - sqrt(max(0.0, 1.0 - x));
+    return (min(c, 1.0) * (LUT_COLUMNS - 1.0) + 0.5) / LUT_COLUMNS;
+}
+
+float lutUColumn(float t) {
+    return (clamp(t, 0.0, 1.0) * (LUT_COLUMNS - 1.0) + 0.5) / LUT_COLUMNS;
+}
+
+bool useDeflectionLut() {
+    // Inside the photon sphere outgoing rays follow orbits the table doesn't hold
+    return u_lensingModel == 1 && LENSING_ON &&
+           length(u_cameraPosition) > 1.6 * u_schwarzschildRadius;
+}
+
+// Orbit of one camera ray in its plane: position at swept angle s is
+// r(s) * (cos(s) * e1 + sin(s) * e2) with e1 pointing at the camera
+struct LutOrbit {
+    vec3 e1;
+    vec3 e2;
+    float row;
+    float phi0;
+    float phiMax;
+    float uMax;
+    bool inbound;
+    bool captured;
+    float sweep;
+};
+
+LutOrbit lutOrbit(vec3 ro, vec3 rd) {
+    LutOrbit o;
+    float rs = u_schwarzschildRadius;
+    float r0 = length(ro);
+    o.e1 = ro / r0;
+    float cosPsi = dot(rd, o.e1);
+    vec3 tangent = rd - cosPsi * o.e1;
+    float sinPsi = length(tangent);
+    o.e2 = (sinPsi > 1e-6) ? tangent / sinPsi : normalize(cross(o.e1, vec3(0.3, 1.0, 0.2)));
+
+    // Impact parameter in units of rs, from the angle a static observer sees
+    float impact = r0 * sinPsi / sqrt(max(1.0 - rs / r0, 1e-6)) / rs;
+    o.row = lutRowCoord(impact);
+    vec4 rowInfo = texture(u_deflectionLut, vec2(0.5 / LUT_COLUMNS, o.row));
+    o.phiMax = rowInfo.b;
+    o.uMax = rowInfo.a;
+    o.phi0 = texture(u_deflectionLut, vec2(lutPhiColumn((rs / r0) / o.uMax), o.row)).r;
+
+    o.inbound = cosPsi < 0.0;
+    o.captured = o.inbound && impact < LUT_CRITICAL_IMPACT;
+    if (!o.inbound) {
+        o.sweep = o.phi0;
+    } else if (o.captured) {
+        o.sweep = o.phiMax - o.phi0;
+    } else {
+        o.sweep = 2.0 * o.phiMax - o.phi0;
+    }
+    return o;
+}
+
+// Distance from the hole after sweeping s, capped at farDist
+float lutRadius(LutOrbit o, float s, float farDist) {
+    float phi = o.inbound ? o.phi0 + s : o.phi0 - s;
+    if (phi > o.phiMax) phi = 2.0 * o.phiMax - phi;
+    float x = texture(u_deflectionLut, vec2(lutUColumn(phi / o.phiMax), o.row)).g;
+    float u = x * o.uMax / u_schwarzschildRadius;
+    return min(1.0 / max(u, 1e-6), farDist);
+}
+
+vec3 rayMarchLut(vec3 rayOrigin, vec3 rayDir) {
+    vec3 accColor = vec3(0.0);
+    float transmittance = 1.0;
+    float farDist = (u_farDist > 0.0) ? u_farDist : MAX_DIST;
+    LutOrbit o = lutOrbit(rayOrigin, rayDir);
+    hitMinRadius = o.inbound ? u_schwarzschildRadius / o.uMax : length(rayOrigin);
+
+    // Swept angles where the orbit plane meets the disk plane, every PI
+    float nextCrossing = 1e9;
+    if (DISK_ON && (abs(o.e1.y) > 1e-6 || abs(o.e2.y) > 1e-6)) {
+        nextCrossing = atan(-o.e1.y, o.e2.y);
+        if (nextCrossing <= 0.0) nextCrossing += PI;
+    }
+
+    vec3 a = rayOrigin;
+    float sa = 0.0;
+    for (int i = 1; i <= LUT_SEGMENTS; i++) {
+        float sb = o.sweep * float(i) / float(LUT_SEGMENTS);
+        vec3 b = lutRadius(o, sb, farDist) * (cos(sb) * o.e1 + sin(sb) * o.e2);
+
+        // Planet hit on this chord
+        vec3 planetHit;
+        int planet;
+        float tPlanet = segmentPlanets(a, b, planetHit, planet);
+        float sEnd = (tPlanet <= 1.0) ? mix(sa, sb, tPlanet) : sb;
+
+        // Disk crossings before the planet
+        for (int k = 0; k < 4 && nextCrossing < sEnd; k++) {
+            float r_hit = lutRadius(o, nextCrossing, farDist);
+            if (r_hit > u_diskInnerRadius && r_hit < u_diskOuterRadius) {
+                vec3 hit = r_hit * (cos(nextCrossing) * o.e1 + sin(nextCrossing) * o.e2);
+                vec4 disk = getDiskSample(hit);
+                accColor += transmittance * disk.rgb;
+                transmittance *= (1.0 - disk.a);
+                if (transmittance < 0.02) {
+                    return endRay(HIT_DISK, accColor, transmittance);
+                }
             }
+            nextCrossing += PI;
         }
 
-        // Apply gravitational lensing
-        float r = length(p);
-        float distToCenterSq = max(r * r, 1e-4);
-        float stepSize = u_stepSize;
-        stepSize += stepSize * smoothstep(u_diskOuterRadius + 2.0, farDist, r) * 2.5;
-        stepSize *= 1.0 + 1.2 * smoothstep(0.5, 3.0, abs(p.y));
+        if (tPlanet <= 1.0) {
+            accColor += transmittance * shadePlanet(planetHit, planet);
+            return endRay(HIT_PLANET, accColor, transmittance);
+        }
+
+        a = b;
+        sa = sb;
+    }
+
+    if (!o.captured && STARFIELD_ON) {
+        vec3 escapeDir = cos(o.sweep) * o.e1 + sin(o.sweep) * o.e2;
+        accColor += transmittance * starField(escapeDir, u_time);
+    }
+    return endRay(o.captured ? HIT_HORIZON : HIT_SKY, accColor, transmittance);
+}
+
+// Geodesic mode (u_lensingModel == 2): integrates the photon orbit
+// x'' = -3/2 rs h^2 x / r^5 with h = |x cross x'| conserved, which traces the
+// exact Schwarzschild path, using adaptive Dormand-Prince RK45 steps: long
+// where space is nearly flat, short where the orbit bends.
+const float GEODESIC_TOLERANCE = 1e-5;
+
+bool useGeodesic() {
+    return u_lensingModel == 2 && LENSING_ON;
+}
+
+vec3 geodesicAccel(vec3 x, float k) {
+    float r2 = dot(x, x);
+    return -k * x / (r2 * r2 * sqrt(r2));
+}
+
+// One RK45 step of size h from (x, v) with a = geodesicAccel(x). Writes the
+// 5th-order result and its acceleration (reused as the next step's first
+// stage) and returns the embedded error estimate relative to the tolerance.
+float dormandPrinceStep(vec3 x, vec3 v, vec3 a, float h, float k,
+                        out vec3 xNext, out vec3 vNext, out vec3 aNext) {
+    vec3 x2 = x + h * (1.0 / 5.0) * v;
+    vec3 v2 = v + h * (1.0 / 5.0) * a;
+    vec3 a2 = geodesicAccel(x2, k);
+
+    vec3 x3 = x + h * (3.0 / 40.0 * v + 9.0 / 40.0 * v2);
+    vec3 v3 = v + h * (3.0 / 40.0 * a + 9.0 / 40.0 * a2);
+    vec3 a3 = geodesicAccel(x3, k);
+
+    vec3 x4 = x + h * (44.0 / 45.0 * v - 56.0 / 15.0 * v2 + 32.0 / 9.0 * v3);
+    vec3 v4 = v + h * (44.0 / 45.0 * a - 56.0 / 15.0 * a2 + 32.0 / 9.0 * a3);
+    vec3 a4 = geodesicAccel(x4, k);
+
+    vec3 x5 = x + h * (19372.0 / 6561.0 * v - 25360.0 / 2187.0 * v2 + 64448.0 / 6561.0 * v3 - 212.0 / 729.0 * v4);
+    vec3 v5 = v + h * (19372.0 / 6561.0 * a - 25360.0 / 2187.0 * a2 + 64448.0 / 6561.0 * a3 - 212.0 / 729.0 * a4);
+    vec3 a5 = geodesicAccel(x5, k);
+
+    vec3 x6 = x + h * (9017.0 / 3168.0 * v - 355.0 / 33.0 * v2 + 46732.0 / 5247.0 * v3 + 49.0 / 176.0 * v4
+                       - 5103.0 / 18656.0 * v5);
+    vec3 v6 = v + h * (9017.0 / 3168.0 * a - 355.0 / 33.0 * a2 + 46732.0 / 5247.0 * a3 + 49.0 / 176.0 * a4
+                       - 5103.0 / 18656.0 * a5);
+    vec3 a6 = geodesicAccel(x6, k);
+
+    xNext = x + h * (35.0 / 384.0 * v + 500.0 / 1113.0 * v3 + 125.0 / 192.0 * v4 - 2187.0 / 6784.0 * v5
+                     + 11.0 / 84.0 * v6);
+    vNext = v + h * (35.0 / 384.0 * a + 500.0 / 1113.0 * a3 + 125.0 / 192.0 * a4 - 2187.0 / 6784.0 * a5
+                     + 11.0 / 84.0 * a6);
+    aNext = geodesicAccel(xNext, k);
 
-        if (u_enableLensing == 1 && r < u_lensMaxRadius) {
-            vec3 gravityDir = (r > 1e-6) ? -p / r : vec3(0.0, 0.0, 0.0);
-            vec3 acceleration = gravityDir * (G * u_mass) / distToCenterSq;
-            rayDir = normalize(rayDir + acceleration * stepSize);
+    // Difference to the embedded 4th-order solution
+    vec3 xErr = h * (71.0 / 57600.0 * v - 71.0 / 16695.0 * v3 + 71.0 / 1920.0 * v4 - 17253.0 / 339200.0 * v5
+                     + 22.0 / 525.0 * v6 - 1.0 / 40.0 * vNext);
+    vec3 vErr = h * (71.0 / 57600.0 * a - 71.0 / 16695.0 * a3 + 71.0 / 1920.0 * a4 - 17253.0 / 339200.0 * a5
+                     + 22.0 / 525.0 * a6 - 1.0 / 40.0 * aNext);
+    return max(length(xErr) / length(x), length(vErr) / length(v)) / GEODESIC_TOLERANCE;
+}
+
+vec3 rayMarchGeodesic(vec3 rayOrigin, vec3 rayDir) {
+    vec3 accColor = vec3(0.0);
+    float transmittance = 1.0;
+    float farDist = (u_farDist > 0.0) ? u_farDist : MAX_DIST;
+
+    vec3 x = rayOrigin;
+    vec3 v = rayDir;
+    vec3 angularMomentum = cross(x, v);
+    float k = 1.5 * u_schwarzschildRadius * dot(angularMomentum, angularMomentum);
+    vec3 a = geodesicAccel(x, k);
+    float h = u_stepSize;
+
+    // Rejected steps count towards u_maxSteps too
+    for (int i = 0; i < MAX_STEPS; i++) {
+        if (i >= u_maxSteps) break;
+
+        // Never step further than half the distance to the hole
+        h = min(h, 0.5 * length(x));
+        vec3 xNext, vNext, aNext;
+        float err = dormandPrinceStep(x, v, a, h, k, xNext, vNext, aNext);
+        h *= clamp(0.9 * pow(max(err, 1e-10), -0.2), 0.2, 5.0);
+        if (err > 1.0) {
+            continue;
         }
-        p += rayDir * stepSize;
 
-        // Disk intersection
-        if (u_enableDisk == 1 && p_prev.y * p.y < 0.0) {
-            float t = -p_prev.y / (p.y - p_prev.y);
-            vec3 hit = p_prev + t * (p - p_prev);
+        // Disk crossing and planet hit on the chord, nearest first
+        vec3 planetHit;
+        int planet;
+        float tPlanet = segmentPlanets(x, xNext, planetHit, planet);
+        if (DISK_ON && x.y * xNext.y < 0.0) {
+            float t = x.y / (x.y - xNext.y);
+            vec3 hit = mix(x, xNext, t);
             float r_hit = length(hit.xz);
-            if (r_hit > u_diskInnerRadius && r_hit < u_diskOuterRadius) {
+            if (t < tPlanet && r_hit > u_diskInnerRadius && r_hit < u_diskOuterRadius) {
                 vec4 disk = getDiskSample(hit);
                 accColor += transmittance * disk.rgb;
                 transmittance *= (1.0 - disk.a);
                 if (transmittance < 0.02) {
-                    return accColor;
+                    return endRay(HIT_DISK, accColor, transmittance);
                 }
             }
         }
+        if (tPlanet <= 1.0) {
+            accColor += transmittance * shadePlanet(planetHit, planet);
+            return endRay(HIT_PLANET, accColor, transmittance);
+        }
 
-        if (length(p) > farDist) {
-            if (u_enableStarfield == 1) {
-                accColor += transmittance * starField(rayDir, u_time);
+        x = xNext;
+        v = vNext;
+        a = aNext;
+        hitMinRadius = min(hitMinRadius, length(x));
+
+        // Event horizon check
+        if (length(x) < u_schwarzschildRadius + EPSILON) {
+            return endRay(HIT_HORIZON, accColor, transmittance);
+        }
+        if (length(x) > farDist) {
+            break;
+        }
+    }
+
+    if (STARFIELD_ON) {
+        accColor += transmittance * starField(normalize(v), u_time);
+    }
+    return endRay(HIT_SKY, accColor, transmittance);
+}
+
+// Kerr mode (u_lensingModel == 3): photon orbits around a spinning hole of
+// mass M = rs / 2 and spin a = u_spin M about +y, in Boyer-Lindquist
+// coordinates mapped to space as oblate spheroids. With E = 1 the orbit is
+// fixed by the conserved L (angular momentum about the spin axis) and
+// K = Q + (L - a)^2 (Carter), and in Mino time (d tau = Sigma d lambda)
+//   r'' = R'(r) / 2,  theta'' = Theta'(theta) / 2,  phi' = Phi(r, theta)
+// are polynomials in r and cos/sin theta: no turning-point sign flips and
+// no metric or Christoffel terms per step. Integrated with classic RK4.
+struct KerrOrbit {
+    float m, a, L, K;
+};
+
+bool useKerr() {
+    return u_lensingModel == 3 && LENSING_ON;
+}
+
+// d/dlambda of (r, theta, phi, r', theta')
+void kerrDerivatives(KerrOrbit o, vec4 y, out vec4 dy, out float dPhi) {
+    float r = y.x;
+    float s = sin(y.y);
+    float c = cos(y.y);
+    s = s < 0.0 ? min(s, -1e-3) : max(s, 1e-3); // the axis is a coordinate singularity
+    float p = r * r + o.a * o.a - o.a * o.L;
+    float delta = max(r * r - 2.0 * o.m * r + o.a * o.a, 1e-4);
+    dy = vec4(y.z, y.w, 2.0 * r * p - (r - o.m) * o.K, c * (o.L * o.L / (s * s * s) - o.a * o.a * s));
+    dPhi = o.a * p / delta - o.a + o.L / (s * s);
+}
+
+// Puts r' and theta' back on sqrt(R(r)) and sqrt(Theta(theta)), keeping their
+// signs. The second-order equations alone drift off these conserved values,
+// enough to turn a ray falling straight in back out; where R or Theta went
+// negative (past a turning point) they are left to the second-order equations.
+vec4 kerrConstrain(KerrOrbit o, vec4 y) {
+    float p = y.x * y.x + o.a * o.a - o.a * o.L;
+    float radial = p * p - (y.x * y.x - 2.0 * o.m * y.x + o.a * o.a) * o.K;
+    float c2 = cos(y.y) * cos(y.y);
+    float polar = o.K - (o.L - o.a) * (o.L - o.a) + c2 * (o.a * o.a - o.L * o.L / max(1.0 - c2, 1e-6));
+    if (radial > 0.0) y.z = (y.z < 0.0 ? -1.0 : 1.0) * sqrt(radial);
+    if (polar > 0.0) y.w = (y.w < 0.0 ? -1.0 : 1.0) * sqrt(polar);
+    return y;
+}
+
+vec3 kerrToCartesian(KerrOrbit o, float r, float theta, float phi) {
+    float rho = sqrt(r * r + o.a * o.a) * sin(theta);
+    return vec3(rho * cos(phi), r * cos(theta), rho * sin(phi));
+}
+
+vec3 rayMarchKerr(vec3 rayOrigin, vec3 rayDir) {
+    vec3 accColor = vec3(0.0);
+    float transmittance = 1.0;
+    float farDist = (u_farDist > 0.0) ? u_farDist : MAX_DIST;
+
+    KerrOrbit o;
+    o.m = 0.5 * u_schwarzschildRadius;
+    o.a = u_spin * o.m;
+    float a2 = o.a * o.a;
+    float horizon = o.m + sqrt(max(o.m * o.m - a2, 0.0));
+
+    // Boyer-Lindquist position of the camera
+    vec3 x = rayOrigin;
+    float w = dot(x, x) - a2;
+    float r = sqrt(0.5 * (w + sqrt(w * w + 4.0 * a2 * x.y * x.y)));
+    if (r < horizon * 1.01) {
+        return endRay(HIT_HORIZON, accColor, transmittance);
+    }
+    float theta = acos(clamp(x.y / r, -1.0, 1.0));
+    float phi = atan(x.z, x.x);
+
+    // Coordinate velocity of the ray (the inverse Jacobian of kerrToCartesian)
+    float s = max(sin(theta), 1e-3);
+    float c = cos(theta);
+    float rho = sqrt(r * r + a2);
+    float sigma = r * r + a2 * c * c;
+    float horizontal = cos(phi) * rayDir.x + sin(phi) * rayDir.z;
+    float tangential = cos(phi) * rayDir.z - sin(phi) * rayDir.x;
+    float dr = rho * (r * s * horizontal + rho * c * rayDir.y) / sigma;
+    float dTheta = (rho * c * horizontal - r * s * rayDir.y) / sigma;
+    float dPhi = tangential / (rho * s);
+
+    // dt from the null condition, then E, L and Q from the metric
+    float delta = r * r - 2.0 * o.m * r + a2;
+    float gtt = min(-(1.0 - 2.0 * o.m * r / sigma), -1e-4);
+    float gtphi = -2.0 * o.m * o.a * r * s * s / sigma;
+    float gphiphi = (r * r + a2 + 2.0 * o.m * a2 * r * s * s / sigma) * s * s;
+    float spatial = gphiphi * dPhi * dPhi + sigma / delta * dr * dr + sigma * dTheta * dTheta;
+    float dt = (-gtphi * dPhi - sqrt(max(gtphi * gtphi * dPhi * dPhi - gtt * spatial, 0.0))) / gtt;
+    float energy = -(gtt * dt + gtphi * dPhi);
+    o.L = (gtphi * dt + gphiphi * dPhi) / energy;
+    vec4 y = vec4(r, theta, sigma * dr / energy, sigma * dTheta / energy);
+    o.K = y.w * y.w + c * c * (o.L * o.L / (s * s) - a2) + (o.L - o.a) * (o.L - o.a);
+
+    for (int i = 0; i < MAX_STEPS; i++) {
+        if (i >= u_maxSteps) break;
+
+        // Spatial step grows with r and never crosses the horizon in one go;
+        // |dx / dlambda| ~ r^2 + a^2 away from the hole
+        float ds = min(max(u_stepSize, 0.1 * y.x), max(y.x - horizon, 0.02 * o.m));
+        float h = ds / (y.x * y.x + a2);
+        // Near the axis theta turns and phi sweeps by ~pi within a few
+        // hundredths of a radian; keep both changes a fraction of sin(theta)
+        float axis = max(abs(sin(y.y)), 0.02);
+        h = min(h, 0.2 * axis / (abs(y.w) + abs(o.L) / axis));
+
+        vec4 k1, k2, k3, k4;
+        float f1, f2, f3, f4;
+        kerrDerivatives(o, y, k1, f1);
+        kerrDerivatives(o, y + 0.5 * h * k1, k2, f2);
+        kerrDerivatives(o, y + 0.5 * h * k2, k3, f3);
+        kerrDerivatives(o, y + h * k3, k4, f4);
+        vec4 yNext = kerrConstrain(o, y + h / 6.0 * (k1 + 2.0 * k2 + 2.0 * k3 + k4));
+        float phiNext = phi + h / 6.0 * (f1 + 2.0 * f2 + 2.0 * f3 + f4);
+        vec3 xNext = kerrToCartesian(o, yNext.x, yNext.y, phiNext);
+
+        // Disk crossing and planet hit on the chord, nearest first. The disk
+        // is the equatorial plane, where the Boyer-Lindquist r is sqrt(x^2 + z^2 - a^2)
+        vec3 planetHit;
+        int planet;
+        float tPlanet = segmentPlanets(x, xNext, planetHit, planet);
+        if (DISK_ON && x.y * xNext.y < 0.0) {
+            float t = x.y / (x.y - xNext.y);
+            vec3 hit = mix(x, xNext, t);
+            float r_hit = sqrt(max(dot(hit.xz, hit.xz) - a2, 0.0));
+            if (t < tPlanet && r_hit > u_diskInnerRadius && r_hit < u_diskOuterRadius) {
+                vec4 disk = getDiskSample(hit);
+                accColor += transmittance * disk.rgb;
+                transmittance *= (1.0 - disk.a);
+                if (transmittance < 0.02) {
+                    return endRay(HIT_DISK, accColor, transmittance);
+                }
             }
-            return accColor;
+        }
+        if (tPlanet <= 1.0) {
+            accColor += transmittance * shadePlanet(planetHit, planet);
+            return endRay(HIT_PLANET, accColor, transmittance);
+        }
+
+        rayDir = xNext - x;
+        x = xNext;
+        y = yNext;
+        phi = phiNext;
+        hitMinRadius = min(hitMinRadius, length(x));
+
+        // Event horizon check
+        if (y.x < horizon * 1.01) {
+            return endRay(HIT_HORIZON, accColor, transmittance);
+        }
+        if (y.x > farDist) {
+            break;
         }
     }
 
-    if (u_enableStarfield == 1) {
-        accColor += transmittance * starField(rayDir, u_time);
+    if (STARFIELD_ON) {
+        accColor += transmittance * starField(normalize(rayDir), u_time);
     }
-    return accColor;
+    return endRay(HIT_SKY, accColor, transmittance);
 }
 
-void main() {
-    vec2 uv = (gl_FragCoord.xy - 0.5 * u_resolution.xy) / u_resolution.y;
+// Binet mode (u_lensingModel == 4): a Schwarzschild ray never leaves the
+// plane through the hole spanned by its start point and direction, so it is
+// integrated there as u(s) = 1 / r over the swept angle s with the Binet
+// equation u'' + u = 3 M u^2 = 3/2 rs u^2 (classic RK4 on (u, u')). The
+// orbit is smooth in s, so steps stay long right up to the photon sphere,
+// and disk crossings are found analytically as in the table mode.
+bool useBinet() {
+    return u_lensingModel == 4 && LENSING_ON;
+}
+
+vec2 binetDerivative(vec2 y, float rs) {
+    return vec2(y.y, 1.5 * rs * y.x * y.x - y.x);
+}
+
+vec3 rayMarchBinet(vec3 rayOrigin, vec3 rayDir) {
+    vec3 accColor = vec3(0.0);
+    float transmittance = 1.0;
+    float farDist = (u_farDist > 0.0) ? u_farDist : MAX_DIST;
+    float rs = u_schwarzschildRadius;
+
+    // Orbit plane: position at swept angle s is (cos(s) * e1 + sin(s) * e2) / u(s)
+    float r0 = length(rayOrigin);
+    vec3 e1 = rayOrigin / r0;
+    float cosPsi = dot(rayDir, e1);
+    vec3 tangent = rayDir - cosPsi * e1;
+    float sinPsi = length(tangent);
+    vec3 e2 = (sinPsi > 1e-6) ? tangent / sinPsi : normalize(cross(e1, vec3(0.3, 1.0, 0.2)));
+    vec2 y = vec2(1.0 / r0, -cosPsi / (r0 * max(sinPsi, 1e-6)));
+    hitMinRadius = r0;
+
+    // Swept angles where the orbit plane meets the disk plane, every PI
+    float nextCrossing = 1e9;
+    if (DISK_ON && (abs(e1.y) > 1e-6 || abs(e2.y) > 1e-6)) {
+        nextCrossing = atan(-e1.y, e2.y);
+        if (nextCrossing <= 0.0) nextCrossing += PI;
+    }
+
+    vec3 a = rayOrigin;
+    float s = 0.0;
+    for (int i = 0; i < MAX_STEPS; i++) {
+        if (i >= u_maxSteps) break;
+
+        // Chord of about max(stepSize, r / 4), at most 2 * stepSize radians
+        float r = 1.0 / y.x;
+        float h = min(2.0 * u_stepSize, max(u_stepSize, 0.25 * r) * y.x * y.x / length(y));
+        vec2 k1 = binetDerivative(y, rs);
+        vec2 k2 = binetDerivative(y + 0.5 * h * k1, rs);
+        vec2 k3 = binetDerivative(y + 0.5 * h * k2, rs);
+        vec2 k4 = binetDerivative(y + h * k3, rs);
+        vec2 yNext = y + h / 6.0 * (k1 + 2.0 * k2 + 2.0 * k3 + k4);
+        float sNext = s + h;
+        vec3 b = (cos(sNext) * e1 + sin(sNext) * e2) / max(yNext.x, 1.0 / farDist);
+
+        // Planet hit on this chord
+        vec3 planetHit;
+        int planet;
+        float tPlanet = segmentPlanets(a, b, planetHit, planet);
+        float sEnd = (tPlanet <= 1.0) ? mix(s, sNext, tPlanet) : sNext;
+
+        // Disk crossing before the planet; u there from the cubic Hermite
+        // through both ends of the step
+        if (nextCrossing < sEnd) {
+            float t = (nextCrossing - s) / h;
+            float t2 = t * t;
+            float t3 = t2 * t;
+            float u = (2.0 * t3 - 3.0 * t2 + 1.0) * y.x + (t3 - 2.0 * t2 + t) * h * y.y +
+                      (3.0 * t2 - 2.0 * t3) * yNext.x + (t3 - t2) * h * yNext.y;
+            float r_hit = 1.0 / max(u, 1e-6);
+            if (r_hit > u_diskInnerRadius && r_hit < u_diskOuterRadius) {
+                vec3 hit = r_hit * (cos(nextCrossing) * e1 + sin(nextCrossing) * e2);
+                vec4 disk = getDiskSample(hit);
+                accColor += transmittance * disk.rgb;
+                transmittance *= (1.0 - disk.a);
+                if (transmittance < 0.02) {
+                    return endRay(HIT_DISK, accColor, transmittance);
+                }
+            }
+            nextCrossing += PI;
+        }
+
+        if (tPlanet <= 1.0) {
+            accColor += transmittance * shadePlanet(planetHit, planet);
+            return endRay(HIT_PLANET, accColor, transmittance);
+        }
+
+        a = b;
+        s = sNext;
+        y = yNext;
+        hitMinRadius = min(hitMinRadius, 1.0 / max(y.x, 1e-6));
+
+        // Event horizon check
+        if (y.x * (rs + EPSILON) > 1.0) {
+            return endRay(HIT_HORIZON, accColor, transmittance);
+        }
+        if (y.x * farDist < 1.0) {
+            break;
+        }
+    }
+
+    if (STARFIELD_ON) {
+        // Direction of travel, d/ds of the position
+        vec3 radial = cos(s) * e1 + sin(s) * e2;
+        vec3 along = cos(s) * e2 - sin(s) * e1;
+        accColor += transmittance * starField(normalize(y.x * along - y.y * radial), u_time);
+    }
+    return endRay(HIT_SKY, accColor, transmittance);
+}
+
+vec3 traceRay(vec3 rayOrigin, vec3 rayDir) {
+    if (useBinet()) {
+        return rayMarchBinet(rayOrigin, rayDir);
+    }
+    if (useKerr()) {
+        return rayMarchKerr(rayOrigin, rayDir);
+    }
+    if (useGeodesic()) {
+        return rayMarchGeodesic(rayOrigin, rayDir);
+    }
+    if (useDeflectionLut()) {
+        return rayMarchLut(rayOrigin, rayDir);
+    }
+    return rayMarch(rayOrigin, rayDir);
+}
+
+// World-space direction of the camera ray through a point of the image
+vec3 primaryRay(vec2 fragCoord) {
+    vec2 uv = (fragCoord - 0.5 * u_resolution.xy) / u_resolution.y;
     vec3 rayDir = normalize(vec3(uv, -1.0));
-    rayDir = (u_invViewMatrix * vec4(rayDir, 0.0)).xyz;
+    return (u_invViewMatrix * vec4(rayDir, 0.0)).xyz;
+}
+
+// Highlight boost and gamma applied to the traced color
+vec4 finishColor(vec3 color) {
+    float l = dot(color, vec3(0.21, 0.72, 0.07));
+    color += color * l * 0.3;
+    color = pow(color, vec3(0.4545));
+    return vec4(color, 1.0);
+}
+
+// Final color of the ray through a point of the full-resolution image
+vec4 shadePixel(vec2 fragCoord) {
+    vec3 rayDir = primaryRay(fragCoord);
 
     // Early-out: starfield only, no marching needed
-    if (u_enableStarfield == 1 && u_enablePlanets == 0 && u_enableDisk == 0 && u_enableLensing == 0) {
+    if (STARFIELD_ON && !PLANETS_ON && !DISK_ON && !LENSING_ON) {
         vec3 bg = starField(rayDir, u_time);
         bg = pow(bg, vec3(0.4545));
-        FragColor = vec4(bg, 1.0);
-        return;
+        return vec4(bg, 1.0);
     }
 
     // If literally everything is off, return black
-    if (u_enableStarfield == 0 && u_enablePlanets == 0 && u_enableDisk == 0 && u_enableLensing == 0) {
-        FragColor = vec4(0.0);
+    if (!STARFIELD_ON && !PLANETS_ON && !DISK_ON && !LENSING_ON) {
+        return vec4(0.0);
+    }
+
+    return finishColor(traceRay(u_cameraPosition, rayDir));
+}
+
+#if defined(RECONSTRUCT) || defined(TEMPORAL_RESOLVE)
+uniform sampler2D u_blockColor; // MARCH_STRIDE-reduced HIT_INFO pass
+uniform sampler2D u_blockInfo;
+#endif
+
+#ifdef RECONSTRUCT
+
+// Neighbouring blocks disagree when a silhouette (horizon, planet limb, disk
+// edge) runs between them, or when the rays pass close enough to the hole
+// that the lensed sky changes faster than the block spacing
+bool blocksDisagree(vec4 a, vec4 b, vec4 c, vec4 d) {
+    vec4 types = vec4(a.x, b.x, c.x, d.x);
+    if (any(notEqual(types, vec4(a.x)))) return true;
+    vec4 coverage = vec4(a.y, b.y, c.y, d.y);
+    float minCoverage = min(min(coverage.x, coverage.y), min(coverage.z, coverage.w));
+    float maxCoverage = max(max(coverage.x, coverage.y), max(coverage.z, coverage.w));
+    if (maxCoverage - minCoverage > 0.1) return true;
+    vec4 radius = vec4(a.z, b.z, c.z, d.z);
+    float minRadius = min(min(radius.x, radius.y), min(radius.z, radius.w));
+    float maxRadius = max(max(radius.x, radius.y), max(radius.z, radius.w));
+    return minRadius < 4.0 * u_schwarzschildRadius && maxRadius - minRadius > 0.25 * minRadius;
+}
+
+// Interpolated block color, or discard where the pixel needs its own ray
+vec4 reconstruct() {
+    ivec2 blocks = (ivec2(u_resolution) + MARCH_STRIDE - 1) / MARCH_STRIDE;
+    vec2 q = gl_FragCoord.xy / float(MARCH_STRIDE) - 0.5;
+    ivec2 base = ivec2(floor(q));
+    vec2 f = q - vec2(base);
+    ivec2 i00 = clamp(base, ivec2(0), blocks - 1);
+    ivec2 i11 = clamp(base + 1, ivec2(0), blocks - 1);
+    ivec2 i10 = ivec2(i11.x, i00.y);
+    ivec2 i01 = ivec2(i00.x, i11.y);
+
+    if (blocksDisagree(texelFetch(u_blockInfo, i00, 0), texelFetch(u_blockInfo, i10, 0),
+                       texelFetch(u_blockInfo, i01, 0), texelFetch(u_blockInfo, i11, 0))) {
+        discard;
+    }
+    return mix(mix(texelFetch(u_blockColor, i00, 0), texelFetch(u_blockColor, i10, 0), f.x),
+               mix(texelFetch(u_blockColor, i01, 0), texelFetch(u_blockColor, i11, 0), f.x), f.y);
+}
+#endif
+
+#ifdef TEMPORAL_RESOLVE
+uniform sampler2D u_historyColor; // previous frame, full resolution
+uniform sampler2D u_historyInfo;
+uniform mat4 u_previousView;      // view matrix the history was rendered with
+
+// Same test as blocksDisagree, for one pair of rays
+bool hitsAgree(vec4 a, vec4 b) {
+    if (a.x != b.x || abs(a.y - b.y) > 0.1) return false;
+    float minRadius = min(a.z, b.z);
+    return minRadius >= 4.0 * u_schwarzschildRadius || abs(a.z - b.z) <= 0.25 * minRadius;
+}
+
+// Where the ray's content sits for reprojection: unbent sky at infinity
+// (w = 0), disk hits in the disk plane, and whatever the hole bends or
+// swallows at the ray's closest approach to it, so the lensed image moves
+// with the hole rather than with the stars
+vec4 reprojectionPoint(vec3 rayDir, vec4 info) {
+    if (info.x == float(HIT_SKY) && info.z >= u_lensMaxRadius) return vec4(rayDir, 0.0);
+    float depth = dot(-u_cameraPosition, rayDir);
+    if (info.x == float(HIT_DISK) && rayDir.y * u_cameraPosition.y < 0.0) {
+        depth = -u_cameraPosition.y / rayDir.y;
+    }
+    return vec4(u_cameraPosition + rayDir * max(depth, u_schwarzschildRadius), 1.0);
+}
+
+// Fresh ray for this frame's quarter of the pixels, the reprojected history
+// for the rest, or discard where the history shows something the four
+// nearest fresh rays don't (disocclusion, fast lensing change, off screen)
+vec4 resolveTemporal(out vec4 info) {
+    ivec2 blocks = (ivec2(u_resolution) + MARCH_STRIDE - 1) / MARCH_STRIDE;
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 offset = ivec2(u_subsetOffset);
+    ivec2 own = pixel / MARCH_STRIDE;
+    info = texelFetch(u_blockInfo, own, 0);
+    if (pixel - own * MARCH_STRIDE == offset) {
+        return texelFetch(u_blockColor, own, 0);
+    }
+
+    vec4 view = u_previousView * reprojectionPoint(primaryRay(gl_FragCoord.xy), info);
+    if (view.z >= 0.0) discard;
+    vec2 previous = view.xy / -view.z * u_resolution.y + 0.5 * u_resolution.xy;
+    if (any(lessThan(previous, vec2(0.0))) || any(greaterThanEqual(previous, u_resolution.xy))) discard;
+    ivec2 source = ivec2(previous);
+    vec4 history = texelFetch(u_historyInfo, source, 0);
+
+    ivec2 base = (pixel - offset) >> 1;
+    ivec2 i00 = clamp(base, ivec2(0), blocks - 1);
+    ivec2 i11 = clamp(base + 1, ivec2(0), blocks - 1);
+    if (!hitsAgree(history, texelFetch(u_blockInfo, i00, 0)) &&
+        !hitsAgree(history, texelFetch(u_blockInfo, ivec2(i11.x, i00.y), 0)) &&
+        !hitsAgree(history, texelFetch(u_blockInfo, ivec2(i00.x, i11.y), 0)) &&
+        !hitsAgree(history, texelFetch(u_blockInfo, i11, 0))) {
+        discard;
+    }
+    info = history;
+    return texelFetch(u_historyColor, source, 0);
+}
+#endif
+
+#ifdef COMPUTE
+// Dispatch size (x, y) that covers a queue of 'count' rays. Both grow with
+// the count, so atomicMax of each keeps the header covering every ray.
+uvec2 queueGroups(uint count) {
+    uint groups = (count + 63u) / 64u;
+    uint maxX = uint(u_maxGroupsX);
+    return uvec2(min(groups, maxX), (groups + maxX - 1u) / maxX);
+}
+
+// Queue entry of this march invocation, across both dispatch dimensions
+uint queueIndex() {
+    return (gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x) * 64u + gl_LocalInvocationIndex;
+}
+
+// True when the camera ray stays outside sceneRadius(), where rayMarch sends
+// it straight to the sky. The other lensing models bend rays at any distance.
+bool rayMissesScene(vec3 rayDir) {
+    if (LENSING_ON && u_lensingModel != 0) {
+        return false;
+    }
+    float t = max(-dot(u_cameraPosition, rayDir), 0.0);
+    return length(u_cameraPosition + t * rayDir) > sceneRadius();
+}
+#endif
+
+#ifdef COMPUTE_CLASSIFY
+layout(local_size_x = 8, local_size_y = 8) in;
+
+shared uint tileCount;
+shared uint tileBase;
+shared uint tileRays[64];
+
+void main() {
+    if (gl_LocalInvocationIndex == 0u) {
+        tileCount = 0u;
+    }
+    barrier();
+
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (all(lessThan(vec2(pixel), u_resolution))) {
+        vec2 fragCoord = vec2(pixel) + 0.5;
+        vec3 rayDir = primaryRay(fragCoord);
+        if (!PLANETS_ON && !DISK_ON && !LENSING_ON) {
+            imageStore(u_output, pixel, shadePixel(fragCoord));
+        } else if (rayMissesScene(rayDir)) {
+            imageStore(u_output, pixel, finishColor(STARFIELD_ON ? starField(rayDir, u_time) : vec3(0.0)));
+        } else {
+            tileRays[atomicAdd(tileCount, 1u)] = uint(pixel.x) | (uint(pixel.y) << 16);
+        }
+    }
+    barrier();
+
+    // The tile's survivors go to the queue contiguously
+    if (gl_LocalInvocationIndex == 0u && tileCount > 0u) {
+        tileBase = atomicAdd(queueCount, tileCount);
+        uvec2 groups = queueGroups(tileBase + tileCount);
+        atomicMax(queueGroupsX, groups.x);
+        atomicMax(queueGroupsY, groups.y);
+    }
+    barrier();
+    if (gl_LocalInvocationIndex < tileCount) {
+        queueRays[tileBase + gl_LocalInvocationIndex] = tileRays[gl_LocalInvocationIndex];
+    }
+}
+#elif defined(COMPUTE_MARCH)
+layout(local_size_x = 64) in;
+
+void main() {
+    uint index = queueIndex();
+    if (index >= queueCount) {
         return;
     }
+    uint ray = queueRays[index];
+    ivec2 pixel = ivec2(ray & 0xffffu, ray >> 16);
+    imageStore(u_output, pixel, shadePixel(vec2(pixel) + 0.5));
+}
+#elif defined(COMPUTE_MARCH_PASS)
+layout(local_size_x = 64) in;
 
-    vec3 color = rayMarch(u_cameraPosition, rayDir);
-    float l = dot(color, vec3(0.21, 0.72, 0.07));
-    color += color * l * 0.3;
-    color = pow(color, vec3(0.4545));
-    FragColor = vec4(color, 1.0);
+// Rays this pass leaves unfinished, laid out like RayQueue
+layout(std430, binding = 1) buffer NextQueue {
+    uint nextGroupsX;
+    uint nextGroupsY;
+    uint nextGroupsZ;
+    uint nextCount;
+    uint nextRays[];
+};
+// Where each unfinished ray stopped, by pixel; color and transmittance as halves
+struct MarchState {
+    vec3 position;
+    uint colorRG;
+    vec3 direction;
+    uint colorBT;
+};
+layout(std430, binding = 2) buffer MarchStates {
+    MarchState marchStates[];
+};
+uniform int u_marchPass; // passes run before this one
+
+shared uint groupCount;
+shared uint groupBase;
+shared uint groupRays[64];
+
+void main() {
+    if (gl_LocalInvocationIndex == 0u) {
+        groupCount = 0u;
+    }
+    barrier();
+
+    uint index = queueIndex();
+    if (index < queueCount) {
+        uint ray = queueRays[index];
+        ivec2 pixel = ivec2(ray & 0xffffu, ray >> 16);
+        uint slot = uint(pixel.y) * uint(u_resolution.x) + uint(pixel.x);
+        float farDist = (u_farDist > 0.0) ? u_farDist : MAX_DIST;
+        float reach = sceneRadius();
+
+        vec3 p = u_cameraPosition;
+        vec3 rayDir = primaryRay(vec2(pixel) + 0.5);
+        vec3 accColor = vec3(0.0);
+        float transmittance = 1.0;
+        if (u_marchPass == 0) {
+            // Classification only queued rays that enter the sphere
+            enterScene(p, rayDir, reach);
+        } else {
+            MarchState state = marchStates[slot];
+            p = state.position;
+            rayDir = state.direction;
+            vec2 bt = unpackHalf2x16(state.colorBT);
+            accColor = vec3(unpackHalf2x16(state.colorRG), bt.x);
+            transmittance = bt.y;
+        }
+
+        int steps = min(u_maxSteps, MAX_STEPS);
+        int last = min((u_marchPass + 1) * MARCH_PASS_STEPS, steps);
+        bool ended = false;
+        for (int i = u_marchPass * MARCH_PASS_STEPS; i < last && !ended; i++) {
+            ended = marchStep(p, rayDir, accColor, transmittance, reach, farDist);
+        }
+        // Out of steps: the sky, as after the rayMarch loop
+        if (!ended && last == steps) {
+            if (STARFIELD_ON) {
+                accColor += transmittance * starField(rayDir, u_time);
+            }
+            ended = true;
+        }
+
+        if (ended) {
+            imageStore(u_output, pixel, finishColor(accColor));
+        } else {
+            marchStates[slot] = MarchState(p, packHalf2x16(accColor.rg), rayDir,
+                                           packHalf2x16(vec2(accColor.b, transmittance)));
+            groupRays[atomicAdd(groupCount, 1u)] = ray;
+        }
+    }
+    barrier();
+
+    // The group's unfinished rays go to the next queue contiguously
+    if (gl_LocalInvocationIndex == 0u && groupCount > 0u) {
+        groupBase = atomicAdd(nextCount, groupCount);
+        uvec2 groups = queueGroups(groupBase + groupCount);
+        atomicMax(nextGroupsX, groups.x);
+        atomicMax(nextGroupsY, groups.y);
+    }
+    barrier();
+    if (gl_LocalInvocationIndex < groupCount) {
+        nextRays[groupBase + gl_LocalInvocationIndex] = groupRays[gl_LocalInvocationIndex];
+    }
+}
+#elif defined(BAKE_SKY)
+uniform int u_bakeFace;   // GL_TEXTURE_CUBE_MAP_POSITIVE_X + u_bakeFace
+uniform int u_bakeLayer;  // 0 stars, 1 nebula
+uniform float u_bakeSize; // face size in texels
+
+// Direction through a cubemap face texel, (s, t) in [-1, 1] as in the GL spec
+vec3 cubeDirection(int face, vec2 st) {
+    if (face == 0) return vec3(1.0, -st.y, -st.x);
+    if (face == 1) return vec3(-1.0, -st.y, st.x);
+    if (face == 2) return vec3(st.x, 1.0, st.y);
+    if (face == 3) return vec3(st.x, -1.0, -st.y);
+    if (face == 4) return vec3(st.x, -st.y, 1.0);
+    return vec3(-st.x, -st.y, -1.0);
+}
+
+// Stars are far smaller than a texel: 2x2 samples per texel keep the faint
+// ones from vanishing between texel centres
+void main() {
+    if (u_bakeLayer == 1) {
+        FragColor = vec4(nebulaLayer(normalize(cubeDirection(u_bakeFace, gl_FragCoord.xy / u_bakeSize * 2.0 - 1.0))), 1.0);
+        return;
+    }
+    vec3 color = vec3(0.0);
+    float brightest = -1.0;
+    float seed = 0.0;
+    for (int i = 0; i < 4; i++) {
+        vec2 at = gl_FragCoord.xy + (vec2(i & 1, i >> 1) - 0.5) * 0.5;
+        vec4 stars = starLayer(normalize(cubeDirection(u_bakeFace, at / u_bakeSize * 2.0 - 1.0)));
+        color += 0.25 * stars.rgb;
+        float luminance = dot(stars.rgb, vec3(0.21, 0.72, 0.07));
+        if (luminance > brightest) {
+            brightest = luminance;
+            seed = stars.a;
+        }
+    }
+    FragColor = vec4(color, seed);
+}
+#else
+void main() {
+#if defined(RECONSTRUCT)
+    FragColor = reconstruct();
+#elif defined(TEMPORAL_RESOLVE)
+    FragColor = resolveTemporal(HitInfo);
+#else
+#ifdef TEMPORAL
+    // One ray through pixel u_subsetOffset of each 2x2 block
+    FragColor = shadePixel(floor(gl_FragCoord.xy) * float(MARCH_STRIDE) + u_subsetOffset + 0.5);
+#else
+    // One ray through the centre of each MARCH_STRIDE x MARCH_STRIDE block
+    FragColor = shadePixel(gl_FragCoord.xy * float(MARCH_STRIDE));
+#endif
+#ifdef HIT_INFO
+    HitInfo = vec4(float(hitType), hitCoverage, hitMinRadius, 0.0);
+#endif
+#endif
+}
+#endif
+)glsl";
+
+
+// Stretches the part of a render target the ray march drew (u_sourceSize
+// texels from the origin) over the whole viewport with bilinear filtering.
+// Reuses BLACKHOLE_VERT_SRC for the fullscreen quad.
+static auto UPSAMPLE_FRAG_SRC = R"glsl(
+#version 330 core
+
+out vec4 FragColor;
+
+uniform sampler2D u_source;
+uniform vec2 u_sourceSize;   // texels the ray march covered
+uniform vec2 u_outputSize;   // viewport size
+
+void main() {
+    vec2 texSize = vec2(textureSize(u_source, 0));
+    // Keep the bilinear footprint inside the drawn area, never the stale texels past it
+    vec2 texel = clamp(gl_FragCoord.xy / u_outputSize * u_sourceSize, vec2(0.5), u_sourceSize - 0.5);
+    FragColor = texture(u_source, texel / texSize);
 }
 )glsl";
 
+
+// Splats StarCatalog stars into a face of the sky star cubemap as additive
+// Gaussian points (GpuRenderer::loadStarCatalog / splatStars), one draw per
+// tile. Writes what the BAKE_SKY star layer does: linear color, twinkle seed
+// in alpha.
+static auto CATALOG_VERT_SRC = R"glsl(
+#version 330 core
+
+layout (location = 0) in vec2 a_tilePosition; // StarCatalog::Star s, t
+layout (location = 1) in float a_magnitude;   // 1/1000ths
+layout (location = 2) in float a_color;       // B-V over COLOR_MIN..COLOR_MAX
+
+uniform vec2 u_tileOrigin; // face coordinates of the tile's corner
+uniform float u_tileSize;  // tile edge in face coordinates
+uniform float u_pointSize; // splat diameter in texels
+
+out vec3 v_color;
+out float v_seed;
+
+// Linear intensity of a magnitude 0 star
+const float STAR_INTENSITY = 1.0;
+const float COLOR_MIN = -0.4;
+const float COLOR_MAX = 2.0;
+
+// Blue-white through Sun-like to orange, the procedural sky's palette
+vec3 starColor(float bv) {
+    vec3 hot = vec3(0.75, 0.86, 1.0);
+    vec3 sun = vec3(1.0, 0.92, 0.86);
+    vec3 cool = vec3(1.0, 0.7, 0.45);
+    return bv < 0.6 ? mix(hot, sun, clamp((bv + 0.3) / 0.9, 0.0, 1.0))
+                    : mix(sun, cool, clamp((bv - 0.6) / 1.4, 0.0, 1.0));
+}
+
+void main() {
+    vec2 st = u_tileOrigin + a_tilePosition * u_tileSize;
+    gl_Position = vec4(st, 0.0, 1.0);
+    gl_PointSize = u_pointSize;
+    float intensity = STAR_INTENSITY * pow(10.0, -0.4 * a_magnitude / 1000.0);
+    v_color = intensity * starColor(mix(COLOR_MIN, COLOR_MAX, a_color));
+    v_seed = fract(sin(dot(st, vec2(12.9898, 78.233))) * 43758.5453);
+}
+)glsl";
+
+static auto CATALOG_FRAG_SRC = R"glsl(
+#version 330 core
+
+in vec3 v_color;
+in float v_seed;
+out vec4 FragColor;
+
+void main() {
+    vec2 d = gl_PointCoord * 2.0 - 1.0;
+    FragColor = vec4(v_color * exp(-4.0 * dot(d, d)), v_seed);
+}
+)glsl";
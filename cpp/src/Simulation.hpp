@@ -0,0 +1,191 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "Math.hpp"
+
+// How rays are bent when lensing is on
+enum class LensingModel : int {
+    Marched = 0,         // per-step nudge towards the mass (rayMarch)
+    DeflectionTable = 1, // precomputed Schwarzschild orbits (rayMarchLut)
+    Geodesic = 2,        // adaptive RK45 Schwarzschild geodesics (rayMarchGeodesic)
+    Kerr = 3,            // RK4 Kerr geodesics around a spinning hole (rayMarchKerr)
+    Binet = 4,           // RK4 Binet equation in each ray's orbit plane (rayMarchBinet)
+};
+constexpr int LENSING_MODEL_COUNT = 5;
+
+inline const char *lensingModelName(const LensingModel model) {
+    switch (model) {
+        case LensingModel::Marched: return "marched";
+        case LensingModel::DeflectionTable: return "table";
+        case LensingModel::Geodesic: return "rk45";
+        case LensingModel::Kerr: return "kerr";
+        case LensingModel::Binet: return "binet";
+    }
+    return "?";
+}
+
+// A body on a circular orbit in the disk plane, lit by the hole
+struct Planet {
+    float orbitRadius;
+    float speed; // radians per second
+    float phase; // orbit angle at time 0
+    float radius;
+    Vec3 color;
+    float bands; // 0 solid color, 1 gas giant noise stripes
+};
+
+// Planets the shaders take per frame (MAX_PLANETS in BLACKHOLE_FRAG_SRC)
+constexpr int MAX_PLANETS = 32;
+
+// The rocky planet and the gas giant
+inline std::vector<Planet> defaultPlanets() {
+    return {
+        {18.0f, 0.1f, 0.0f, 0.4f, Vec3(0.8f, 0.3f, 0.1f), 0.0f},
+        {30.0f, 0.05f, 2.5f, 1.0f, Vec3(0.3f, 0.4f, 0.7f), 1.0f},
+    };
+}
+
+// A small body (asteroid, debris) on a circular orbit parallel to the disk
+// plane. There can be thousands; the shaders find them through BodyGrid
+// instead of looping over them like the planets.
+struct Body {
+    float orbitRadius;
+    float speed; // radians per second
+    float phase; // orbit angle at time 0
+    float height; // orbit plane offset from the disk plane
+    float radius;
+    Vec3 color;
+};
+
+// Simulation parameters
+struct SimParams {
+    float mass = 1.0f;
+    float diskOuter = 8.0f;
+    float spin = 0.0f; // a/M of the Kerr model, 0 to MAX_SPIN
+    bool starfieldOn = true;
+    bool planetsOn = true;
+    bool diskOn = true;
+    bool lensingOn = true;
+    LensingModel lensingModel = LensingModel::Marched;
+    std::vector<Planet> planets = defaultPlanets(); // first MAX_PLANETS are drawn
+    std::vector<Body> bodies;                       // drawn through a BodyGrid, with the planets
+};
+
+// Thorne's limit for accreting holes; at a = M the horizon degenerates
+constexpr float MAX_SPIN = 0.998f;
+
+// Prograde innermost stable circular orbit of a Kerr hole, in units of M
+// (Bardeen, Press & Teukolsky 1972): 6 without spin, 1.24 at MAX_SPIN
+inline float kerrIscoRadius(const float spin) {
+    const float z1 = 1.0f + std::cbrt(1.0f - spin * spin) * (std::cbrt(1.0f + spin) + std::cbrt(1.0f - spin));
+    const float z2 = std::sqrt(3.0f * spin * spin + z1 * z1);
+    return 3.0f + z2 - std::sqrt((3.0f - z1) * (3.0f + z1 + 2.0f * z2));
+}
+
+class BodyGrid;
+
+// A planet where it is at the frame time
+struct PlanetInstance {
+    Vec3 position;
+    float radius;
+    Vec3 color;
+    float bands;
+};
+
+// Everything BLACKHOLE_FRAG_SRC reads from its uniforms, in declaration order.
+// The GPU path uploads these, the CPU renderer consumes them directly.
+struct FrameUniforms {
+    float resolution[2] = {0.0f, 0.0f};
+    float time = 0.0f;
+    Mat4 invViewMatrix;
+    Vec3 cameraPosition;
+    float mass = 1.0f;
+    float schwarzschildRadius = 1.0f;
+    float diskInnerRadius = 1.5f;
+    float diskOuterRadius = 8.0f;
+    bool enableStarfield = true;
+    bool enablePlanets = true;
+    bool enableDisk = true;
+    bool enableLensing = true;
+    float stepSize = 0.25f;
+    int maxSteps = 220;
+    float farDist = 100.0f;
+    float lensMaxRadius = 22.0f;
+    LensingModel lensingModel = LensingModel::Marched;
+    float spin = 0.0f;
+    int planetCount = 0;
+    float planetReach = 0.0f;     // outermost orbit plus its planet's radius, small bodies included
+    float planetMaxRadius = 0.0f; // largest planet; all of them touch the disk plane only within it
+    PlanetInstance planets[MAX_PLANETS];
+    const BodyGrid *bodies = nullptr; // set by BodyGrid::attach, never empty; null without small bodies
+};
+
+// Feature bits of FEATURE_MASK in BLACKHOLE_FRAG_SRC; one shader permutation per mask
+constexpr unsigned int FEATURE_STARFIELD = 1;
+constexpr unsigned int FEATURE_PLANETS = 2;
+constexpr unsigned int FEATURE_DISK = 4;
+constexpr unsigned int FEATURE_LENSING = 8;
+constexpr unsigned int FEATURE_BODIES = 16; // small bodies in a BodyGrid, with the planets
+constexpr unsigned int FEATURE_PERMUTATIONS = 32;
+
+inline unsigned int featureMask(const FrameUniforms &u) {
+    return (u.enableStarfield ? FEATURE_STARFIELD : 0) | (u.enablePlanets ? FEATURE_PLANETS : 0) |
+           (u.enableDisk ? FEATURE_DISK : 0) | (u.enableLensing ? FEATURE_LENSING : 0) |
+           (u.enablePlanets && u.bodies ? FEATURE_BODIES : 0);
+}
+
+// fps <= 0 disables the FPS-based step adjustment (offline/CPU renders)
+inline FrameUniforms makeFrameUniforms(const Camera &camera, const SimParams &params, const float time,
+                                       const int width, const int height, const float fps) {
+    FrameUniforms u;
+    u.resolution[0] = static_cast<float>(width);
+    u.resolution[1] = static_cast<float>(height);
+    u.time = time;
+    u.invViewMatrix = camera.getInverseViewMatrix();
+    u.cameraPosition = camera.position;
+
+    u.mass = params.mass;
+    u.schwarzschildRadius = params.mass;
+    u.diskInnerRadius = 1.5f * params.mass;
+    if (params.lensingModel == LensingModel::Kerr) {
+        // The disk ends where frame dragging lets orbits stay stable; mass is
+        // rs, so M = mass / 2
+        u.diskInnerRadius = 0.5f * params.mass * kerrIscoRadius(params.spin);
+    }
+    u.diskOuterRadius = params.diskOuter;
+    u.enableStarfield = params.starfieldOn;
+    u.enablePlanets = params.planetsOn;
+    u.enableDisk = params.diskOn;
+    u.enableLensing = params.lensingOn;
+
+    // Adaptive marching parameters (optimized based on features enabled)
+    float baseStep = params.lensingOn ? 0.25f : 0.45f;
+    if (!params.diskOn) baseStep *= 1.15f;
+    if (!params.planetsOn) baseStep *= 1.15f;
+
+    // Dynamic FPS-based optimization
+    if (fps > 0.0f) {
+        if (fps < 30.0f) baseStep *= 1.2f;
+        else if (fps > 55.0f) baseStep *= 0.9f;
+    }
+    u.stepSize = std::max(0.15f, std::min(0.8f, baseStep));
+
+    u.maxSteps = params.lensingOn ? 220 : 120;
+    u.farDist = 100.0f;
+    u.lensMaxRadius = params.lensingOn ? (params.diskOuter * 2.0f + 6.0f) : 0.0f;
+    u.lensingModel = params.lensingModel;
+    u.spin = std::clamp(params.spin, 0.0f, MAX_SPIN);
+
+    u.planetCount = std::min(static_cast<int>(params.planets.size()), MAX_PLANETS);
+    for (int i = 0; i < u.planetCount; i++) {
+        const Planet &planet = params.planets[i];
+        const float angle = time * planet.speed + planet.phase;
+        u.planets[i] = {Vec3(std::cos(angle), 0.0f, std::sin(angle)) * planet.orbitRadius, planet.radius,
+                        planet.color, planet.bands};
+        u.planetReach = std::max(u.planetReach, planet.orbitRadius + planet.radius);
+        u.planetMaxRadius = std::max(u.planetMaxRadius, planet.radius);
+    }
+    return u;
+}
@@ -0,0 +1,195 @@
+#include "SkyCubemap.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include "CpuShaders.hpp"
+#include "ThreadPool.hpp"
+
+namespace {
+
+// Direction through a face point, (s, t) in [-1, 1]: cubeDirection in BLACKHOLE_FRAG_SRC
+Vec3 cubeDirection(const int face, const float s, const float t) {
+    switch (face) {
+        case 0: return Vec3(1.0f, -t, -s);
+        case 1: return Vec3(-1.0f, -t, s);
+        case 2: return Vec3(s, 1.0f, t);
+        case 3: return Vec3(s, -1.0f, -t);
+        case 4: return Vec3(s, -t, 1.0f);
+        default: return Vec3(-s, -t, -1.0f);
+    }
+}
+
+// Face a direction selects and its texture coordinates in [0, 1], as in the
+// GL spec's cube map face selection table
+int cubeFace(const Vec3 &rd, float &s, float &t) {
+    const float ax = std::abs(rd.x);
+    const float ay = std::abs(rd.y);
+    const float az = std::abs(rd.z);
+    int face;
+    float ma, sc, tc;
+    if (ax >= ay && ax >= az) {
+        face = rd.x > 0.0f ? 0 : 1;
+        ma = ax;
+        sc = rd.x > 0.0f ? -rd.z : rd.z;
+        tc = -rd.y;
+    } else if (ay >= az) {
+        face = rd.y > 0.0f ? 2 : 3;
+        ma = ay;
+        sc = rd.x;
+        tc = rd.y > 0.0f ? rd.z : -rd.z;
+    } else {
+        face = rd.z > 0.0f ? 4 : 5;
+        ma = az;
+        sc = rd.z > 0.0f ? rd.x : -rd.x;
+        tc = -rd.y;
+    }
+    s = 0.5f * (sc / ma + 1.0f);
+    t = 0.5f * (tc / ma + 1.0f);
+    return face;
+}
+
+} // namespace
+
+const SkyCubemap &SkyCubemap::instance(ThreadPool *pool) {
+    static const SkyCubemap sky = [pool] {
+        if (pool) {
+            return SkyCubemap(*pool);
+        }
+        ThreadPool own;
+        return SkyCubemap(own);
+    }();
+    return sky;
+}
+
+const SkyCubemap &SkyCubemap::get(ThreadPool &pool) {
+    return instance(&pool);
+}
+
+const SkyCubemap &SkyCubemap::get() {
+    return instance(nullptr);
+}
+
+SkyCubemap::SkyCubemap(ThreadPool &pool) {
+    const auto texel = [](Level &level, const int face, const int x, const int y) {
+        return &level.texels[((static_cast<std::size_t>(face) * level.size + y) * level.size + x) * 4];
+    };
+
+    // Stars: the mean of 2x2 samples per texel, alpha the twinkle seed of the
+    // brightest, one task per face row
+    Level &base = starLevels.emplace_back();
+    base.size = STARS_SIZE;
+    base.texels.resize(6 * static_cast<std::size_t>(STARS_SIZE) * STARS_SIZE * 4);
+    pool.parallelFor(6 * STARS_SIZE, [&](const std::size_t row) {
+        const int face = static_cast<int>(row) / STARS_SIZE;
+        const int y = static_cast<int>(row) % STARS_SIZE;
+        for (int x = 0; x < STARS_SIZE; x++) {
+            Vec3 color;
+            float brightest = -1.0f;
+            float seed = 0.0f;
+            for (int i = 0; i < 4; i++) {
+                const float s = (static_cast<float>(x) + 0.5f + (static_cast<float>(i & 1) - 0.5f) * 0.5f) / STARS_SIZE;
+                const float t = (static_cast<float>(y) + 0.5f + (static_cast<float>(i >> 1) - 0.5f) * 0.5f) / STARS_SIZE;
+                float starSeed;
+                const Vec3 stars = cpu::starLayer(cubeDirection(face, s * 2.0f - 1.0f, t * 2.0f - 1.0f).normalize(),
+                                                  starSeed);
+                color += stars * 0.25f;
+                if (const float luminance = stars.dot(Vec3(0.21f, 0.72f, 0.07f)); luminance > brightest) {
+                    brightest = luminance;
+                    seed = starSeed;
+                }
+            }
+            float *out = texel(base, face, x, y);
+            out[0] = color.x;
+            out[1] = color.y;
+            out[2] = color.z;
+            out[3] = seed;
+        }
+    });
+
+    // Mip chain: every texel the mean of the 2x2 below it
+    while (starLevels.back().size > 1) {
+        Level &above = starLevels.back();
+        Level level;
+        level.size = above.size / 2;
+        level.texels.resize(6 * static_cast<std::size_t>(level.size) * level.size * 4);
+        pool.parallelFor(6 * static_cast<std::size_t>(level.size), [&](const std::size_t row) {
+            const int face = static_cast<int>(row) / level.size;
+            const int y = static_cast<int>(row) % level.size;
+            for (int x = 0; x < level.size; x++) {
+                float *out = texel(level, face, x, y);
+                for (int c = 0; c < 4; c++) {
+                    out[c] = 0.25f * (texel(above, face, 2 * x, 2 * y)[c] + texel(above, face, 2 * x + 1, 2 * y)[c] +
+                                      texel(above, face, 2 * x, 2 * y + 1)[c] +
+                                      texel(above, face, 2 * x + 1, 2 * y + 1)[c]);
+                }
+            }
+        });
+        starLevels.push_back(std::move(level));
+    }
+
+    // Nebula: one sample per texel, no mips
+    nebulaLevel.size = NEBULA_SIZE;
+    nebulaLevel.texels.resize(6 * static_cast<std::size_t>(NEBULA_SIZE) * NEBULA_SIZE * 4);
+    pool.parallelFor(6 * NEBULA_SIZE, [&](const std::size_t row) {
+        const int face = static_cast<int>(row) / NEBULA_SIZE;
+        const int y = static_cast<int>(row) % NEBULA_SIZE;
+        for (int x = 0; x < NEBULA_SIZE; x++) {
+            const float s = (static_cast<float>(x) + 0.5f) / NEBULA_SIZE * 2.0f - 1.0f;
+            const float t = (static_cast<float>(y) + 0.5f) / NEBULA_SIZE * 2.0f - 1.0f;
+            const Vec3 nebula = cpu::nebulaLayer(cubeDirection(face, s, t).normalize());
+            float *out = texel(nebulaLevel, face, x, y);
+            out[0] = nebula.x;
+            out[1] = nebula.y;
+            out[2] = nebula.z;
+            out[3] = 1.0f;
+        }
+    });
+}
+
+void SkyCubemap::sample(const Level &level, const int face, const float s, const float t, float texel[4]) {
+    const float x = s * static_cast<float>(level.size) - 0.5f;
+    const float y = t * static_cast<float>(level.size) - 0.5f;
+    const int x0 = static_cast<int>(std::floor(x));
+    const int y0 = static_cast<int>(std::floor(y));
+    const float fx = x - static_cast<float>(x0);
+    const float fy = y - static_cast<float>(y0);
+    const auto at = [&](const int tx, const int ty) {
+        const int cx = std::clamp(tx, 0, level.size - 1);
+        const int cy = std::clamp(ty, 0, level.size - 1);
+        return &level.texels[((static_cast<std::size_t>(face) * level.size + cy) * level.size + cx) * 4];
+    };
+    const float *a = at(x0, y0);
+    const float *b = at(x0 + 1, y0);
+    const float *c = at(x0, y0 + 1);
+    const float *d = at(x0 + 1, y0 + 1);
+    for (int k = 0; k < 4; k++) {
+        texel[k] = glsl::mix(glsl::mix(a[k], b[k], fx), glsl::mix(c[k], d[k], fx), fy);
+    }
+}
+
+Vec3 SkyCubemap::stars(const Vec3 &rd, const float lod, float &seed) const {
+    float s, t;
+    const int face = cubeFace(rd, s, t);
+    const float clamped = std::clamp(lod, 0.0f, static_cast<float>(starLevels.size() - 1));
+    const int level = static_cast<int>(clamped);
+    const float blend = clamped - static_cast<float>(level);
+    float texel[4];
+    sample(starLevels[level], face, s, t, texel);
+    if (blend > 0.0f) {
+        float next[4];
+        sample(starLevels[level + 1], face, s, t, next);
+        for (int k = 0; k < 4; k++) {
+            texel[k] = glsl::mix(texel[k], next[k], blend);
+        }
+    }
+    seed = texel[3];
+    return Vec3(texel[0], texel[1], texel[2]);
+}
+
+Vec3 SkyCubemap::nebula(const Vec3 &rd) const {
+    float s, t;
+    const int face = cubeFace(rd, s, t);
+    float texel[4];
+    sample(nebulaLevel, face, s, t, texel);
+    return Vec3(texel[0], texel[1], texel[2]);
+}
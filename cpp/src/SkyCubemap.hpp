@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+#include "Math.hpp"
+
+class ThreadPool;
+
+// CPU copy of the background sky cubemaps GpuRenderer::bakeSky renders
+// (BAKE_SKY in BLACKHOLE_FRAG_SRC), so cpu::starField looks the sky up like
+// the GPU does instead of evaluating it per ray. Faces and texel directions
+// follow the GL cube map convention; the star layer gets the 2x2 box mip
+// chain glGenerateMipmap builds.
+class SkyCubemap {
+public:
+    // Face sizes, shared with GpuRenderer: about 8 texels per star cell at the
+    // equator for the stars, far more than enough for the smooth nebula
+    static constexpr int STARS_SIZE = 1024;
+    static constexpr int NEBULA_SIZE = 128;
+
+    // The shared cubemaps, baked on 'pool' on first use (about 20 s of CPU
+    // time); call it before starting parallel work that reads them
+    static const SkyCubemap &get(ThreadPool &pool);
+    // Same, baking on a pool of its own if nothing has baked them yet
+    static const SkyCubemap &get();
+
+    // Trilinear star lookup at mip level 'lod' (textureLod on a
+    // GL_LINEAR_MIPMAP_LINEAR cubemap): linear color, the twinkle seed is
+    // written to 'seed'
+    Vec3 stars(const Vec3 &rd, float lod, float &seed) const;
+    // Bilinear nebula lookup
+    [[nodiscard]] Vec3 nebula(const Vec3 &rd) const;
+
+private:
+    // One mip level of all six faces: RGBA texels, face by face, row 0 first
+    struct Level {
+        int size = 0;
+        std::vector<float> texels;
+    };
+
+    explicit SkyCubemap(ThreadPool &pool);
+    static const SkyCubemap &instance(ThreadPool *pool);
+    // Bilinear lookup in one level, clamped at the face edges (the GPU
+    // filters across them, so only the outermost half texel can differ)
+    static void sample(const Level &level, int face, float s, float t, float texel[4]);
+
+    std::vector<Level> starLevels;
+    Level nebulaLevel;
+};
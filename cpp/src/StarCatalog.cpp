@@ -0,0 +1,158 @@
+#include "StarCatalog.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+StarCatalog::~StarCatalog() {
+    close();
+}
+
+bool StarCatalog::open(const std::string& path) {
+    close();
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Cannot open star catalog " << path << std::endl;
+        return false;
+    }
+    struct stat info {};
+    if (fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) < sizeof(Header)) {
+        std::cerr << "Star catalog " << path << " is too short" << std::endl;
+        ::close(fd);
+        return false;
+    }
+    mappingSize = static_cast<std::size_t>(info.st_size);
+    mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        mapping = nullptr;
+        std::cerr << "Cannot map star catalog " << path << std::endl;
+        return false;
+    }
+
+    // Every size below comes from the file, so check them before trusting any
+    header = static_cast<const Header*>(mapping);
+    const std::uint64_t tiles = 6ull * header->tilesPerFace * header->tilesPerFace;
+    const std::uint64_t tableBytes = (tiles + 1) * sizeof(std::uint64_t);
+    const bool valid = std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) == 0 && header->tilesPerFace > 0 &&
+                       header->tilesPerFace <= 4096 && header->starCount <= mappingSize / sizeof(Star) &&
+                       sizeof(Header) + tableBytes + header->starCount * sizeof(Star) == mappingSize;
+    if (!valid) {
+        std::cerr << "Star catalog " << path << " is not a valid catalog file" << std::endl;
+        close();
+        return false;
+    }
+    const auto* bytes = static_cast<const unsigned char*>(mapping);
+    tileStart = reinterpret_cast<const std::uint64_t*>(bytes + sizeof(Header));
+    stars = reinterpret_cast<const Star*>(bytes + sizeof(Header) + tableBytes);
+    if (tileStart[0] != 0 || tileStart[tiles] != header->starCount ||
+        !std::is_sorted(tileStart, tileStart + tiles + 1)) {
+        std::cerr << "Star catalog " << path << " has a corrupt tile table" << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+void StarCatalog::close() {
+    if (mapping) {
+        munmap(mapping, mappingSize);
+    }
+    mapping = nullptr;
+    mappingSize = 0;
+    header = nullptr;
+    tileStart = nullptr;
+    stars = nullptr;
+}
+
+std::span<const StarCatalog::Star> StarCatalog::tile(const int index) const {
+    if (!header || index < 0 || index >= tileCount()) return {};
+    return {stars + tileStart[index], stars + tileStart[index + 1]};
+}
+
+// Inverse of the face directions in the GL spec's cube map table (and of
+// cubeDirection in BLACKHOLE_FRAG_SRC)
+void StarCatalog::faceCoord(const Vec3& d, int& face, float& s, float& t) {
+    const float ax = std::abs(d.x);
+    const float ay = std::abs(d.y);
+    const float az = std::abs(d.z);
+    if (ax >= ay && ax >= az) {
+        face = d.x > 0.0f ? 0 : 1;
+        s = (d.x > 0.0f ? -d.z : d.z) / ax;
+        t = -d.y / ax;
+    } else if (ay >= az) {
+        face = d.y > 0.0f ? 2 : 3;
+        s = d.x / ay;
+        t = (d.y > 0.0f ? d.z : -d.z) / ay;
+    } else {
+        face = d.z > 0.0f ? 4 : 5;
+        s = (d.z > 0.0f ? d.x : -d.x) / az;
+        t = -d.y / az;
+    }
+}
+
+bool StarCatalog::write(const std::string& path, const std::vector<Entry>& entries, const int tilesPerFace) {
+    const int n = tilesPerFace;
+    const std::size_t tiles = 6ull * n * n;
+
+    // Tile and packed star of every entry
+    std::vector<std::uint32_t> tileOf(entries.size());
+    std::vector<Star> packed(entries.size());
+    for (std::size_t i = 0; i < entries.size(); i++) {
+        int face = 0;
+        float s = 0.0f, t = 0.0f;
+        faceCoord(entries[i].direction, face, s, t);
+        const float fx = std::clamp((s + 1.0f) * 0.5f * n, 0.0f, n - 1e-4f);
+        const float fy = std::clamp((t + 1.0f) * 0.5f * n, 0.0f, n - 1e-4f);
+        const int tx = static_cast<int>(fx);
+        const int ty = static_cast<int>(fy);
+        tileOf[i] = static_cast<std::uint32_t>((face * n + ty) * n + tx);
+
+        Star& star = packed[i];
+        star.s = static_cast<std::uint16_t>(std::min((fx - tx) * 65536.0f, 65535.0f));
+        star.t = static_cast<std::uint16_t>(std::min((fy - ty) * 65536.0f, 65535.0f));
+        star.magnitude = static_cast<std::int16_t>(std::clamp(std::lround(entries[i].magnitude * 1000.0f), -32768L,
+                                                              32767L));
+        const float color = (entries[i].colorIndex - COLOR_MIN) / (COLOR_MAX - COLOR_MIN);
+        star.color = static_cast<std::uint8_t>(std::lround(std::clamp(color, 0.0f, 1.0f) * 255.0f));
+        star.reserved = 0;
+    }
+
+    // Group by tile, brightest first inside each
+    std::vector<std::size_t> order(entries.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](const std::size_t a, const std::size_t b) {
+        if (tileOf[a] != tileOf[b]) return tileOf[a] < tileOf[b];
+        return packed[a].magnitude < packed[b].magnitude;
+    });
+
+    std::vector<std::uint64_t> tileStart(tiles + 1, 0);
+    for (const std::uint32_t tile : tileOf) {
+        tileStart[tile + 1]++;
+    }
+    std::partial_sum(tileStart.begin(), tileStart.end(), tileStart.begin());
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Cannot write star catalog " << path << std::endl;
+        return false;
+    }
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.tilesPerFace = static_cast<std::uint32_t>(n);
+    header.starCount = entries.size();
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(tileStart.data()),
+               static_cast<std::streamsize>(tileStart.size() * sizeof(std::uint64_t)));
+    for (const std::size_t i : order) {
+        file.write(reinterpret_cast<const char*>(&packed[i]), sizeof(Star));
+    }
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "Math.hpp"
+
+// Binary star catalog for the baked sky (GpuRenderer::loadStarCatalog).
+// The sky is split into tilesPerFace^2 tiles on each cube face, in the GL
+// cubemap face order and orientation; stars are stored grouped by tile,
+// brightest first, 8 bytes each. Layout (little-endian):
+//   Header
+//   uint64 tileStart[tileCount + 1]   index of each tile's first star
+//   Star   stars[starCount]
+// The file is memory-mapped, so opening it costs nothing however large it
+// is and only the pages a consumer reads are loaded.
+class StarCatalog {
+public:
+    static constexpr char MAGIC[8] = {'B', 'H', 'S', 'T', 'A', 'R', 'S', '1'};
+
+    struct Header {
+        char magic[8];
+        std::uint32_t tilesPerFace;
+        std::uint32_t reserved;
+        std::uint64_t starCount;
+    };
+
+    struct Star {
+        std::uint16_t s;         // position inside the tile, 1/65536ths
+        std::uint16_t t;
+        std::int16_t magnitude;  // apparent magnitude, 1/1000ths
+        std::uint8_t color;      // B-V index, COLOR_MIN..COLOR_MAX over 0..255
+        std::uint8_t reserved;
+    };
+    static_assert(sizeof(Star) == 8);
+
+    static constexpr float COLOR_MIN = -0.4f;
+    static constexpr float COLOR_MAX = 2.0f;
+
+    // One catalog entry before packing
+    struct Entry {
+        Vec3 direction; // unit vector, +Y towards the celestial north pole
+        float magnitude;
+        float colorIndex;
+    };
+
+    StarCatalog() = default;
+    ~StarCatalog();
+    StarCatalog(const StarCatalog&) = delete;
+    StarCatalog& operator=(const StarCatalog&) = delete;
+
+    // Maps and validates a file written by write(); false with a message on errors
+    bool open(const std::string& path);
+    void close();
+
+    [[nodiscard]] int tilesPerFace() const { return header ? static_cast<int>(header->tilesPerFace) : 0; }
+    [[nodiscard]] int tileCount() const { return 6 * tilesPerFace() * tilesPerFace(); }
+    [[nodiscard]] std::uint64_t starCount() const { return header ? header->starCount : 0; }
+    // Stars of one tile, brightest first; tiles of face f are f * tilesPerFace^2 onwards, row by row
+    [[nodiscard]] std::span<const Star> tile(int index) const;
+
+    // Cubemap face and face coordinates in [-1, 1] of a direction (GL conventions)
+    static void faceCoord(const Vec3& direction, int& face, float& s, float& t);
+    // Sorts and packs the entries into a catalog file
+    static bool write(const std::string& path, const std::vector<Entry>& entries, int tilesPerFace);
+
+private:
+    void* mapping = nullptr;
+    std::size_t mappingSize = 0;
+    const Header* header = nullptr;
+    const std::uint64_t* tileStart = nullptr;
+    const Star* stars = nullptr;
+};
@@ -0,0 +1,78 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // The caller of parallelFor is the last worker
+    workers.reserve(threadCount - 1);
+    for (unsigned i = 1; i < threadCount; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    wakeWorkers.notify_all();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(const std::size_t count, const std::function<void(std::size_t)> &task) {
+    if (count == 0) return;
+
+    if (workers.empty() || count == 1) {
+        for (std::size_t i = 0; i < count; i++) task(i);
+        return;
+    }
+
+    {
+        std::lock_guard lock(mutex);
+        job = &task;
+        jobCount = count;
+        nextIndex.store(0, std::memory_order_relaxed);
+        activeWorkers = static_cast<unsigned>(workers.size());
+        generation++;
+    }
+    wakeWorkers.notify_all();
+
+    runTasks();
+
+    std::unique_lock lock(mutex);
+    jobDone.wait(lock, [this] { return activeWorkers == 0; });
+    job = nullptr;
+}
+
+void ThreadPool::workerLoop() {
+    unsigned seenGeneration = 0;
+    while (true) {
+        {
+            std::unique_lock lock(mutex);
+            wakeWorkers.wait(lock, [&] { return stopping || generation != seenGeneration; });
+            if (stopping) return;
+            seenGeneration = generation;
+        }
+
+        runTasks();
+
+        std::lock_guard lock(mutex);
+        if (--activeWorkers == 0) {
+            jobDone.notify_one();
+        }
+    }
+}
+
+void ThreadPool::runTasks() {
+    const std::function<void(std::size_t)> &task = *job;
+    for (std::size_t i = nextIndex.fetch_add(1, std::memory_order_relaxed); i < jobCount;
+         i = nextIndex.fetch_add(1, std::memory_order_relaxed)) {
+        task(i);
+    }
+}
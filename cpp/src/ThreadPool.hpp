@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent worker pool for data-parallel CPU work. parallelFor hands out
+// indices from a shared atomic counter, so uneven items (tiles that hit the
+// disk vs. empty sky) balance themselves across cores.
+class ThreadPool {
+public:
+    // threadCount == 0 uses one thread per hardware core
+    explicit ThreadPool(unsigned threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    [[nodiscard]] unsigned size() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+    // Runs task(i) for every i in [0, count) and blocks until all are done.
+    // The calling thread participates; task must be safe to call concurrently.
+    void parallelFor(std::size_t count, const std::function<void(std::size_t)> &task);
+
+private:
+    void workerLoop();
+    void runTasks();
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wakeWorkers;
+    std::condition_variable jobDone;
+
+    const std::function<void(std::size_t)> *job = nullptr;
+    std::size_t jobCount = 0;
+    std::atomic<std::size_t> nextIndex{0};
+    unsigned generation = 0;
+    unsigned activeWorkers = 0;
+    bool stopping = false;
+};
@@ -3,9 +3,22 @@
 #include <GLFW/glfw3.h>
 #include <chrono>
 #include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <memory>
+#include <string>
 #include "Shader.hpp"
 #include "Math.hpp"
-#include "ShadersEmbedded.hpp"
+#include "Simulation.hpp"
+#include "BodyGrid.hpp"
+#include "CpuRenderer.hpp"
+#include "FrameCapture.hpp"
+#include "FrameProfiler.hpp"
+#include "GpuRenderer.hpp"
+#include "HeadlessContext.hpp"
+#include "OfflineRender.hpp"
+#include "RenderTarget.hpp"
+#include "ResolutionController.hpp"
 
 // Global state
 Camera camera;
@@ -13,18 +26,13 @@ bool mousePressed = false;
 double lastMouseX = 0.0, lastMouseY = 0.0;
 
 // Simulation parameters
-struct SimParams {
-    float mass = 1.0f;
-    float diskOuter = 8.0f;
-    bool starfieldOn = true;
-    bool planetsOn = true;
-    bool diskOn = true;
-    bool lensingOn = true;
-} params;
+SimParams params;
 
 // FPS tracking
 float fps = 0.0f;
 int frameCount = 0;
+FrameProfiler* profiler = nullptr;
+ResolutionController* resolution = nullptr;
 auto lastFPSTime = std::chrono::high_resolution_clock::now();
 
 void framebuffer_size_callback(GLFWwindow* /*window*/, const int width, const int height) {
@@ -77,6 +85,16 @@ void key_callback(GLFWwindow* window, const int key, int /*scancode*/, const int
             case GLFW_KEY_4:
                 params.lensingOn = !params.lensingOn;
                 break;
+            case GLFW_KEY_P:
+                if (profiler) {
+                    std::cout << std::endl;
+                    profiler->printReport(std::cout);
+                }
+                break;
+            case GLFW_KEY_L:
+                params.lensingModel = static_cast<LensingModel>(
+                    (static_cast<int>(params.lensingModel) + 1) % LENSING_MODEL_COUNT);
+                break;
             case GLFW_KEY_EQUAL:
             case GLFW_KEY_KP_ADD:
                 params.mass = std::min(5.0f, params.mass + 0.1f);
@@ -85,6 +103,12 @@ void key_callback(GLFWwindow* window, const int key, int /*scancode*/, const int
             case GLFW_KEY_KP_SUBTRACT:
                 params.mass = std::max(0.1f, params.mass - 0.1f);
                 break;
+            case GLFW_KEY_PERIOD:
+                params.spin = std::min(MAX_SPIN, params.spin + 0.1f);
+                break;
+            case GLFW_KEY_COMMA:
+                params.spin = std::max(0.0f, params.spin - 0.1f);
+                break;
             case GLFW_KEY_RIGHT_BRACKET:
                 params.diskOuter = std::min(30.0f, params.diskOuter + 0.5f);
                 break;
@@ -102,6 +126,7 @@ void updateFPS() {
 
     if (const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - lastFPSTime); duration.count() >= 1000) {
         fps = static_cast<float>(frameCount) / (static_cast<float>(duration.count()) / 1000.0f);
+        const int intervalFrames = frameCount;
         frameCount = 0;
         lastFPSTime = currentTime;
 
@@ -111,11 +136,239 @@ void updateFPS() {
                   << " | Disk: " << std::setprecision(1) << params.diskOuter
                   << " | Features: " << (params.starfieldOn ? "S" : "-")
                   << (params.planetsOn ? "P" : "-") << (params.diskOn ? "D" : "-")
-                  << (params.lensingOn ? "L" : "-") << std::flush;
+                  << (params.lensingOn ? "L" : "-")
+                  << " | Lensing: " << lensingModelName(params.lensingModel);
+        if (params.lensingModel == LensingModel::Kerr) {
+            std::cout << " | Spin: " << std::setprecision(2) << params.spin;
+        }
+        if (profiler) {
+            // Over the frames of this interval
+            const FrameProfiler::Stats gpu = profiler->stats(FrameProfiler::Gpu, intervalFrames);
+            std::cout << " | GPU: " << std::setprecision(2) << gpu.avg << " ms (p99 " << gpu.p99 << ")";
+        }
+        if (resolution) {
+            std::cout << " | Scale: " << std::setprecision(0) << resolution->scale() * 100.0f << "%";
+        }
+        std::cout << "   " << std::flush;
     }
 }
 
-int main(int /*argc*/, char* /*argv*/[]) {
+// Whole number of at least 'minimum' from a command line argument; prints
+// the problem and returns false on bad input
+static bool parseWholeArgument(const char* text, const char* what, const long minimum, int& value) {
+    char* end = nullptr;
+    const long number = std::strtol(text, &end, 10);
+    if (end == text || *end != '\0' || number < minimum || number > INT_MAX) {
+        std::cerr << "Invalid " << what << " '" << text << "'" << std::endl;
+        return false;
+    }
+    value = static_cast<int>(number);
+    return true;
+}
+
+// Headless reference render on the CPU, optionally with an asteroid belt:
+// blackhole --cpu <output.ppm> [width height [avx512|avx2|scalar|reference [belt count]]] [options]
+// The options are the camera and simulation ones of --render, so every
+// lensing model has a CPU reference for the GPU frame --render draws.
+int renderCpuFrame(const int argc, char* argv[]) {
+    // Positional arguments end at the first option
+    int positional = 3;
+    while (positional < argc && std::string(argv[positional]).rfind("--", 0) != 0) {
+        positional++;
+    }
+    OfflineOptions options;
+    if (argc < 3 || positional == 4 || positional > 7 ||
+        (positional >= 5 && (!parseWholeArgument(argv[3], "width", 1, options.width) ||
+                             !parseWholeArgument(argv[4], "height", 1, options.height)))) {
+        std::cerr << "Usage: " << argv[0] << " --cpu <output.ppm> [width height [kernel [belt]]] [options]\n"
+                  << "  options: the camera and simulation options of --render" << std::endl;
+        return -1;
+    }
+    const std::string outputPath = argv[2];
+    if (positional >= 7) {
+        int beltCount = 0;
+        if (!parseWholeArgument(argv[6], "belt count", 0, beltCount)) {
+            return -1;
+        }
+        options.params.bodies = asteroidBelt(beltCount);
+    }
+    if (!parseOfflineOptions(argc, argv, positional, options)) {
+        printOfflineUsage(argv[0]);
+        return -1;
+    }
+    if (options.frames != 1 || options.orbitSpeed != 0.0 || options.marchStride != 1 || options.temporal ||
+        options.compute || !options.starCatalog.empty() || !options.outputDirectory.empty()) {
+        std::cerr << "--cpu renders a single frame; it only takes the camera and simulation options of --render"
+                  << std::endl;
+        return -1;
+    }
+    const int width = options.width;
+    const int height = options.height;
+
+    BodyGrid bodies;
+    const FrameUniforms uniforms = offlineFrameUniforms(options, 0, bodies);
+
+    const PacketKernel* kernel = &bestPacketKernel();
+    if (positional >= 6) {
+        const std::string kernelName = argv[5];
+        kernel = kernelName == "reference" ? nullptr : findPacketKernel(kernelName);
+        if (!kernel && kernelName != "reference") {
+            std::cerr << "Packet kernel '" << kernelName << "' is not available on this CPU" << std::endl;
+            return -1;
+        }
+    }
+
+    CpuRenderer renderer(0, kernel);
+    Image image;
+    const auto start = std::chrono::high_resolution_clock::now();
+    renderer.render(uniforms, image);
+    const float ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    std::cout << "Rendered " << width << "x" << height << " on " << renderer.threadCount() << " threads ("
+              << (kernel ? kernel->name : "reference") << ") in " << std::fixed << std::setprecision(1) << ms
+              << " ms" << std::endl;
+
+    if (!writePPM(outputPath, image)) {
+        std::cerr << "Failed to write " << outputPath << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// Offscreen GPU render without a window or display server (EGL, e.g. llvmpipe):
+// blackhole --headless <output.ppm> [width height]
+int renderHeadlessFrame(const int argc, char* argv[]) {
+    int width = 1280;
+    int height = 720;
+    if (argc < 3 || argc == 4 ||
+        (argc >= 5 && (!parseWholeArgument(argv[3], "width", 1, width) ||
+                       !parseWholeArgument(argv[4], "height", 1, height)))) {
+        std::cerr << "Usage: " << argv[0] << " --headless <output.ppm> [width height]" << std::endl;
+        return -1;
+    }
+    const std::string outputPath = argv[2];
+
+    HeadlessContext context;
+    if (!context.create()) {
+        return -1;
+    }
+    if (!loadOpenGLFunctions(HeadlessContext::procLoader())) {
+        std::cerr << "Failed to load OpenGL functions" << std::endl;
+        return -1;
+    }
+    std::cout << "OpenGL: " << glGetString(GL_RENDERER) << std::endl;
+
+    const RenderTarget target(width, height);
+    if (!target.complete()) {
+        std::cerr << "Failed to create a " << width << "x" << height << " render target" << std::endl;
+        return -1;
+    }
+
+    camera.updatePosition();
+    const FrameUniforms uniforms = makeFrameUniforms(camera, params, 0.0f, width, height, 0.0f);
+
+    GpuRenderer renderer;
+    Image image;
+    const auto start = std::chrono::high_resolution_clock::now();
+    target.bind();
+    renderer.render(uniforms);
+    target.read(image);
+    const float ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    std::cout << "Rendered " << width << "x" << height << " offscreen in " << std::fixed << std::setprecision(1) << ms
+              << " ms" << std::endl;
+
+    if (!writePPM(outputPath, image)) {
+        std::cerr << "Failed to write " << outputPath << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+int main(const int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--cpu") {
+        return renderCpuFrame(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--headless") {
+        return renderHeadlessFrame(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--render") {
+        OfflineOptions options;
+        if (!parseOfflineOptions(argc, argv, 2, options)) {
+            printOfflineUsage(argv[0]);
+            return -1;
+        }
+        return runOfflineRender(options);
+    }
+
+    // --profile <report.json>: dump frame timings when the window closes
+    // --capture <directory> [--format png|ppm|raw]: save every frame
+    // --target-ms <ms>: GPU frame time the dynamic resolution aims for
+    // --fixed-resolution: always ray march at the window resolution
+    // --march-stride 2|4: one ray per 2x2 / 4x4 block plus edge re-marching
+    //                     (replaces dynamic resolution)
+    // --temporal: march a rotating quarter of the pixels and reproject the
+    //             previous frame for the rest (replaces dynamic resolution)
+    // --compute: compute shader path with ray compaction, when the driver has
+    //            OpenGL 4.3 (replaces dynamic resolution)
+    // --stars <catalog.bin>: real sky from a blackhole_starcatalog file
+    // --planets <list.txt>: planets from a file (see loadPlanets)
+    // --belt <count>: asteroid belt of that many small bodies
+    ResolutionController::Settings resolutionSettings;
+    bool dynamicResolution = true;
+    int marchStride = 1;
+    bool temporal = false;
+    bool compute = false;
+    std::string starCatalogPath;
+    std::string profilePath;
+    std::string capturePath;
+    FrameCapture::Format captureFormat = FrameCapture::Format::Png;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--profile" && i + 1 < argc) {
+            profilePath = argv[++i];
+        } else if (arg == "--capture" && i + 1 < argc) {
+            capturePath = argv[++i];
+        } else if (arg == "--target-ms" && i + 1 < argc) {
+            resolutionSettings.targetMs = std::atof(argv[++i]);
+            if (resolutionSettings.targetMs <= 0.0) {
+                std::cerr << "Invalid frame time target '" << argv[i] << "'" << std::endl;
+                return -1;
+            }
+        } else if (arg == "--fixed-resolution") {
+            dynamicResolution = false;
+        } else if (arg == "--march-stride" && i + 1 < argc) {
+            marchStride = std::atoi(argv[++i]);
+            if (marchStride != 1 && marchStride != 2 && marchStride != 4) {
+                std::cerr << "March stride must be 1, 2 or 4" << std::endl;
+                return -1;
+            }
+            dynamicResolution = dynamicResolution && marchStride == 1;
+        } else if (arg == "--stars" && i + 1 < argc) {
+            starCatalogPath = argv[++i];
+        } else if (arg == "--planets" && i + 1 < argc) {
+            if (!loadPlanets(argv[++i], params.planets)) {
+                return -1;
+            }
+        } else if (arg == "--belt" && i + 1 < argc) {
+            params.bodies = asteroidBelt(std::atoi(argv[++i]));
+        } else if (arg == "--temporal") {
+            temporal = true;
+            dynamicResolution = false;
+        } else if (arg == "--compute") {
+            compute = true;
+            dynamicResolution = false;
+        } else if (arg == "--format" && i + 1 < argc) {
+            if (!FrameCapture::parseFormat(argv[++i], captureFormat)) {
+                std::cerr << "Unknown capture format '" << argv[i] << "' (png, ppm or raw)" << std::endl;
+                return -1;
+            }
+        } else {
+            std::cerr << "Unknown option '" << arg << "'" << std::endl;
+            return -1;
+        }
+    }
+
     // Initialize GLFW
     if (!glfwInit()) {
         std::cerr << "Failed to initialize GLFW" << std::endl;
@@ -127,6 +380,7 @@ int main(int /*argc*/, char* /*argv*/[]) {
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_SAMPLES, 4); // MSAA
+    glfwWindowHint(GLFW_STENCIL_BITS, 8); // masks the re-marched pixels (--march-stride)
 
     // Create window
     GLFWwindow* window = glfwCreateWindow(1280, 720, "Black Hole Simulator", nullptr, nullptr);
@@ -154,40 +408,52 @@ int main(int /*argc*/, char* /*argv*/[]) {
     // Enable VSync for smooth rendering
     glfwSwapInterval(1);
 
-    // Load shaders
-    const Shader blackholeShader(BLACKHOLE_VERT_SRC, BLACKHOLE_FRAG_SRC);
-
-    // Create fullscreen quad VAO
-    unsigned int VAO, VBO;
-    constexpr float vertices[] = {
-        -1.0f,  1.0f,
-         1.0f,  1.0f,
-        -1.0f, -1.0f,
-         1.0f, -1.0f
-    };
-
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), static_cast<void *>(nullptr));
-    glEnableVertexAttribArray(0);
+    // Shaders, fullscreen quad and lookup textures; released before the context goes away
+    auto renderer = std::make_unique<GpuRenderer>();
+    if (!starCatalogPath.empty() && !renderer->loadStarCatalog(starCatalogPath)) {
+        renderer.reset();
+        glfwTerminate();
+        return -1;
+    }
+    if (compute && !renderer->computeAvailable()) {
+        std::cout << "Compute shaders need OpenGL 4.3, " << glGetString(GL_VERSION)
+                  << " found; using the fragment shader path" << std::endl;
+        compute = false;
+    }
 
     // Enable OpenGL features
     glEnable(GL_MULTISAMPLE);
 
     std::cout << "Black Hole Simulator Controls:" << std::endl;
     std::cout << "Mouse: Drag to rotate, scroll to zoom" << std::endl;
-    std::cout << "Keys: 1-4 toggle features, +/- adjust mass, [/] adjust disk" << std::endl;
+    std::cout << "Keys: 1-4 toggle features, +/- adjust mass, [/] adjust disk, </> adjust spin" << std::endl;
+    std::cout << "P: Print frame time report" << std::endl;
+    std::cout << "L: Cycle lensing model (marched / precomputed table / RK45 geodesics / Kerr / Binet)" << std::endl;
     std::cout << "ESC: Exit" << std::endl << std::endl;
 
+    FrameProfiler frameProfiler;
+    profiler = &frameProfiler;
+
+    // Scales the ray march to hold the GPU time target, driven by the timer queries
+    ResolutionController resolutionController(resolutionSettings);
+    resolution = dynamicResolution ? &resolutionController : nullptr;
+    std::size_t gpuSamplesSeen = 0;
+
+    std::unique_ptr<FrameCapture> capture;
+    if (!capturePath.empty()) {
+        capture = std::make_unique<FrameCapture>(capturePath, captureFormat);
+        std::cout << "Capturing frames to " << capturePath << std::endl << std::endl;
+    }
+
+    // Small bodies, re-binned every frame
+    BodyGrid bodies;
+
     // Main render loop
     const auto startTime = std::chrono::high_resolution_clock::now();
 
     while (!glfwWindowShouldClose(window)) {
+        frameProfiler.beginFrame();
+
         // Calculate time
         auto currentTime = std::chrono::high_resolution_clock::now();
         const float time = std::chrono::duration<float>(currentTime - startTime).count();
@@ -198,65 +464,61 @@ int main(int /*argc*/, char* /*argv*/[]) {
 
         // Update camera
         camera.updatePosition();
-        const Mat4 invViewMatrix = camera.getInverseViewMatrix();
-
-        // Clear
-        glViewport(0, 0, width, height);
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-
-        // Use shader and set uniforms
-        blackholeShader.use();
-        blackholeShader.setVec2("u_resolution", static_cast<float>(width), static_cast<float>(height));
-        blackholeShader.setFloat("u_time", time);
-        blackholeShader.setMat4("u_invViewMatrix", invViewMatrix.m);
-        blackholeShader.setVec3("u_cameraPosition", camera.position.x, camera.position.y, camera.position.z);
-
-        // Simulation parameters
-        blackholeShader.setFloat("u_mass", params.mass);
-        blackholeShader.setFloat("u_schwarzschildRadius", params.mass);
-        blackholeShader.setFloat("u_diskInnerRadius", 1.5f * params.mass);
-        blackholeShader.setFloat("u_diskOuterRadius", params.diskOuter);
-        blackholeShader.setInt("u_enableStarfield", params.starfieldOn ? 1 : 0);
-        blackholeShader.setInt("u_enablePlanets", params.planetsOn ? 1 : 0);
-        blackholeShader.setInt("u_enableDisk", params.diskOn ? 1 : 0);
-        blackholeShader.setInt("u_enableLensing", params.lensingOn ? 1 : 0);
-
-        // Adaptive marching parameters (optimized based on features enabled)
-        float baseStep = params.lensingOn ? 0.25f : 0.45f;
-        if (!params.diskOn) baseStep *= 1.15f;
-        if (!params.planetsOn) baseStep *= 1.15f;
-
-        // Dynamic FPS-based optimization
-        if (fps > 0.0f) {
-            if (fps < 30.0f) baseStep *= 1.2f;
-            else if (fps > 55.0f) baseStep *= 0.9f;
+        // Dynamic resolution replaces the FPS-driven step size adjustment
+        FrameUniforms uniforms = makeFrameUniforms(camera, params, time, width, height, resolution ? 0.0f : fps);
+        bodies.build(params.bodies, time);
+        bodies.attach(uniforms);
+        if (resolution && frameProfiler.sampleCount(FrameProfiler::Gpu) != gpuSamplesSeen) {
+            gpuSamplesSeen = frameProfiler.sampleCount(FrameProfiler::Gpu);
+            resolution->update(frameProfiler.stats(FrameProfiler::Gpu, 1).avg);
         }
-        baseStep = std::max(0.15f, std::min(0.8f, baseStep));
 
-        const int maxSteps = params.lensingOn ? 220 : 120;
-        constexpr float farDist = 100.0f;
-        const float lensMaxRadius = params.lensingOn ? (params.diskOuter * 2.0f + 6.0f) : 0.0f;
-
-        blackholeShader.setFloat("u_stepSize", baseStep);
-        blackholeShader.setInt("u_maxSteps", maxSteps);
-        blackholeShader.setFloat("u_farDist", farDist);
-        blackholeShader.setFloat("u_lensMaxRadius", lensMaxRadius);
-
-        // Render fullscreen quad
-        glBindVertexArray(VAO);
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        frameProfiler.beginGpu();
+        if (compute) {
+            renderer->renderCompute(uniforms);
+        } else if (temporal) {
+            renderer->renderTemporal(uniforms);
+        } else if (marchStride > 1) {
+            renderer->renderReconstructed(uniforms, marchStride);
+        } else if (resolution) {
+            renderer->renderScaled(uniforms, resolution->scale());
+        } else {
+            renderer->render(uniforms);
+        }
+        frameProfiler.endGpu();
+        if (capture) {
+            capture->capture(width, height);
+        }
+        frameProfiler.endFrame();
 
         // Swap buffers and poll events
         glfwSwapBuffers(window);
         glfwPollEvents();
 
+        // Build the other permutations over the first frames so toggles never stall
+        renderer->warmUp();
+
         updateFPS();
     }
 
+    profiler = nullptr;
+    resolution = nullptr;
+    if (!profilePath.empty()) {
+        std::cout << std::endl;
+        frameProfiler.printReport(std::cout);
+        if (!frameProfiler.writeJson(profilePath)) {
+            std::cerr << "Failed to write " << profilePath << std::endl;
+        }
+    }
+
+    if (capture) {
+        const int frames = capture->framesCaptured();
+        capture.reset();
+        std::cout << frames << " frames written to " << capturePath << std::endl;
+    }
+
     // Cleanup
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
+    renderer.reset();
 
     glfwTerminate();
     return 0;
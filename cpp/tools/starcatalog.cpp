@@ -0,0 +1,131 @@
+// Star catalog converter. Packs a CSV catalog (HYG, a Gaia extract, ...) into
+// the tiled binary format StarCatalog maps at startup:
+//   blackhole_starcatalog <input.csv> <output.bin> [--tiles N] [--max-mag M]
+// Columns are found by header name: ra, dec, a magnitude (mag, vmag or
+// phot_g_mean_mag) and optionally a color index (ci, bv or bp_rp). RA is
+// taken as hours when no row exceeds 24 (HYG), as degrees otherwise (Gaia).
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "StarCatalog.hpp"
+
+static std::vector<std::string> splitCsv(const std::string& line) {
+    std::vector<std::string> fields;
+    std::string field;
+    bool quoted = false;
+    for (const char c : line) {
+        if (c == '"') {
+            quoted = !quoted;
+        } else if (c == ',' && !quoted) {
+            fields.push_back(field);
+            field.clear();
+        } else if (c != '\r') {
+            field += c;
+        }
+    }
+    fields.push_back(field);
+    return fields;
+}
+
+static int findColumn(const std::vector<std::string>& header, std::initializer_list<const char*> names) {
+    for (const char* name : names) {
+        const auto it = std::find(header.begin(), header.end(), name);
+        if (it != header.end()) return static_cast<int>(it - header.begin());
+    }
+    return -1;
+}
+
+static bool parseField(const std::vector<std::string>& fields, const int column, double& value) {
+    if (column < 0 || column >= static_cast<int>(fields.size()) || fields[column].empty()) return false;
+    char* end = nullptr;
+    value = std::strtod(fields[column].c_str(), &end);
+    return end != fields[column].c_str();
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: blackhole_starcatalog <input.csv> <output.bin> [--tiles N] [--max-mag M]" << std::endl;
+        return 1;
+    }
+    int tilesPerFace = 16;
+    double maxMagnitude = 99.0;
+    for (int i = 3; i + 1 < argc; i += 2) {
+        const std::string arg = argv[i];
+        if (arg == "--tiles") tilesPerFace = std::clamp(std::atoi(argv[i + 1]), 1, 256);
+        else if (arg == "--max-mag") maxMagnitude = std::atof(argv[i + 1]);
+        else {
+            std::cerr << "Unknown option '" << arg << "'" << std::endl;
+            return 1;
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    std::ifstream input(argv[1]);
+    std::string line;
+    if (!input || !std::getline(input, line)) {
+        std::cerr << "Cannot read " << argv[1] << std::endl;
+        return 1;
+    }
+    const std::vector<std::string> header = splitCsv(line);
+    const int raColumn = findColumn(header, {"ra", "RA", "RAdeg"});
+    const int decColumn = findColumn(header, {"dec", "DEC", "DEdeg"});
+    const int magColumn = findColumn(header, {"mag", "vmag", "Vmag", "phot_g_mean_mag"});
+    const int bvColumn = findColumn(header, {"ci", "bv", "b_v", "B-V"});
+    const int bpRpColumn = findColumn(header, {"bp_rp"});
+    if (raColumn < 0 || decColumn < 0 || magColumn < 0) {
+        std::cerr << "Need ra, dec and magnitude columns in " << argv[1] << std::endl;
+        return 1;
+    }
+
+    struct Row {
+        double ra, dec, magnitude, colorIndex;
+    };
+    std::vector<Row> rows;
+    double maxRa = 0.0;
+    std::size_t skipped = 0;
+    while (std::getline(input, line)) {
+        const std::vector<std::string> fields = splitCsv(line);
+        Row row{};
+        if (!parseField(fields, raColumn, row.ra) || !parseField(fields, decColumn, row.dec) ||
+            !parseField(fields, magColumn, row.magnitude)) {
+            skipped++;
+            continue;
+        }
+        // The Sun is in HYG as row 0
+        if (row.magnitude < -5.0 || row.magnitude > maxMagnitude) continue;
+        double bpRp = 0.0;
+        if (!parseField(fields, bvColumn, row.colorIndex)) {
+            // Rough linear fit of B-V to Gaia BP-RP, Sun-like without either
+            row.colorIndex = parseField(fields, bpRpColumn, bpRp) ? 0.8 * bpRp - 0.05 : 0.65;
+        }
+        maxRa = std::max(maxRa, row.ra);
+        rows.push_back(row);
+    }
+
+    const double raScale = (maxRa <= 24.0 ? 15.0 : 1.0) * M_PI / 180.0;
+    std::vector<StarCatalog::Entry> entries;
+    entries.reserve(rows.size());
+    for (const Row& row : rows) {
+        const double ra = row.ra * raScale;
+        const double dec = row.dec * M_PI / 180.0;
+        // Equatorial coordinates, celestial north pole along +Y
+        const Vec3 direction(static_cast<float>(std::cos(dec) * std::cos(ra)), static_cast<float>(std::sin(dec)),
+                             static_cast<float>(std::cos(dec) * std::sin(ra)));
+        entries.push_back({direction, static_cast<float>(row.magnitude), static_cast<float>(row.colorIndex)});
+    }
+
+    if (!StarCatalog::write(argv[2], entries, tilesPerFace)) {
+        return 1;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Packed " << entries.size() << " stars into " << 6 * tilesPerFace * tilesPerFace << " tiles ("
+              << (maxRa <= 24.0 ? "RA in hours" : "RA in degrees") << ", " << skipped << " rows skipped) in "
+              << seconds << " s" << std::endl;
+    return 0;
+}